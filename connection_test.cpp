@@ -0,0 +1,135 @@
+#include <gtest/gtest.h>
+#include <vector>
+#include <poll.h>
+#include <unistd.h>
+
+extern "C" {
+#include "connection.h"
+#include "server_io.h"
+}
+
+// whether the bell's eventfd would wake its consumer
+static bool rung(const mpsc_bell_t *bell) {
+    struct pollfd p = { bell->fd, POLLIN, 0 };
+    return poll(&p, 1, 0) == 1;
+}
+
+class ConnectionTest : public ::testing::Test {
+protected:
+    outbound_t outbound;
+    connection_t *conn;
+
+    void SetUp() override {
+        ASSERT_EQ(outbound_init(&outbound), 0);
+        conn = connection_new(-1, 1, &outbound);
+        ASSERT_NE(conn, nullptr);
+    }
+
+    void TearDown() override {
+        connection_free(conn);
+        outbound_fini(&outbound);
+    }
+
+    int send(size_t len) {
+        std::vector<uint8_t> bytes(len, 0x5A);
+        struct iovec iov = { bytes.data(), bytes.size() };
+        return connection_send(conn, &iov, 1);
+    }
+};
+
+TEST(MpscBell, WrittenOnceUntilAnswered) {
+    mpsc_bell_t bell;
+    ASSERT_EQ(mpsc_bell_init(&bell), 0);
+    EXPECT_FALSE(rung(&bell));
+    mpsc_bell_ring(&bell);
+    mpsc_bell_ring(&bell);
+    EXPECT_TRUE(rung(&bell));
+
+    uint64_t count = 0;
+    mpsc_bell_answer(&bell);
+    EXPECT_FALSE(rung(&bell));
+    mpsc_bell_ring(&bell);
+    ASSERT_EQ(read(bell.fd, &count, sizeof(count)), (ssize_t)sizeof(count));
+    EXPECT_EQ(count, 1u);
+    mpsc_bell_fini(&bell);
+}
+
+// however many frames the engine writes, the connection is queued once until it is taken off
+TEST_F(ConnectionTest, QueuedOnceUntilTaken) {
+    ASSERT_EQ(send(100), 0);
+    ASSERT_EQ(send(200), 0);
+    EXPECT_TRUE(rung(&outbound.bell));
+    mpsc_bell_answer(&outbound.bell);
+    EXPECT_EQ(outbound_pop(&outbound), conn);
+    EXPECT_EQ(outbound_pop(&outbound), nullptr);
+    EXPECT_EQ(shm_ring_used(&conn->out), 300);
+
+    // what is written after it was taken off queues it again
+    ASSERT_EQ(send(1), 0);
+    EXPECT_TRUE(rung(&outbound.bell));
+    EXPECT_EQ(outbound_pop(&outbound), conn);
+    EXPECT_EQ(outbound_pop(&outbound), nullptr);
+}
+
+TEST_F(ConnectionTest, FramesThatDoNotFitAreRefused) {
+    ASSERT_EQ(send(SHM_RING_SIZE - 10), 0);
+    EXPECT_EQ(send(11), -1);
+    EXPECT_EQ(shm_ring_used(&conn->out), SHM_RING_SIZE - 10);
+    EXPECT_EQ(send(10), 0);
+}
+
+TEST_F(ConnectionTest, CongestedOverTheHighWatermark) {
+    EXPECT_FALSE(connection_congested(conn));
+    ASSERT_EQ(send(SERVER_IO_HIGH_WATER + 1), 0);
+    EXPECT_TRUE(connection_congested(conn));
+
+    uint8_t chunk[SERVER_IO_HIGH_WATER + 1];
+    ASSERT_EQ(shm_ring_read(&conn->out, chunk, sizeof(chunk)), (ssize_t)sizeof(chunk));
+    EXPECT_FALSE(connection_congested(conn));
+    // or when the network thread last saw the socket over it
+    conn->congested = 1;
+    EXPECT_TRUE(connection_congested(conn));
+}
+
+// closed while still queued: one trip through the outbound queue closes it
+TEST_F(ConnectionTest, ClosedWhileQueued) {
+    ASSERT_EQ(send(10), 0);
+    connection_close(conn);
+    EXPECT_EQ(outbound_pop(&outbound), conn);
+    EXPECT_TRUE(connection_closing(conn));
+    EXPECT_TRUE(connection_done(conn));
+    EXPECT_EQ(outbound_pop(&outbound), nullptr);
+}
+
+// closed just after the network thread took it off: the close queues it once more, and the
+// socket is only closed on that second trip, when nothing can push it again
+TEST_F(ConnectionTest, ClosedAfterItWasTaken) {
+    ASSERT_EQ(send(10), 0);
+    EXPECT_EQ(outbound_pop(&outbound), conn);
+    EXPECT_FALSE(connection_closing(conn));
+    connection_close(conn);
+    EXPECT_TRUE(connection_closing(conn));
+    EXPECT_FALSE(connection_done(conn));
+
+    EXPECT_EQ(outbound_pop(&outbound), conn);
+    EXPECT_TRUE(connection_done(conn));
+    EXPECT_EQ(outbound_pop(&outbound), nullptr);
+}
+
+TEST_F(ConnectionTest, OwnCommandsAreNotFreed) {
+    EXPECT_EQ(conn->join.kind, COMMAND_JOIN);
+    EXPECT_EQ(conn->release.kind, COMMAND_RELEASE);
+    EXPECT_EQ(conn->join.conn, conn);
+    EXPECT_EQ(conn->gone.conn, conn);
+    command_free(&conn->join);
+    command_free(&conn->release);
+
+    client_packet_t pkt = {};
+    pkt.packet_type = CHECK;
+    pkt.seq = 7;
+    command_t *cmd = command_new(conn, COMMAND_PACKET, &pkt);
+    ASSERT_NE(cmd, nullptr);
+    EXPECT_EQ(cmd->conn, conn);
+    EXPECT_EQ(cmd->pkt.seq, 7);
+    command_free(cmd);
+}
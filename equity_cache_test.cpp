@@ -0,0 +1,195 @@
+#include <gtest/gtest.h>
+#include <initializer_list>
+#include <thread>
+#include <vector>
+
+extern "C" {
+#include "equity_cache.h"
+}
+
+static card_set_t set_of(std::initializer_list<card_t> cards) {
+    card_set_t set = CARD_SET_EMPTY;
+    for (card_t c : cards) {
+        set |= CARD_SET_BIT(c);
+    }
+    return set;
+}
+
+static equity_key_t key_for(uint64_t index) {
+    equity_key_t key = {};
+    key.index = index;
+    key.max_trials = 1000;
+    key.board_cards = 3;
+    key.opponents = 1;
+    return key;
+}
+
+// what the stress test stores under a key, so a reader can tell a torn or mixed-up entry
+static hand_outlook_t outlook_for(uint64_t index) {
+    return hand_outlook_t{index / 1000.0, index / 2000.0, index / 4000.0, index};
+}
+
+class EquityCacheTest : public ::testing::Test {
+protected:
+    equity_pool_t pool;
+    equity_cache_t cache;
+
+    void SetUp() override {
+        ASSERT_EQ(equity_pool_init(&pool, 4), 0);
+        ASSERT_EQ(equity_cache_init(&cache, 1024, NULL), 0);
+    }
+
+    void TearDown() override {
+        equity_cache_fini(&cache);
+        equity_pool_fini(&pool);
+    }
+};
+
+TEST_F(EquityCacheTest, KeyIgnoresTheSuitsAndRoundsTheMargin) {
+    card_set_t hand = set_of({KING OF HEART, QUEEN OF HEART});
+    card_set_t board = set_of({TWO OF HEART, NINE OF CLUB, NINE OF SPADE});
+    card_set_t hand2 = set_of({KING OF DIAMOND, QUEEN OF DIAMOND});
+    card_set_t board2 = set_of({TWO OF DIAMOND, NINE OF SPADE, NINE OF HEART});
+    equity_key_t a, b;
+    equity_key_of(hand, board, 2, 5000, 0.01, &a);
+    equity_key_of(hand2, board2, 2, 5000, 0.0100001, &b);
+    EXPECT_EQ(a.index, b.index);
+    EXPECT_EQ(a.margin, 100u);
+    EXPECT_EQ(b.margin, 100u);
+    EXPECT_EQ(a.board_cards, 3);
+
+    equity_key_of(hand, board, 2, 5000, 0.0, &a);
+    equity_key_of(hand, board, 2, 5000, -0.0, &b);
+    EXPECT_EQ(a.margin, 0u);
+    EXPECT_EQ(b.margin, 0u);
+}
+
+TEST_F(EquityCacheTest, AcesPreflop) {
+    hand_outlook_t o;
+    ASSERT_EQ(equity_hand_cached(&cache, &pool, set_of({ACE OF SPADE, ACE OF HEART}), CARD_SET_EMPTY, 1,
+                                 200000, 0, 1, &o), 0);
+    // the one other pair of aces ties, every other hand is behind
+    EXPECT_DOUBLE_EQ(o.strength, (1224 + 0.5) / 1225);
+    // 0.8520 against a random hand
+    EXPECT_NEAR(o.equity, 0.8520, 3 * o.margin);
+    EXPECT_GT(o.margin, 0);
+}
+
+TEST_F(EquityCacheTest, RiverHeadsUpIsTheStrength) {
+    hand_outlook_t o;
+    card_set_t board = set_of({ACE OF CLUB, KING OF CLUB, SEVEN OF DIAMOND, SEVEN OF SPADE, TWO OF HEART});
+    ASSERT_EQ(equity_hand_cached(&cache, &pool, set_of({ACE OF SPADE, THREE OF HEART}), board, 1,
+                                 1000, 0.01, 1, &o), 0);
+    EXPECT_EQ(o.equity, o.strength);
+    EXPECT_EQ(o.margin, 0);
+    EXPECT_EQ(o.trials, 990u);
+}
+
+TEST_F(EquityCacheTest, RelabelledHandIsAHit) {
+    hand_outlook_t a, b;
+    ASSERT_EQ(equity_hand_cached(&cache, &pool, set_of({KING OF HEART, QUEEN OF HEART}),
+                                 set_of({TWO OF HEART, NINE OF CLUB, NINE OF SPADE}), 3, 20000, 0.01, 5, &a), 0);
+    ASSERT_EQ(equity_hand_cached(&cache, &pool, set_of({KING OF CLUB, QUEEN OF CLUB}),
+                                 set_of({TWO OF CLUB, NINE OF HEART, NINE OF DIAMOND}), 3, 20000, 0.01, 5, &b), 0);
+    EXPECT_EQ(a.strength, b.strength);
+    EXPECT_EQ(a.equity, b.equity);
+    EXPECT_EQ(a.trials, b.trials);
+    uint64_t hits, misses;
+    equity_cache_stats(&cache, &hits, &misses);
+    EXPECT_EQ(hits, 1u);
+    EXPECT_EQ(misses, 1u);
+
+    // another number of opponents is another outlook
+    ASSERT_EQ(equity_hand_cached(&cache, &pool, set_of({KING OF CLUB, QUEEN OF CLUB}),
+                                 set_of({TWO OF CLUB, NINE OF HEART, NINE OF DIAMOND}), 1, 20000, 0.01, 5, &b), 0);
+    equity_cache_stats(&cache, &hits, &misses);
+    EXPECT_EQ(misses, 2u);
+    EXPECT_GT(b.equity, a.equity);
+}
+
+TEST_F(EquityCacheTest, RejectsInvalidHands) {
+    hand_outlook_t o;
+    card_set_t aces = set_of({ACE OF SPADE, ACE OF HEART});
+    EXPECT_EQ(equity_hand_cached(&cache, &pool, set_of({ACE OF SPADE}), CARD_SET_EMPTY, 1, 1000, 0, 1, &o), -1);
+    EXPECT_EQ(equity_hand_cached(&cache, &pool, aces, set_of({ACE OF SPADE, TWO OF CLUB, THREE OF CLUB}), 1, 1000, 0, 1, &o), -1);
+    EXPECT_EQ(equity_hand_cached(&cache, &pool, aces, CARD_SET_EMPTY, 0, 1000, 0, 1, &o), -1);
+    EXPECT_EQ(equity_hand_cached(&cache, &pool, aces, CARD_SET_EMPTY, MAX_PLAYERS, 1000, 0, 1, &o), -1);
+    EXPECT_EQ(equity_hand_cached(&cache, &pool, aces, CARD_SET_EMPTY, 1, 0, 0, 1, &o), -1);
+}
+
+TEST(EquityCacheLru, EvictsTheLeastRecentlyUsed) {
+    // with one entry per shard, a key that pushes out the first shares its shard
+    equity_cache_t probe;
+    ASSERT_EQ(equity_cache_init(&probe, EQUITY_CACHE_SHARDS, NULL), 0);
+    std::vector<uint64_t> same_shard = {0};
+    hand_outlook_t o = outlook_for(0);
+    for (uint64_t i = 1; same_shard.size() < 3; i++) {
+        equity_key_t first = key_for(0), other = key_for(i);
+        equity_cache_put(&probe, &first, &o);
+        equity_cache_put(&probe, &other, &o);
+        if (!equity_cache_get(&probe, &first, &o)) {
+            same_shard.push_back(i);
+        }
+    }
+    equity_cache_fini(&probe);
+
+    equity_cache_t cache;
+    ASSERT_EQ(equity_cache_init(&cache, 2 * EQUITY_CACHE_SHARDS, NULL), 0);
+    equity_key_t a = key_for(same_shard[0]), b = key_for(same_shard[1]), c = key_for(same_shard[2]);
+    hand_outlook_t oa = outlook_for(a.index), ob = outlook_for(b.index), oc = outlook_for(c.index);
+    equity_cache_put(&cache, &a, &oa);
+    equity_cache_put(&cache, &b, &ob);
+    ASSERT_TRUE(equity_cache_get(&cache, &a, &o));
+    equity_cache_put(&cache, &c, &oc);
+    EXPECT_TRUE(equity_cache_get(&cache, &a, &o));
+    EXPECT_EQ(o.trials, a.index);
+    EXPECT_FALSE(equity_cache_get(&cache, &b, &o));
+    EXPECT_TRUE(equity_cache_get(&cache, &c, &o));
+    EXPECT_EQ(o.trials, c.index);
+    equity_cache_fini(&cache);
+}
+
+// threads looking up and inserting over far more keys than fit; run under `make TSAN=1`
+// to have the sanitizer check the locking as well
+TEST(EquityCacheStress, ConcurrentUseStaysConsistent) {
+    const int threads = 8, ops = 200000, keys = 512;
+    equity_cache_t cache;
+    ASSERT_EQ(equity_cache_init(&cache, 64, NULL), 0);
+    std::vector<std::thread> workers;
+    std::vector<int> bad(threads, 0);
+    std::vector<uint64_t> gets(threads, 0);
+    for (int t = 0; t < threads; t++) {
+        workers.emplace_back([&, t] {
+            uint64_t rng = 0x9E3779B97F4A7C15ull * (t + 1);
+            for (int i = 0; i < ops; i++) {
+                rng ^= rng << 13;
+                rng ^= rng >> 7;
+                rng ^= rng << 17;
+                equity_key_t key = key_for(rng % keys);
+                hand_outlook_t o;
+                gets[t]++;
+                if (equity_cache_get(&cache, &key, &o)) {
+                    hand_outlook_t want = outlook_for(key.index);
+                    bad[t] += o.strength != want.strength || o.equity != want.equity
+                              || o.margin != want.margin || o.trials != want.trials;
+                }
+                else {
+                    o = outlook_for(key.index);
+                    equity_cache_put(&cache, &key, &o);
+                }
+            }
+        });
+    }
+    for (auto &w : workers) {
+        w.join();
+    }
+    uint64_t hits, misses, total = 0;
+    equity_cache_stats(&cache, &hits, &misses);
+    for (int t = 0; t < threads; t++) {
+        EXPECT_EQ(bad[t], 0) << "thread " << t;
+        total += gets[t];
+    }
+    EXPECT_EQ(hits + misses, total);
+    EXPECT_GT(hits, 0u);
+    equity_cache_fini(&cache);
+}
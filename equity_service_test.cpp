@@ -0,0 +1,151 @@
+#include <gtest/gtest.h>
+#include <condition_variable>
+#include <initializer_list>
+#include <mutex>
+#include <vector>
+
+extern "C" {
+#include "equity_service.h"
+}
+
+static card_set_t set_of(std::initializer_list<card_t> cards) {
+    card_set_t set = CARD_SET_EMPTY;
+    for (card_t c : cards) {
+        set |= CARD_SET_BIT(c);
+    }
+    return set;
+}
+
+// what the service handed back, in the order it did
+struct returns_t {
+    std::mutex lock;
+    std::condition_variable cond;
+    std::vector<equity_request_t *> reqs;
+
+    equity_request_t *wait() {
+        std::unique_lock<std::mutex> hold(lock);
+        cond.wait(hold, [this] { return !reqs.empty(); });
+        equity_request_t *req = reqs.front();
+        reqs.erase(reqs.begin());
+        return req;
+    }
+};
+
+static void on_done(equity_request_t *req) {
+    returns_t *returns = (returns_t *)req->owner;
+    std::lock_guard<std::mutex> hold(returns->lock);
+    returns->reqs.push_back(req);
+    returns->cond.notify_one();
+}
+
+class EquityServiceTest : public ::testing::Test {
+protected:
+    equity_pool_t pool;
+    equity_cache_t cache;
+    equity_service_t svc;
+    returns_t returns;
+
+    void SetUp() override {
+        ASSERT_EQ(equity_pool_init(&pool, 4), 0);
+        ASSERT_EQ(equity_cache_init(&cache, 1024, NULL), 0);
+        ASSERT_EQ(equity_service_init(&svc, &pool, &cache), 0);
+    }
+
+    void TearDown() override {
+        equity_service_fini(&svc);
+        equity_cache_fini(&cache);
+        equity_pool_fini(&pool);
+    }
+
+    equity_request_t *request(equity_request_kind_t kind) {
+        equity_request_t *req = (equity_request_t *)calloc(1, sizeof(equity_request_t));
+        req->kind = kind;
+        req->done = on_done;
+        req->owner = &returns;
+        req->max_trials = 20000;
+        req->seed = 7;
+        return req;
+    }
+};
+
+TEST_F(EquityServiceTest, AllInIsTheRunOfTheSpot) {
+    equity_request_t *req = request(EQUITY_ALL_IN);
+    req->spot.hands[0] = set_of({ACE OF SPADE, ACE OF HEART});
+    req->spot.hands[3] = set_of({KING OF SPADE, KING OF HEART});
+    ASSERT_EQ(equity_service_submit(&svc, req), 0);
+    ASSERT_EQ(returns.wait(), req);
+    ASSERT_TRUE(req->answered);
+
+    // with no target margin the run is the same on any thread
+    equity_result_t direct;
+    ASSERT_EQ(equity_run(&pool, &req->spot, req->max_trials, 0, req->seed, &direct), 0);
+    EXPECT_EQ(req->result.trials, direct.trials);
+    EXPECT_DOUBLE_EQ(req->result.equity[0], direct.equity[0]);
+    EXPECT_DOUBLE_EQ(req->result.equity[3], direct.equity[3]);
+    free(req);
+}
+
+TEST_F(EquityServiceTest, OutlooksForEveryHandAsked) {
+    equity_request_t *req = request(EQUITY_OUTLOOKS);
+    req->spot.hands[1] = set_of({ACE OF SPADE, KING OF SPADE});
+    req->spot.hands[4] = set_of({TWO OF CLUB, SEVEN OF DIAMOND});
+    req->spot.board = set_of({ACE OF CLUB, NINE OF HEART, FOUR OF SPADE});
+    req->opponents = 2;
+    req->target_margin = 0.01;
+    ASSERT_EQ(equity_service_submit(&svc, req), 0);
+    ASSERT_EQ(returns.wait(), req);
+    ASSERT_TRUE(req->answered);
+    for (int i = 0; i < MAX_PLAYERS; i++) {
+        EXPECT_EQ(req->has_outlook[i], i == 1 || i == 4) << i;
+    }
+    EXPECT_GT(req->outlooks[1].equity, req->outlooks[4].equity);
+
+    // the service filled the cache on the way
+    hand_outlook_t cached;
+    ASSERT_EQ(equity_hand_cached(&cache, &pool, req->spot.hands[1], req->spot.board, 2, req->max_trials,
+                                 req->target_margin, req->seed, &cached), 0);
+    EXPECT_DOUBLE_EQ(cached.equity, req->outlooks[1].equity);
+    uint64_t hits, misses;
+    equity_cache_stats(&cache, &hits, &misses);
+    EXPECT_EQ(hits, 1u);
+    free(req);
+}
+
+TEST_F(EquityServiceTest, InvalidSpotComesBackUnanswered) {
+    equity_request_t *req = request(EQUITY_ALL_IN);
+    req->spot.hands[0] = set_of({ACE OF SPADE, ACE OF HEART});
+    req->spot.hands[1] = set_of({ACE OF SPADE, KING OF HEART});
+    ASSERT_EQ(equity_service_submit(&svc, req), 0);
+    ASSERT_EQ(returns.wait(), req);
+    EXPECT_FALSE(req->answered);
+    free(req);
+}
+
+TEST_F(EquityServiceTest, TurnsDownWhatIsPastTheBacklog) {
+    svc.pending = EQUITY_SERVICE_BACKLOG;
+    equity_request_t *req = request(EQUITY_ALL_IN);
+    EXPECT_EQ(equity_service_submit(&svc, req), -1);
+    EXPECT_EQ(svc.pending, EQUITY_SERVICE_BACKLOG);
+    svc.pending = 0;
+    free(req);
+}
+
+// whatever is still queued when the service stops comes back too, unanswered
+TEST_F(EquityServiceTest, EveryRequestComesBackOnStop) {
+    const int count = 20;
+    for (int i = 0; i < count; i++) {
+        equity_request_t *req = request(EQUITY_ALL_IN);
+        req->spot.hands[0] = set_of({ACE OF SPADE, ACE OF HEART});
+        req->spot.hands[1] = set_of({KING OF SPADE, KING OF HEART});
+        req->spot.random_hands = 3;
+        req->max_trials = 100000;
+        ASSERT_EQ(equity_service_submit(&svc, req), 0);
+    }
+    equity_service_fini(&svc);
+    EXPECT_EQ(returns.reqs.size(), (size_t)count);
+    EXPECT_EQ(svc.pending, 0);
+    for (equity_request_t *req : returns.reqs) {
+        free(req);
+    }
+    returns.reqs.clear();
+}
@@ -0,0 +1,313 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cmath>
+#include <initializer_list>
+#include <vector>
+
+extern "C" {
+#include "equity.h"
+#include "hand_eval.h"
+}
+
+static card_set_t set_of(std::initializer_list<card_t> cards) {
+    card_set_t set = CARD_SET_EMPTY;
+    for (card_t c : cards) {
+        set |= CARD_SET_BIT(c);
+    }
+    return set;
+}
+
+// every runout of a spot dealt by nested loops over the card numbers and valued card by card,
+// sharing nothing with the engine but hand_eval()
+struct brute_force_t {
+    uint64_t trials = 0;
+    uint64_t wins[MAX_PLAYERS] = {}, ties[MAX_PLAYERS] = {};
+    double share[MAX_PLAYERS] = {};
+
+    brute_force_t(const equity_spot_t &spot) {
+        card_t board[MAX_COMMUNITY_CARDS];
+        int dealt = card_set_cards(spot.board, board);
+        card_set_t held = spot.board | spot.dead;
+        for (int i = 0; i < MAX_PLAYERS; i++) {
+            held |= spot.hands[i];
+        }
+        deal(spot, held, board, dealt, 0);
+    }
+
+    void deal(const equity_spot_t &spot, card_set_t held, card_t *board, int dealt, card_t from) {
+        if (dealt == MAX_COMMUNITY_CARDS) {
+            showdown(spot, board);
+            return;
+        }
+        for (card_t c = from; c < DECK_SIZE; c++) {
+            if (!(held & CARD_SET_BIT(c))) {
+                board[dealt] = c;
+                deal(spot, held, board, dealt + 1, c + 1);
+            }
+        }
+    }
+
+    void showdown(const equity_spot_t &spot, const card_t *board) {
+        uint64_t value[MAX_PLAYERS] = {}, best = 0;
+        std::vector<int> winners;
+        for (int i = 0; i < MAX_PLAYERS; i++) {
+            if (spot.hands[i] == CARD_SET_EMPTY) {
+                continue;
+            }
+            card_t cards[HAND_SIZE + MAX_COMMUNITY_CARDS];
+            card_set_cards(spot.hands[i], cards);
+            std::copy(board, board + MAX_COMMUNITY_CARDS, cards + HAND_SIZE);
+            value[i] = hand_eval(cards, HAND_SIZE + MAX_COMMUNITY_CARDS);
+            if (value[i] > best) {
+                best = value[i];
+                winners.clear();
+            }
+            if (value[i] == best) {
+                winners.push_back(i);
+            }
+        }
+        for (int i : winners) {
+            (winners.size() == 1 ? wins : ties)[i]++;
+            share[i] += 1.0 / winners.size();
+        }
+        trials++;
+    }
+
+    void expect_same(const equity_result_t &r) const {
+        EXPECT_TRUE(r.exact);
+        ASSERT_EQ(r.trials, trials);
+        for (int i = 0; i < MAX_PLAYERS; i++) {
+            EXPECT_EQ((uint64_t)llround(r.win[i] * trials), wins[i]) << "seat " << i;
+            EXPECT_EQ((uint64_t)llround(r.tie[i] * trials), ties[i]) << "seat " << i;
+            EXPECT_NEAR(r.equity[i], share[i] / trials, 1e-12) << "seat " << i;
+        }
+    }
+};
+
+class EquityTest : public ::testing::Test {
+protected:
+    equity_pool_t pool;
+
+    void SetUp() override {
+        ASSERT_EQ(equity_pool_init(&pool, 4), 0);
+    }
+
+    void TearDown() override {
+        equity_pool_fini(&pool);
+    }
+
+    // AsAh against KsKh, all in preflop
+    static equity_spot_t aces_kings() {
+        equity_spot_t spot = {};
+        spot.hands[0] = set_of({ACE OF SPADE, ACE OF HEART});
+        spot.hands[1] = set_of({KING OF SPADE, KING OF HEART});
+        return spot;
+    }
+
+    // three players preflop, one card folded
+    static equity_spot_t three_way() {
+        equity_spot_t spot = {};
+        spot.hands[0] = set_of({QUEEN OF CLUB, JACK OF CLUB});
+        spot.hands[2] = set_of({EIGHT OF DIAMOND, EIGHT OF HEART});
+        spot.hands[5] = set_of({ACE OF DIAMOND, SEVEN OF SPADE});
+        spot.dead = set_of({TWO OF CLUB});
+        return spot;
+    }
+};
+
+TEST_F(EquityTest, AcesAgainstKings) {
+    equity_spot_t spot = aces_kings();
+    equity_result_t r;
+    ASSERT_EQ(equity_run(&pool, &spot, 200000, 0, 1, &r), 0);
+    EXPECT_FALSE(r.exact);
+    EXPECT_EQ(r.trials, 200000u + (EQUITY_CHUNK - 200000 % EQUITY_CHUNK));
+    // 0.8263 over all 1712304 runouts
+    EXPECT_NEAR(r.equity[0], 0.8263, 3 * r.margin[0]);
+    EXPECT_NEAR(r.equity[0] + r.equity[1], 1.0, 1e-9);
+    EXPECT_GT(r.margin[0], 0);
+    EXPECT_LT(r.margin[0], 0.003);
+}
+
+TEST_F(EquityTest, DealsOnlyLiveCards) {
+    equity_spot_t spot = {};
+    spot.hands[0] = set_of({QUEEN OF DIAMOND, FOUR OF CLUB});
+    spot.hands[1] = set_of({TEN OF DIAMOND, JACK OF DIAMOND});
+    equity_result_t r;
+    ASSERT_EQ(equity_run(&pool, &spot, 400000, 0, 3, &r), 0);
+    // 0.5181 over all 1712304 runouts; dealing a held card as well pushed it to 0.530
+    EXPECT_NEAR(r.equity[0], 0.5181, 3 * r.margin[0]);
+}
+
+TEST_F(EquityTest, SameResultForAnyThreadCount) {
+    equity_spot_t spot = three_way();
+    equity_result_t expected;
+    ASSERT_EQ(equity_run(&pool, &spot, 50000, 0, 7, &expected), 0);
+    for (int threads : {1, 2, 8}) {
+        equity_pool_t other;
+        ASSERT_EQ(equity_pool_init(&other, threads), 0);
+        equity_result_t r;
+        ASSERT_EQ(equity_run(&other, &spot, 50000, 0, 7, &r), 0);
+        equity_pool_fini(&other);
+        EXPECT_EQ(r.trials, expected.trials);
+        for (int i = 0; i < MAX_PLAYERS; i++) {
+            EXPECT_EQ(r.win[i], expected.win[i]) << threads << " threads, seat " << i;
+            EXPECT_EQ(r.tie[i], expected.tie[i]) << threads << " threads, seat " << i;
+            EXPECT_EQ(r.equity[i], expected.equity[i]) << threads << " threads, seat " << i;
+        }
+    }
+}
+
+TEST_F(EquityTest, StopsOnceTightEnough) {
+    equity_spot_t spot = aces_kings();
+    equity_result_t r;
+    ASSERT_EQ(equity_run(&pool, &spot, 1 << 20, 0.005, 1, &r), 0);
+    // about 23k runouts give a margin of 0.005 at 82.6%
+    EXPECT_GE(r.trials, (uint64_t)EQUITY_MIN_TRIALS);
+    EXPECT_LE(r.trials, 32u * EQUITY_CHUNK);
+    EXPECT_EQ(r.trials % EQUITY_CHUNK, 0u);
+    EXPECT_LE(r.margin[0], 0.005);
+    EXPECT_LE(r.margin[1], 0.005);
+}
+
+TEST_F(EquityTest, SeedDecidesTheResult) {
+    equity_spot_t spot = three_way();
+    equity_result_t a, b, c;
+    ASSERT_EQ(equity_run(&pool, &spot, 20000, 0, 11, &a), 0);
+    ASSERT_EQ(equity_run(&pool, &spot, 20000, 0, 11, &b), 0);
+    ASSERT_EQ(equity_run(&pool, &spot, 20000, 0, 12, &c), 0);
+    for (int i = 0; i < MAX_PLAYERS; i++) {
+        EXPECT_EQ(a.equity[i], b.equity[i]);
+    }
+    EXPECT_NE(a.equity[0], c.equity[0]);
+}
+
+TEST_F(EquityTest, EnumeratesTheTurn) {
+    equity_spot_t spot = aces_kings();
+    spot.board = set_of({KING OF DIAMOND, SEVEN OF CLUB, TWO OF HEART, NINE OF SPADE});
+    equity_result_t r;
+    ASSERT_EQ(equity_run(&pool, &spot, 1000, 0.01, 1, &r), 0);
+    EXPECT_TRUE(r.exact);
+    EXPECT_EQ(r.trials, 44u);
+    // only the last two aces beat the set of kings
+    EXPECT_DOUBLE_EQ(r.equity[0], 2.0 / 44);
+    EXPECT_DOUBLE_EQ(r.equity[1], 42.0 / 44);
+    EXPECT_EQ(r.margin[0], 0);
+}
+
+TEST_F(EquityTest, EnumeratesTheFlopLikeBruteForce) {
+    equity_spot_t spot = three_way();
+    spot.board = set_of({NINE OF CLUB, TEN OF DIAMOND, EIGHT OF SPADE});
+    equity_result_t r;
+    ASSERT_EQ(equity_run(&pool, &spot, 1000, 0, 1, &r), 0);
+    // C(42, 2) turn and river pairs
+    EXPECT_EQ(r.trials, 861u);
+    brute_force_t(spot).expect_same(r);
+}
+
+TEST_F(EquityTest, EnumeratesPreflopLikeBruteForce) {
+    // C(45, 5) boards over some 1200 chunks, each unranked from its first number
+    equity_spot_t spot = three_way();
+    equity_result_t r;
+    ASSERT_EQ(equity_run(&pool, &spot, 1 << 21, 0, 1, &r), 0);
+    EXPECT_EQ(r.trials, 1221759u);
+    brute_force_t(spot).expect_same(r);
+}
+
+TEST_F(EquityTest, RejectsInvalidSpots) {
+    equity_result_t r;
+    equity_spot_t spot = aces_kings();
+    EXPECT_EQ(equity_run(&pool, &spot, 0, 0, 1, &r), -1);
+
+    spot = aces_kings();
+    spot.hands[1] = set_of({KING OF SPADE});
+    EXPECT_EQ(equity_run(&pool, &spot, 1000, 0, 1, &r), -1);
+
+    spot = aces_kings();
+    spot.hands[1] |= set_of({KING OF CLUB});
+    EXPECT_EQ(equity_run(&pool, &spot, 1000, 0, 1, &r), -1);
+
+    spot = aces_kings();
+    spot.hands[1] = set_of({KING OF SPADE, ACE OF HEART});
+    EXPECT_EQ(equity_run(&pool, &spot, 1000, 0, 1, &r), -1);
+
+    spot = aces_kings();
+    spot.board = set_of({ACE OF SPADE, TWO OF CLUB, THREE OF CLUB});
+    EXPECT_EQ(equity_run(&pool, &spot, 1000, 0, 1, &r), -1);
+
+    spot = aces_kings();
+    spot.board = set_of({TWO OF CLUB, THREE OF CLUB, FOUR OF CLUB, FIVE OF CLUB, SIX OF CLUB, SEVEN OF CLUB});
+    EXPECT_EQ(equity_run(&pool, &spot, 1000, 0, 1, &r), -1);
+
+    spot = {};
+    EXPECT_EQ(equity_run(&pool, &spot, 1000, 0, 1, &r), -1);
+}
+
+TEST(EquitySpotOfGame, TakesTheSeatsStillIn) {
+    game_state_t game;
+    init_game_state(&game, 100, 3);
+    game.round_stage = ROUND_INIT;
+    for (int i = 0; i < MAX_PLAYERS; i++) {
+        game.player_status[i] = i < 4 ? PLAYER_ACTIVE : PLAYER_LEFT;
+    }
+    reset_game_state(&game);
+    server_deal(&game);
+    game.player_status[1] = PLAYER_FOLDED;
+    game.player_status[3] = PLAYER_ALLIN;
+    server_community(&game);
+
+    equity_spot_t spot;
+    equity_spot_of_game(&game, &spot);
+    EXPECT_EQ(spot.hands[0], game.hand_sets[0]);
+    EXPECT_EQ(spot.hands[1], CARD_SET_EMPTY);
+    EXPECT_EQ(spot.hands[2], game.hand_sets[2]);
+    EXPECT_EQ(spot.hands[3], game.hand_sets[3]);
+    EXPECT_EQ(spot.hands[4], CARD_SET_EMPTY);
+    EXPECT_EQ(card_set_count(spot.board), 3);
+    EXPECT_EQ(spot.board, game.board_set);
+    EXPECT_EQ(spot.dead, game.hand_sets[1]);
+}
+
+// every lane of a batch, padded or not, gets what hand_eval() gives the same cards
+TEST(HandEvalBatch, MatchesHandEval) {
+    hand_eval_init();
+    const int n = 37;
+    std::vector<card_t> cards(HAND_BATCH_CARDS * n);
+    std::vector<uint64_t> values(n);
+    uint64_t rng = 1;
+    for (int i = 0; i < n; i++) {
+        card_set_t used = CARD_SET_EMPTY;
+        int count = 5 + i % 3;
+        for (int k = 0; k < HAND_BATCH_CARDS; k++) {
+            card_t c = NOCARD;
+            while (k < count) {
+                rng = rng * 6364136223846793005ULL + 1442695040888963407ULL;
+                c = (card_t)((rng >> 33) % 52);
+                if (!(used & CARD_SET_BIT(c))) {
+                    break;
+                }
+            }
+            if (c != NOCARD) {
+                used |= CARD_SET_BIT(c);
+            }
+            cards[k * n + i] = c;
+        }
+    }
+    hand_eval_batch(cards.data(), n, values.data());
+    for (int i = 0; i < n; i++) {
+        card_t hand[HAND_BATCH_CARDS];
+        int count = 0;
+        for (int k = 0; k < HAND_BATCH_CARDS; k++) {
+            if (cards[k * n + i] != NOCARD) {
+                hand[count++] = cards[k * n + i];
+            }
+        }
+        EXPECT_EQ(values[i], hand_eval(hand, count)) << "hand " << i;
+    }
+}
+
+TEST(EquityMargin, IsTheNormalInterval) {
+    EXPECT_DOUBLE_EQ(equity_margin(0.25, 10000), EQUITY_Z_95 * 0.005);
+    EXPECT_EQ(equity_margin(0, 10000), 0);
+    EXPECT_EQ(equity_margin(-1e-18, 10000), 0);
+    EXPECT_EQ(equity_margin(0.25, 0), 0);
+}
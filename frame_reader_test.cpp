@@ -0,0 +1,164 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <vector>
+#include <sys/socket.h>
+#include <unistd.h>
+
+extern "C" {
+#include "frame_reader.h"
+}
+
+// a RAISE whose seq tells the frames apart and whose amount makes them different sizes
+static std::vector<uint8_t> frame_of(int seq) {
+    client_packet_t pkt = {};
+    pkt.packet_type = RAISE;
+    pkt.seq = seq;
+    pkt.params[0] = seq * 997;
+    wire_buf_t buf;
+    EXPECT_GT(wire_encode_client(&pkt, &buf), 0);
+    return std::vector<uint8_t>(buf.bytes, buf.bytes + buf.len);
+}
+
+static void expect_packet(frame_reader_t *rd, int seq) {
+    client_packet_t pkt;
+    ASSERT_EQ(frame_reader_next_client(rd, &pkt), 1) << seq;
+    EXPECT_EQ(pkt.packet_type, RAISE);
+    EXPECT_EQ(pkt.seq, seq);
+    EXPECT_EQ(pkt.params[0], seq * 997);
+}
+
+TEST(FrameReader, FrameSplitIntoSingleBytes) {
+    frame_reader_t rd;
+    frame_reader_init(&rd);
+    client_packet_t pkt;
+    std::vector<uint8_t> frame = frame_of(70000);
+    for (size_t i = 0; i + 1 < frame.size(); i++) {
+        ASSERT_EQ(frame_reader_push(&rd, &frame[i], 1), 0);
+        EXPECT_EQ(frame_reader_next_client(&rd, &pkt), 0) << i;
+    }
+    ASSERT_EQ(frame_reader_push(&rd, &frame.back(), 1), 0);
+    expect_packet(&rd, 70000);
+    EXPECT_EQ(frame_reader_next_client(&rd, &pkt), 0);
+}
+
+TEST(FrameReader, CoalescedFramesComeOutInOrder) {
+    frame_reader_t rd;
+    frame_reader_init(&rd);
+    std::vector<uint8_t> bytes;
+    for (int seq = 1; seq <= 5; seq++) {
+        std::vector<uint8_t> frame = frame_of(seq);
+        bytes.insert(bytes.end(), frame.begin(), frame.end());
+    }
+    // the last frame is cut short and finished by the next push
+    std::vector<uint8_t> last = frame_of(6);
+    bytes.insert(bytes.end(), last.begin(), last.begin() + 3);
+
+    ASSERT_EQ(frame_reader_push(&rd, bytes.data(), bytes.size()), 0);
+    for (int seq = 1; seq <= 5; seq++) {
+        expect_packet(&rd, seq);
+    }
+    client_packet_t pkt;
+    EXPECT_EQ(frame_reader_next_client(&rd, &pkt), 0);
+    ASSERT_EQ(frame_reader_push(&rd, last.data() + 3, last.size() - 3), 0);
+    expect_packet(&rd, 6);
+}
+
+// far more than the buffer holds, pushed in chunks that cut frames at every point, so the
+// partial frame is slid to the front again and again
+TEST(FrameReader, CompactsAPartialFrameAcrossTheWholeBuffer) {
+    frame_reader_t rd;
+    frame_reader_init(&rd);
+    std::vector<uint8_t> bytes;
+    const int frames = 4000;
+    for (int seq = 0; seq < frames; seq++) {
+        std::vector<uint8_t> frame = frame_of(seq);
+        bytes.insert(bytes.end(), frame.begin(), frame.end());
+    }
+    ASSERT_GT(bytes.size(), 4u * FRAME_READER_SIZE);
+
+    int next = 0;
+    size_t chunk = 1;
+    for (size_t off = 0; off < bytes.size(); off += chunk, chunk = chunk % 97 + 1) {
+        chunk = std::min(chunk, bytes.size() - off);
+        ASSERT_EQ(frame_reader_push(&rd, &bytes[off], chunk), 0) << off;
+        client_packet_t pkt;
+        int r;
+        while ((r = frame_reader_next_client(&rd, &pkt)) == 1) {
+            ASSERT_EQ(pkt.seq, next);
+            ASSERT_EQ(pkt.params[0], next * 997);
+            next++;
+        }
+        ASSERT_EQ(r, 0);
+        ASSERT_LE(rd.end, (size_t)FRAME_READER_SIZE);
+    }
+    EXPECT_EQ(next, frames);
+    EXPECT_EQ(rd.start, rd.end);
+}
+
+TEST(FrameReader, PushThatDoesNotFitIsRefused) {
+    frame_reader_t rd;
+    frame_reader_init(&rd);
+    std::vector<uint8_t> frame = frame_of(1);
+    std::vector<uint8_t> filler(FRAME_READER_SIZE - frame.size() + 1, 0);
+    ASSERT_EQ(frame_reader_push(&rd, frame.data(), frame.size()), 0);
+    EXPECT_EQ(frame_reader_push(&rd, filler.data(), filler.size()), -1);
+    // what was there is untouched
+    expect_packet(&rd, 1);
+
+    std::vector<uint8_t> too_big(FRAME_READER_SIZE + 1, 0);
+    EXPECT_EQ(frame_reader_push(&rd, too_big.data(), too_big.size()), -1);
+}
+
+TEST(FrameReader, CorruptStreamIsReported) {
+    frame_reader_t rd;
+    frame_reader_init(&rd);
+    std::vector<uint8_t> good = frame_of(1), bad = frame_of(2);
+    bad[2] = WIRE_VERSION + 1;
+    ASSERT_EQ(frame_reader_push(&rd, good.data(), good.size()), 0);
+    ASSERT_EQ(frame_reader_push(&rd, bad.data(), bad.size()), 0);
+    expect_packet(&rd, 1);
+    client_packet_t pkt;
+    EXPECT_EQ(frame_reader_next_client(&rd, &pkt), -1);
+
+    // a length no frame can have is caught before the body arrives
+    frame_reader_init(&rd);
+    uint8_t header[] = {0x7F, 0xFF};
+    ASSERT_EQ(frame_reader_push(&rd, header, sizeof(header)), 0);
+    EXPECT_EQ(frame_reader_next_client(&rd, &pkt), 0);
+    uint8_t rest[] = {WIRE_VERSION, RAISE};
+    ASSERT_EQ(frame_reader_push(&rd, rest, sizeof(rest)), 0);
+    EXPECT_EQ(frame_reader_next_client(&rd, &pkt), -1);
+}
+
+// what a stream socket hands over: one frame over several sends, then several in one
+TEST(FrameReader, FillsFromASocket) {
+    int sv[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, sv), 0);
+    frame_reader_t rd;
+    frame_reader_init(&rd);
+    client_packet_t pkt;
+
+    std::vector<uint8_t> split = frame_of(12345);
+    ASSERT_EQ(send(sv[0], split.data(), 2, 0), 2);
+    ASSERT_EQ(frame_reader_fill(&rd, sv[1], 0), 2);
+    EXPECT_EQ(frame_reader_next_client(&rd, &pkt), 0);
+    ASSERT_EQ(send(sv[0], split.data() + 2, split.size() - 2, 0), (ssize_t)split.size() - 2);
+    ASSERT_EQ(frame_reader_fill(&rd, sv[1], 0), (ssize_t)split.size() - 2);
+    expect_packet(&rd, 12345);
+
+    std::vector<uint8_t> bytes;
+    for (int seq = 1; seq <= 3; seq++) {
+        std::vector<uint8_t> frame = frame_of(seq);
+        bytes.insert(bytes.end(), frame.begin(), frame.end());
+    }
+    ASSERT_EQ(send(sv[0], bytes.data(), bytes.size(), 0), (ssize_t)bytes.size());
+    ASSERT_EQ(frame_reader_fill(&rd, sv[1], 0), (ssize_t)bytes.size());
+    for (int seq = 1; seq <= 3; seq++) {
+        expect_packet(&rd, seq);
+    }
+    EXPECT_EQ(frame_reader_fill(&rd, sv[1], MSG_DONTWAIT), -1);
+
+    close(sv[0]);
+    EXPECT_EQ(frame_reader_fill(&rd, sv[1], 0), 0);
+    close(sv[1]);
+}
@@ -0,0 +1,108 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <map>
+#include <random>
+#include <set>
+
+extern "C" {
+#include "hand_iso.h"
+#include "game_logic.h"
+}
+
+static const int board_sizes[] = {0, 3, 4, 5};
+
+// the 24 orderings of the suits
+static std::vector<std::array<int, 4>> suit_perms() {
+    std::vector<std::array<int, 4>> perms;
+    std::array<int, 4> p = {0, 1, 2, 3};
+    do {
+        perms.push_back(p);
+    } while (std::next_permutation(p.begin(), p.end()));
+    return perms;
+}
+
+static card_set_t deal(std::mt19937_64 &rng, card_set_t &live, int n) {
+    card_set_t dealt = CARD_SET_EMPTY;
+    for (int k = 0; k < n; k++) {
+        card_t card = card_set_nth(live, (int)(rng() % card_set_count(live)));
+        live &= ~CARD_SET_BIT(card);
+        dealt |= CARD_SET_BIT(card);
+    }
+    return dealt;
+}
+
+// whether some relabelling of the suits takes one situation to the other
+static bool same_up_to_suits(card_set_t hand, card_set_t board, card_set_t hand2, card_set_t board2) {
+    for (const auto &p : suit_perms()) {
+        if (card_set_permute_suits(hand, p.data()) == hand2 && card_set_permute_suits(board, p.data()) == board2) {
+            return true;
+        }
+    }
+    return false;
+}
+
+TEST(HandIso, Sizes) {
+    EXPECT_EQ(hand_iso_size(0), 169u);
+    EXPECT_EQ(hand_iso_size(3), 1286792u);
+    EXPECT_EQ(hand_iso_size(4), 13960050u);
+    EXPECT_EQ(hand_iso_size(5), 123156254u);
+    EXPECT_EQ(hand_iso_size(6), 0u);
+}
+
+// every starting hand against its least relabelling: the index has to split them the same way
+TEST(HandIso, PreflopClassesMatchBruteForce) {
+    std::map<card_set_t, uint64_t> index_of_class;
+    std::set<uint64_t> indices;
+    for (card_set_t a = CARD_SET_DECK; a; a &= a - 1) {
+        for (card_set_t b = a & (a - 1); b; b &= b - 1) {
+            card_set_t hand = (a & -a) | (b & -b);
+            card_set_t least = hand;
+            for (const auto &p : suit_perms()) {
+                least = std::min(least, card_set_permute_suits(hand, p.data()));
+            }
+            uint64_t index = hand_iso_index(hand, CARD_SET_EMPTY);
+            ASSERT_LT(index, 169u);
+            auto seen = index_of_class.emplace(least, index);
+            EXPECT_EQ(seen.first->second, index);
+            indices.insert(index);
+        }
+    }
+    EXPECT_EQ(index_of_class.size(), 169u);
+    EXPECT_EQ(indices.size(), 169u);
+}
+
+// every flop index stands for a real situation that indexes back to it
+TEST(HandIso, EveryFlopIndexIsUsed) {
+    for (uint64_t i = 0; i < hand_iso_size(3); i++) {
+        card_set_t hand, board;
+        hand_iso_unindex(3, i, &hand, &board);
+        ASSERT_EQ(card_set_count(hand), HAND_SIZE);
+        ASSERT_EQ(card_set_count(board), 3);
+        ASSERT_EQ(hand & board, CARD_SET_EMPTY);
+        ASSERT_EQ((hand | board) & ~CARD_SET_DECK, CARD_SET_EMPTY);
+        ASSERT_EQ(hand_iso_index(hand, board), i);
+    }
+}
+
+// random situations under random relabellings: the index does not move, and the form it
+// unindexes to is the same situation up to the suits
+TEST(HandIso, RelabellingKeepsTheIndex) {
+    std::mt19937_64 rng(7);
+    auto perms = suit_perms();
+    for (int t = 0; t < 100000; t++) {
+        int b = board_sizes[t % 4];
+        card_set_t live = CARD_SET_DECK;
+        card_set_t hand = deal(rng, live, HAND_SIZE);
+        card_set_t board = deal(rng, live, b);
+        const auto &p = perms[rng() % perms.size()];
+
+        uint64_t index = hand_iso_index(hand, board);
+        ASSERT_LT(index, hand_iso_size(b));
+        ASSERT_EQ(hand_iso_index(card_set_permute_suits(hand, p.data()), card_set_permute_suits(board, p.data())), index)
+            << "trial " << t;
+
+        card_set_t canon_hand, canon_board;
+        hand_iso_unindex(b, index, &canon_hand, &canon_board);
+        ASSERT_TRUE(same_up_to_suits(hand, board, canon_hand, canon_board)) << "trial " << t;
+    }
+}
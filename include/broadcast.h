@@ -0,0 +1,91 @@
+#ifndef BROADCAST_H
+#define BROADCAST_H
+
+#include "poker_client.h"
+#include "game_logic.h"
+#include "wire.h"
+#include "connection.h"
+
+/**
+ * @brief everything a table sends while it handles one event
+ *
+ * the public part of an INFO/END/HALT is encoded once for the whole table. on flush
+ * every seat gets its own reply (if one is queued) followed by the shared packet, with
+ * its hole cards spliced into an INFO, in a single connection_send()
+ *
+ * every INFO gets a new version. a seat that joined with JOIN_DELTA_INFO and holds the
+ * previous version is sent a DELTA instead, which is also built once for the table
+ */
+typedef struct {
+    wire_buf_t replies[MAX_PLAYERS];        // ACK/NACK queued for a single seat
+    int has_reply[MAX_PLAYERS];
+    wire_buf_t shared;                      // INFO/END/HALT for every seated player
+    server_packet_type_t shared_type;
+    int has_shared;
+    wire_buf_t delta;                       // the shared INFO as changes to the previous one
+    int delta_base;                         // the version the delta applies to
+    int has_delta;
+    info_packet_t last_info;                // public part of the last INFO queued
+    int info_version;                       // version of last_info, 0 before the first INFO
+    int seat_version[MAX_PLAYERS];          // INFO version each seat holds, 0 if none
+    int wants_delta[MAX_PLAYERS];
+} outbox_t;
+
+/**
+ * @brief empties the outbox without sending anything
+ */
+void outbox_reset(outbox_t *box);
+
+/**
+ * @brief starts tracking a newly seated player, who gets a full INFO first
+ *
+ * @param flags the JOIN_* flags the player joined with
+ */
+void outbox_subscribe(outbox_t *box, player_id_t pid, int flags);
+
+/**
+ * @brief queues a packet for one seat only, sent ahead of any shared packet
+ */
+void outbox_reply(outbox_t *box, player_id_t pid, const server_packet_t *pkt);
+
+/**
+ * @brief queues the answer to a JOIN or RESUME for the seat in join
+ */
+void outbox_joined(outbox_t *box, const join_packet_t *join, int seq);
+
+/**
+ * @brief queues an INFO for every seat; each seat gets its own hole cards on flush
+ */
+void outbox_info(outbox_t *box, game_state_t *game);
+
+/**
+ * @brief queues an INFO that every seat gets in full, e.g. at the start of a hand
+ */
+void outbox_snapshot(outbox_t *box, game_state_t *game);
+
+/**
+ * @brief queues the current INFO in full for one seat that lost track of the deltas
+ */
+void outbox_resync(outbox_t *box, game_state_t *game, player_id_t pid);
+
+/**
+ * @brief queues the END of the hand for every seat
+ */
+void outbox_end(outbox_t *box, game_state_t *game, player_id_t winner);
+
+/**
+ * @brief queues a HALT for every seat
+ */
+void outbox_halt(outbox_t *box);
+
+/**
+ * @brief writes everything queued to the seats, then empties the outbox
+ *
+ * a seat whose connection is congested is not sent INFOs, and falls behind the current version
+ *
+ * @param conns the connection of every seat, NULL for a seat without one
+ * @return a bit per seat whose connection fell too far behind and has to be dropped
+ */
+unsigned outbox_flush(outbox_t *box, game_state_t *game, connection_t *const conns[MAX_PLAYERS]);
+
+#endif
@@ -0,0 +1,77 @@
+#ifndef CARD_SET_H
+#define CARD_SET_H
+
+#include <stdint.h>
+
+#include "poker_client.h"  // for card_t
+
+/**
+ * a set of cards as a 64-bit board, one bit per card
+ *
+ * each suit has a 16-bit lane, and within it bit r is rank r (see macros.h):
+ *      bit = 16 * SUITE(card) + RANK(card)
+ * so the ranks held in a suit are one shift away, the size of a set is a popcount, and
+ * removing dead cards from a deck is a mask. bits 13-15 of every lane are always clear
+ */
+typedef uint64_t card_set_t;
+
+#define CARD_SET_LANE 16
+#define CARD_SET_EMPTY ((card_set_t)0)
+#define CARD_SET_DECK ((card_set_t)0x1FFF1FFF1FFF1FFFull)
+
+#define CARD_SET_BIT(card) ((card_set_t)1 << (CARD_SET_LANE * SUITE((card)) + RANK((card))))
+#define CARD_SET_SUIT(set, suit) ((uint16_t)((set) >> (CARD_SET_LANE * (suit))) & 0x1FFF)
+#define CARD_SET_HAS(set, card) (((set) & CARD_SET_BIT(card)) != 0)
+
+/**
+ * @brief CARD_SET_BIT() as a function, for a card that is a call or has side effects: the
+ *        macro reads its argument once for the suit and once for the rank
+ */
+static inline card_set_t card_set_bit(card_t card)
+{
+    return CARD_SET_BIT(card);
+}
+
+/**
+ * @brief the set of n cards; NOCARD entries are skipped
+ */
+card_set_t card_set_of(const card_t *cards, int n);
+
+/**
+ * @brief the number of cards in a set
+ */
+int card_set_count(card_set_t set);
+
+/**
+ * @brief the card at a bit of a set, the inverse of CARD_SET_BIT()
+ */
+card_t card_set_card(int bit);
+
+/**
+ * @brief the lowest card of a set (by suit, then rank), NOCARD if the set is empty
+ */
+card_t card_set_first(card_set_t set);
+
+/**
+ * @brief the n-th card of a set in the order of card_set_first(), for drawing from a deck
+ *
+ * @return the card, or NOCARD if the set holds n cards or fewer
+ */
+card_t card_set_nth(card_set_t set, int n);
+
+/**
+ * @brief writes the cards of a set out as card_t values, in the order of card_set_first()
+ *
+ * @param cards room for card_set_count(set) cards
+ * @return the number of cards written
+ */
+int card_set_cards(card_set_t set, card_t *cards);
+
+/**
+ * @brief the set with its suits relabelled: the cards of suit s move to suit perm[s]
+ *
+ * @param perm a permutation of the four suits
+ */
+card_set_t card_set_permute_suits(card_set_t set, const int perm[4]);
+
+#endif
@@ -0,0 +1,156 @@
+#ifndef CONNECTION_H
+#define CONNECTION_H
+
+#include <stdint.h>
+#include <sys/uio.h>
+
+#include "poker_client.h"
+#include "frame_reader.h"
+#include "transport.h"
+#include "mpsc_queue.h"
+
+/**
+ * how a client connection is shared between the two threads that deal with it
+ *
+ * a network thread owns the socket: it reads and decodes the packets, and posts each one as a
+ * command onto the queue of the table the connection joined. the engine thread that owns the
+ * table runs the commands through the game and writes its frames into the connection's out
+ * ring, a single producer single consumer ring the network thread sends from. a connection
+ * the engine wrote to goes onto its network thread's outbound queue once, until that thread
+ * takes it off again and sends what the ring holds
+ *
+ * the engine is done with a connection once it closes it. the network thread closes the socket
+ * after the last frame, and posts the connection's release, the last command about it; the
+ * engine frees the connection as it takes that command
+ */
+
+/**
+ * @brief the connections of one network thread that have frames waiting
+ */
+typedef struct {
+    mpsc_queue_t ready;
+    mpsc_bell_t bell;
+} outbound_t;
+
+typedef enum {
+    COMMAND_JOIN,                           // pkt is the JOIN or RESUME the connection opened with
+    COMMAND_PACKET,                         // pkt is the next packet of the connection
+    COMMAND_LOST,                           // the peer closed the connection or reading it failed
+    COMMAND_CORRUPT,                        // the connection sent something that is not a frame
+    COMMAND_SLOW,                           // the connection's send queue overflowed
+    COMMAND_DRAINED,                        // the connection drained to the low watermark
+    COMMAND_RELEASE,                        // the socket is closed; nothing comes after this
+    COMMAND_EQUITY                          // an equity run the table asked for came back; conn is NULL
+} command_kind_t;
+
+/**
+ * @brief what a network thread tells the engine of a table about one of its connections
+ */
+typedef struct {
+    mpsc_node_t node;                       // first, so a node popped off a table's queue is the command
+    command_kind_t kind;
+    int allocated;                          // taken from the heap, rather than one of the connection's own
+    struct connection *conn;
+    client_packet_t pkt;
+} command_t;
+
+typedef struct connection {
+    // the network thread's
+    int fd;
+    uint32_t gen;                           // tells this connection from an earlier one on the same fd
+    int table_id;                           // the table it asked to join, -1 until its JOIN is read
+    int lost;                               // the engine was told it is gone: nothing more is read or sent
+    int shm_fd;                             // a channel passed along before the JOIN was complete, -1 if none
+    shm_channel_t *shm;                     // the rings the client talks through, NULL if it uses its socket
+    frame_reader_t rx;
+    command_t join, gone, release;          // sent once each: the JOIN, LOST/CORRUPT/SLOW, and the release
+
+    // the engine's
+    player_id_t pid;                        // the seat it holds, -1 if none
+
+    // both
+    outbound_t *outbound;                   // of the network thread, never changes
+    mpsc_node_t ready;                      // on the outbound queue
+    int queued;                             // is on the outbound queue, or about to be
+    int closed;                             // the engine is done with it
+    int congested;                          // the socket is over its high watermark, as last seen
+    shm_ring_t out;                         // frames from the engine
+} connection_t;
+
+/**
+ * @brief sets up a connection for a socket a network thread just accepted
+ *
+ * @return the connection, or NULL on failure
+ */
+connection_t *connection_new(int fd, uint32_t gen, outbound_t *outbound);
+
+/**
+ * @brief frees a connection, once its socket is closed and nothing refers to it
+ */
+void connection_free(connection_t *conn);
+
+/**
+ * @brief wraps a packet of a connection as a command for its table
+ *
+ * @return the command, or NULL if it could not be allocated
+ */
+command_t *command_new(connection_t *conn, command_kind_t kind, const client_packet_t *pkt);
+
+/**
+ * @brief frees a command taken off a table's queue, unless it belongs to its connection
+ */
+void command_free(command_t *cmd);
+
+/**
+ * @brief queues frames for the connection's network thread to send, from the engine
+ *
+ * @return 0 on success, -1 if the frames do not fit in the out ring. nothing is queued then
+ *         and the connection should be closed
+ */
+int connection_send(connection_t *conn, const struct iovec *iov, int iovcnt);
+
+/**
+ * @brief checks if the connection is over its high watermark, from the engine
+ */
+int connection_congested(connection_t *conn);
+
+/**
+ * @brief tells the network thread to close the connection after what was sent so far
+ */
+void connection_close(connection_t *conn);
+
+/**
+ * @brief checks if the engine closed the connection, from the network thread
+ *
+ * looked at before sending what the out ring holds, so the last frames still go out
+ */
+int connection_closing(connection_t *conn);
+
+/**
+ * @brief checks that the engine is done queueing a connection it closed, from the network thread
+ *
+ * @return 1 if the socket can be closed now, 0 if the engine queued the connection once more
+ *         as it closed it; it then comes off the outbound queue again
+ */
+int connection_done(connection_t *conn);
+
+/**
+ * @brief initializes an empty outbound queue
+ *
+ * @return 0 on success, -1 otherwise
+ */
+int outbound_init(outbound_t *outbound);
+
+/**
+ * @brief takes the next connection with frames to send, from the network thread
+ *
+ * @return the connection, or NULL if there is none
+ */
+connection_t *outbound_pop(outbound_t *outbound);
+
+/**
+ * @brief closes the outbound queue's bell
+ */
+void outbound_fini(outbound_t *outbound);
+
+#endif
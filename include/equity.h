@@ -0,0 +1,136 @@
+#ifndef EQUITY_H
+#define EQUITY_H
+
+#include <stdint.h>
+#include <pthread.h>
+
+#include "poker_client.h"  // for MAX_PLAYERS
+#include "card_set.h"      // for card_set_t
+#include "game_logic.h"    // for game_state_t
+
+#define EQUITY_MAX_THREADS 64
+
+// runouts a thread deals before it adds them to the totals and checks whether to stop
+#define EQUITY_CHUNK 1024
+
+// hands a thread values in one hand_eval_batch() call; a whole number of vector lanes
+#define EQUITY_BATCH 96
+
+// z-score of a 95% confidence interval
+#define EQUITY_Z_95 1.96
+
+// the fewest runouts a run can stop early after
+#define EQUITY_MIN_TRIALS (4 * EQUITY_CHUNK)
+
+/**
+ * a spot to run out: the hole cards of every seat still in, the board so far, and the cards
+ * known to be out of the deck
+ */
+typedef struct {
+    card_set_t hands[MAX_PLAYERS];          // the seat's two hole cards, CARD_SET_EMPTY if it is not in
+    card_set_t board;                       // 0 to 5 cards
+    card_set_t dead;                        // folded or otherwise seen cards that cannot come
+    int random_hands;                       // opponents whose hole cards are dealt with each runout
+} equity_spot_t;
+
+typedef struct {
+    uint64_t trials;                        // runouts dealt
+    int exact;                              // every runout was dealt once; the margins are 0
+    double win[MAX_PLAYERS];                // share of runouts the seat won outright
+    double tie[MAX_PLAYERS];                // share of runouts it split
+    double equity[MAX_PLAYERS];             // share of the pot it takes on average, splits divided
+    double margin[MAX_PLAYERS];             // half-width of the 95% confidence interval on equity
+} equity_result_t;
+
+/**
+ * one run as the pool's threads see it
+ */
+typedef struct {
+    equity_spot_t spot;
+    int need;                               // board cards to deal
+    int exact;                              // enumerate every runout instead of sampling
+    uint64_t combinations;                  // runouts there are, C(live cards, need)
+    uint64_t max_chunks;
+    double target_margin;
+    uint64_t seed;
+    uint64_t next_chunk;                    // handed out by fetch-and-add
+    int stop;                               // set once the totals are tight enough
+    // totals, under the pool's lock
+    uint64_t trials;
+    uint64_t wins[MAX_PLAYERS], ties[MAX_PLAYERS];
+    uint64_t share[MAX_PLAYERS], share_sq[MAX_PLAYERS];   // in 60ths of the pot
+} equity_job_t;
+
+/**
+ * @brief threads that deal runouts of a spot and value every hand in them
+ *
+ * a run hands out chunks of EQUITY_CHUNK runouts; the thread that takes a chunk enumerates
+ * them, or draws them from the live cards of the spot with the chunk's own random stream,
+ * values them in batches through hand_eval_batch(), and adds them to the totals at the end of the chunk.
+ * runs are taken one at a time, from any thread
+ */
+typedef struct {
+    pthread_t threads[EQUITY_MAX_THREADS];
+    int num_threads;
+    pthread_mutex_t lock;
+    pthread_cond_t work;                    // a run was posted, or the pool is shutting down
+    pthread_cond_t done;                    // the last thread finished its part of the run
+    pthread_mutex_t run_lock;               // held by the caller for the whole of a run
+    uint64_t run_id;                        // bumped for every run
+    int busy;                               // threads still working on the current run
+    int stopping;
+    equity_job_t job;
+} equity_pool_t;
+
+/**
+ * @brief starts the pool's threads
+ *
+ * @param num_threads 1 to EQUITY_MAX_THREADS
+ * @return 0 on success, -1 otherwise
+ */
+int equity_pool_init(equity_pool_t *pool, int num_threads);
+
+/**
+ * @brief stops and joins the pool's threads
+ */
+void equity_pool_fini(equity_pool_t *pool);
+
+/**
+ * @brief works out every seat's chances in a spot
+ *
+ * if there are no more runouts than max_trials, and no random hands to deal, every one of
+ * them is dealt once and the result is exact: the runouts are numbered by the combinatorial number system and split
+ * into chunks of consecutive numbers, so a thread starts its chunk from its first number and
+ * steps through the rest. that covers any turn or river spot, and most flops. otherwise the
+ * runouts are sampled at random. random hands are dealt from what is left after the board;
+ * they take their part of any split, but get no result of their own. a run of a single
+ * chunk is done on the calling thread
+ *
+ * @param max_trials runouts to deal at most, rounded up to whole chunks
+ * @param target_margin when sampling, stop once every seat's margin is at most this, after
+ *        at least EQUITY_MIN_TRIALS runouts; 0 to always deal max_trials
+ * @param seed chunk c draws from a stream seeded by seed and c, so a run that is not
+ *        stopped early gives the same result however many threads the pool has
+ * @return 0 on success, -1 if max_trials is 0 or the spot is not valid (cards held twice, a
+ *         seat with other than two hole cards, more than five board cards, no seat in, more
+ *         hands than seats, or too few cards left to finish the board and deal the random
+ *         hands)
+ */
+int equity_run(equity_pool_t *pool, const equity_spot_t *spot, uint64_t max_trials,
+               double target_margin, uint64_t seed, equity_result_t *result);
+
+/**
+ * @brief half-width of the 95% confidence interval on a mean over trials samples
+ *
+ * @param variance of one sample; p * (1 - p) for a share that is either all or nothing
+ * @return the margin, 0 if variance or trials is 0
+ */
+double equity_margin(double variance, uint64_t trials);
+
+/**
+ * @brief the spot a table is in: every seat that is active or all in, the board dealt so
+ *        far, and the folded hands as dead cards
+ */
+void equity_spot_of_game(const game_state_t *game, equity_spot_t *spot);
+
+#endif
@@ -0,0 +1,124 @@
+#ifndef EQUITY_CACHE_H
+#define EQUITY_CACHE_H
+
+#include <stdint.h>
+#include <pthread.h>
+
+#include "equity.h"
+#include "preflop_table.h"
+
+// the cache is split into shards by key hash, each with its own lock and LRU list
+#define EQUITY_CACHE_SHARDS 16
+
+// target margins are kept as whole steps of 1/EQUITY_MARGIN_STEPS
+#define EQUITY_MARGIN_STEPS 10000
+
+/**
+ * what an outlook is cached under: the hand and board up to the suits, and how it was run
+ */
+typedef struct {
+    uint64_t index;                         // hand_iso_index() of the hand and board
+    uint64_t max_trials;
+    uint32_t margin;                        // target margin in EQUITY_MARGIN_STEPS
+    uint8_t board_cards;
+    uint8_t opponents;
+} equity_key_t;
+
+/**
+ * how a hand stands on a board against opponents whose cards are not known
+ */
+typedef struct {
+    double strength;                        // share of the pot it takes against one random hand as the board stands, exact
+    double equity;                          // share it takes once the board is out, against every opponent
+    double margin;                          // half-width of the 95% confidence interval on equity, 0 if exact
+    uint64_t trials;                        // runouts behind equity
+} hand_outlook_t;
+
+typedef struct equity_entry {
+    equity_key_t key;
+    hand_outlook_t outlook;
+    struct equity_entry *chain;             // next entry in the same bucket
+    struct equity_entry *newer, *older;     // place in the shard's LRU list
+} equity_entry_t;
+
+typedef struct {
+    pthread_mutex_t lock;
+    equity_entry_t *entries;                // capacity of them, handed out until all are used
+    int capacity;
+    int used;
+    equity_entry_t **buckets;
+    int num_buckets;
+    equity_entry_t lru;                     // list head: lru.older is the newest entry, lru.newer the oldest
+    uint64_t hits, misses;
+} equity_shard_t;
+
+/**
+ * @brief a bounded cache of hand outlooks shared by any number of threads
+ *
+ * a key goes to one shard by its hash; a lookup or insert locks only that shard. once a shard
+ * is full, an insert reuses its least recently used entry
+ */
+typedef struct {
+    equity_shard_t shards[EQUITY_CACHE_SHARDS];
+    const preflop_table_t *preflop;         // where preflop equities are read from, NULL to run them
+} equity_cache_t;
+
+/**
+ * @brief sets up an empty cache
+ *
+ * @param capacity outlooks to hold at most, spread over the shards
+ * @param preflop a mapped preflop table to take preflop equities from, or NULL (or a table
+ *        with nothing mapped) to run them like any other street; it has to outlive the cache
+ * @return 0 on success, -1 otherwise
+ */
+int equity_cache_init(equity_cache_t *cache, int capacity, const preflop_table_t *preflop);
+
+/**
+ * @brief frees the cache
+ */
+void equity_cache_fini(equity_cache_t *cache);
+
+/**
+ * @brief the key an outlook is cached under
+ *
+ * the margin is rounded to the nearest step, and anything at or below 0 is 0
+ */
+void equity_key_of(card_set_t hand, card_set_t board, int opponents, uint64_t max_trials,
+                   double target_margin, equity_key_t *key);
+
+/**
+ * @brief looks up an outlook, marking it as the most recently used
+ *
+ * @return 1 and the outlook if it is cached, 0 otherwise
+ */
+int equity_cache_get(equity_cache_t *cache, const equity_key_t *key, hand_outlook_t *outlook);
+
+/**
+ * @brief caches an outlook, replacing the one already under the key if there is one
+ */
+void equity_cache_put(equity_cache_t *cache, const equity_key_t *key, const hand_outlook_t *outlook);
+
+/**
+ * @brief how two hole cards stand on a board against random opponents, through the cache
+ *
+ * any suit relabelling of a hand and board seen before, with the same opponents, max_trials
+ * and target margin, is answered from the cache. on a miss the outlook is worked out for the
+ * form hand_iso_unindex() gives, so the seed gives the same outlook whichever relabelling came
+ * in. strength is counted over every hole pair left; equity is an equity_run() of the hand
+ * against opponents random hands, except on the river heads up, where it is the strength,
+ * and preflop with a table, where it is the table's entry and its margin and trials are the
+ * table's
+ *
+ * @param opponents 1 to MAX_PLAYERS - 1
+ * @return 0 on success, -1 if equity_run() would turn the spot down
+ */
+int equity_hand_cached(equity_cache_t *cache, equity_pool_t *pool, card_set_t hand, card_set_t board,
+                       int opponents, uint64_t max_trials, double target_margin, uint64_t seed,
+                       hand_outlook_t *outlook);
+
+/**
+ * @brief the cache's hits and misses so far, summed over the shards
+ */
+void equity_cache_stats(equity_cache_t *cache, uint64_t *hits, uint64_t *misses);
+
+#endif
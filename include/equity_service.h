@@ -0,0 +1,87 @@
+#ifndef EQUITY_SERVICE_H
+#define EQUITY_SERVICE_H
+
+#include <stdint.h>
+#include <pthread.h>
+
+#include "connection.h"    // for command_t
+#include "mpsc_queue.h"
+#include "equity.h"
+#include "equity_cache.h"
+
+// requests taken but not yet handed back, past which equity_service_submit() turns more down
+#define EQUITY_SERVICE_BACKLOG 256
+
+typedef enum {
+    EQUITY_ALL_IN,                          // equity_run() of the spot
+    EQUITY_OUTLOOKS                         // equity_hand_cached() of every hand in the spot
+} equity_request_kind_t;
+
+/**
+ * @brief one run asked of the service, and its answer
+ *
+ * whoever submits it fills in the kind, spot and run settings, and gets it back through done
+ * on the service thread, answered or not. cmd comes first, so a request handed to a table as
+ * a COMMAND_EQUITY is freed with the command
+ */
+typedef struct equity_request {
+    command_t cmd;
+    mpsc_node_t node;                       // on the service's queue
+    equity_request_kind_t kind;
+    void (*done)(struct equity_request *req);
+    void *owner;                            // for done
+    int serial;                             // for done: what the owner was at when it asked
+    equity_spot_t spot;                     // OUTLOOKS: the hands to look at, the board, no dead cards
+    int opponents;                          // OUTLOOKS: random hands each is up against
+    uint64_t max_trials;
+    double target_margin;
+    uint64_t seed;
+    int answered;                           // the run was done and took the spot
+    equity_result_t result;                 // ALL_IN
+    int has_outlook[MAX_PLAYERS];           // OUTLOOKS: the seat's outlook was worked out
+    hand_outlook_t outlooks[MAX_PLAYERS];
+} equity_request_t;
+
+/**
+ * @brief a thread that takes equity runs off the engines
+ *
+ * engines submit requests without waiting; the service runs them one at a time on the pool,
+ * with outlooks through the cache, and hands each one back through its done callback. a
+ * request is never lost: one still queued when the service stops is handed back unanswered
+ */
+typedef struct {
+    equity_pool_t *pool;
+    equity_cache_t *cache;                  // NULL if outlooks are not asked for
+    mpsc_queue_t requests;
+    mpsc_bell_t bell;                       // rung after a request is submitted
+    pthread_t thread;
+    int started;
+    int stopping;
+    int pending;                            // submitted and not yet handed back
+} equity_service_t;
+
+/**
+ * @brief starts the service's thread
+ *
+ * @param pool where the runs are done; has to outlive the service
+ * @param cache where outlooks are looked up, or NULL; has to outlive the service
+ * @return 0 on success, -1 otherwise
+ */
+int equity_service_init(equity_service_t *svc, equity_pool_t *pool, equity_cache_t *cache);
+
+/**
+ * @brief hands back what is still queued, unanswered, and joins the thread
+ *
+ * nothing may be submitted once this is called
+ */
+void equity_service_fini(equity_service_t *svc);
+
+/**
+ * @brief queues a request, from any thread
+ *
+ * @return 0 if it was queued, and will come back through its done callback; -1 if
+ *         EQUITY_SERVICE_BACKLOG requests are pending already, in which case the caller keeps it
+ */
+int equity_service_submit(equity_service_t *svc, equity_request_t *req);
+
+#endif
@@ -0,0 +1,79 @@
+#ifndef FRAME_READER_H
+#define FRAME_READER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "wire.h"
+#include "transport.h"
+
+#define FRAME_READER_SIZE 4096
+
+/**
+ * @brief the receive side of one connection
+ *
+ * bytes are read in as large chunks as fit, so a single read may complete a frame that was
+ * split across segments and also bring in several frames that were sent back to back.
+ * frames are decoded in place and the buffer is reused for the life of the connection
+ */
+typedef struct {
+    uint8_t buf[FRAME_READER_SIZE];
+    size_t start;                           // first byte not yet decoded
+    size_t end;                             // one past the last byte received
+} frame_reader_t;
+
+/**
+ * @brief empties the reader, e.g. for a new connection
+ */
+void frame_reader_init(frame_reader_t *rd);
+
+/**
+ * @brief receives whatever fits in the reader with a single recv()
+ *
+ * @param rd the reader of the connection
+ * @param fd the socket to read from
+ * @param flags flags for recv(), e.g. MSG_DONTWAIT
+ * @return the number of bytes read, 0 when the peer closed the connection,
+ *         -1 on error (errno is set by recv())
+ */
+ssize_t frame_reader_fill(frame_reader_t *rd, int fd, int flags);
+
+/**
+ * @brief like frame_reader_fill(), but also takes a descriptor the peer passed along (SCM_RIGHTS)
+ *
+ * @param passed set to the descriptor, or left alone if none came with the bytes
+ */
+ssize_t frame_reader_fill_fd(frame_reader_t *rd, int fd, int flags, int *passed);
+
+/**
+ * @brief moves whatever fits in the reader out of a shared memory ring
+ *
+ * @return the number of bytes moved, -1 if the ring is corrupt
+ */
+ssize_t frame_reader_fill_ring(frame_reader_t *rd, shm_ring_t *ring);
+
+/**
+ * @brief appends bytes that were received some other way, e.g. into an io_uring buffer
+ *
+ * @return 0 on success, -1 if they do not fit in the reader
+ */
+int frame_reader_push(frame_reader_t *rd, const uint8_t *data, size_t len);
+
+/**
+ * @brief decodes the next complete client frame held by the reader
+ *
+ * @return 1 if a packet was decoded, 0 if no whole frame is buffered yet,
+ *         -1 if the stream is corrupt
+ */
+int frame_reader_next_client(frame_reader_t *rd, client_packet_t *pkt);
+
+/**
+ * @brief decodes the next complete server frame held by the reader
+ *
+ * @return 1 if a packet was decoded, 0 if no whole frame is buffered yet,
+ *         -1 if the stream is corrupt
+ */
+int frame_reader_next_server(frame_reader_t *rd, server_packet_t *pkt);
+
+#endif
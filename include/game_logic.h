@@ -1,8 +1,12 @@
 #ifndef GAME_LOGIC_H
 #define GAME_LOGIC_H
 
+#include <stdint.h>
+
 #include "poker_client.h"  // for card_t, player_id_t
 #include "macros.h"        // for constants like MAX_PLAYERS
+#include "card_set.h"      // for card_set_t
+#include "hand_eval.h"     // for hand_state_t
 
 #define MAX_COMMUNITY_CARDS 5
 #define HAND_SIZE 2
@@ -24,13 +28,25 @@ typedef enum {
     ROUND_SHOWDOWN = 6
 } round_stage_t;
 
+// per-table deck shuffler; produces the same sequence as srand()/rand() for a seed
+typedef struct {
+    int32_t state[31];
+    int front, rear;
+} deck_rng_t;
+
 typedef struct {
     card_t player_hands[MAX_PLAYERS][HAND_SIZE];   // each player’s 2 cards
     card_t community_cards[MAX_COMMUNITY_CARDS];   // shared cards on table
+    card_set_t hand_sets[MAX_PLAYERS];             // player_hands as sets
+    card_set_t board_set;                          // community_cards as a set
+    hand_state_t board_state;                      // board_set walked by the evaluator
+    card_set_t dealt_set;                          // every card drawn this hand (dead cards)
     card_t deck[DECK_SIZE];                        // main deck
+    deck_rng_t rng;                                // shuffles this table's deck
     int next_card;                                 // index of the next card to be drawn
     int player_stacks[MAX_PLAYERS];                // how many chips each player has
     int current_bets[MAX_PLAYERS];                 // amount bet this round
+    int has_acted[MAX_PLAYERS];                    // acted since the last raise this round
     int highest_bet;                               // highest bet to call to
     player_status_t player_status[MAX_PLAYERS];    // FOLDED, ACTIVE, etc
     int pot_size;                                  // total chips in pot
@@ -38,14 +54,14 @@ typedef struct {
     int dealer_player;                             // index of dealer TODO
     round_stage_t round_stage;                     // init/preflop/flop/turn/river/showdown
     int num_players;                               // total players in game
-    int sockets[MAX_PLAYERS];                      // sockets for each player
 } game_state_t;
 
 void init_game_state(game_state_t *game, int starting_stack, int random_seed);
 void reset_game_state(game_state_t *game);
 void print_game_state(game_state_t *game); // for debugging
-void init_deck(card_t deck[DECK_SIZE], int seed); 
-void shuffle_deck(card_t deck[DECK_SIZE]);
+void init_deck(card_t deck[DECK_SIZE]);
+void seed_deck_rng(deck_rng_t *rng, unsigned int seed);
+void shuffle_deck(card_t deck[DECK_SIZE], deck_rng_t *rng);
 int check_betting_end(game_state_t *game);
 int find_winner(game_state_t *game);
 int evaluate_hand(game_state_t *game, player_id_t pid);
@@ -55,6 +71,6 @@ int server_ready(game_state_t *game);
 void server_deal(game_state_t *game);
 int server_bet(game_state_t *game);
 void server_community(game_state_t *game);
-void server_end(game_state_t *game);
+int server_end(game_state_t *game);
 
 #endif
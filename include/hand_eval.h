@@ -0,0 +1,97 @@
+#ifndef HAND_EVAL_H
+#define HAND_EVAL_H
+
+#include <stdint.h>
+
+#include "poker_client.h"  // for card_t
+#include "card_set.h"      // for card_set_t
+
+/**
+ * the value of a hand of up to 7 cards; a higher value wins
+ *
+ * the category is in the top four bits and the ranks that break ties below it, four bits each:
+ *  HAND_STRAIGHT_FLUSH, HAND_STRAIGHT       - the high card
+ *  HAND_FOUR_OF_A_KIND, HAND_FULL_HOUSE     - the quads/trips, then the kicker/pair
+ *  HAND_FLUSH, HAND_HIGH_CARD               - the five highest ranks
+ *  HAND_THREE_OF_A_KIND, HAND_TWO_PAIR, HAND_ONE_PAIR - the made ranks, then the kickers
+ */
+
+enum {
+    HAND_HIGH_CARD = 1,
+    HAND_ONE_PAIR,
+    HAND_TWO_PAIR,
+    HAND_THREE_OF_A_KIND,
+    HAND_STRAIGHT,
+    HAND_FLUSH,
+    HAND_FULL_HOUSE,
+    HAND_FOUR_OF_A_KIND,
+    HAND_STRAIGHT_FLUSH
+};
+
+#define HAND_CATEGORY(value) ((int)((value) >> 60))
+
+// cards per hand in a batch
+#define HAND_BATCH_CARDS 7
+
+/**
+ * a hand part way through evaluation: its place in the rank walk and the cards it holds
+ *
+ * a board can be folded in street by street as it is dealt, and each player's hole cards are
+ * then added to a copy of it, so the shared cards are walked once rather than once per seat
+ */
+typedef struct {
+    uint32_t state;    // rank-count state reached so far
+    card_set_t cards;  // the cards walked, for the flush lookups
+} hand_state_t;
+
+#define HAND_STATE_EMPTY ((hand_state_t){0, CARD_SET_EMPTY})
+
+/**
+ * @brief picks the vector path hand_eval_batch() runs on
+ *
+ * the lookup tables behind every evaluation are generated at build time and need no setup.
+ * called by the first batch if not before; safe to call from any number of threads
+ */
+void hand_eval_init(void);
+
+/**
+ * @brief values a hand by table lookups: one step per card, then one per suit
+ *
+ * @param cards up to 7 distinct cards; NOCARD entries are skipped
+ * @param n the number of entries in cards
+ */
+uint64_t hand_eval(const card_t *cards, int n);
+
+/**
+ * @brief values a hand of up to 7 cards held as a set
+ *
+ * the rank walk takes one step per card as above, and the flush lookups read the suit lanes
+ * of the set as they are
+ */
+uint64_t hand_eval_set(card_set_t cards);
+
+/**
+ * @brief adds cards to a partial hand, one table step per card
+ *
+ * @param cards cards not already in the hand; it may hold at most 7 cards in all
+ */
+hand_state_t hand_state_add(hand_state_t hand, card_set_t cards);
+
+/**
+ * @brief values a partial hand as it stands; the same as hand_eval() on its cards
+ */
+uint64_t hand_state_value(hand_state_t hand);
+
+/**
+ * @brief values n hands of HAND_BATCH_CARDS cards at once
+ *
+ * the hands are laid out by card: card k of hand i is cards[k * n + i]. on x86 the hands
+ * are walked 16 (AVX-512) or 8 (AVX2) at a time, whichever the CPU supports, and one by one
+ * otherwise. every hand gets the value hand_eval() would give it
+ *
+ * @param cards HAND_BATCH_CARDS * n cards; NOCARD entries are skipped
+ * @param values filled with the n values
+ */
+void hand_eval_batch(const card_t *cards, int n, uint64_t *values);
+
+#endif
@@ -0,0 +1,43 @@
+#ifndef HAND_ISO_H
+#define HAND_ISO_H
+
+#include <stdint.h>
+
+#include "card_set.h"  // for card_set_t
+
+/**
+ * a dense index over hole cards and a board, up to a relabelling of the suits
+ *
+ * two situations get the same index exactly when one is the other with its suits renamed,
+ * and the indices for a board size run from 0 to hand_iso_size() - 1 with none skipped, so a
+ * table of that size holds one entry per distinct situation. the order the board cards came
+ * in does not matter: a flop is indexed as a set of three cards
+ *
+ * each suit holds some ranks in the hand and some on the board; those two rank sets number
+ * the suit within its shape (how many cards of each). suits of the same shape are a multiset
+ * of numbers, and the shapes of the four suits together pick a block of the index space
+ */
+
+/**
+ * @brief the number of indices for a board of board_cards cards, 0 if there is no such board
+ *
+ * 169 preflop, 1286792 on the flop
+ */
+uint64_t hand_iso_size(int board_cards);
+
+/**
+ * @brief the index of two hole cards on a board of 0 to 5 cards
+ *
+ * @return the index, below hand_iso_size(card_set_count(board))
+ */
+uint64_t hand_iso_index(card_set_t hand, card_set_t board);
+
+/**
+ * @brief the situation an index stands for, in the same form for every relabelling of it
+ *
+ * the suits are given out in order to the suits of the index, so the hand and board written
+ * out here index back to the same index
+ */
+void hand_iso_unindex(int board_cards, uint64_t index, card_set_t *hand, card_set_t *board);
+
+#endif
@@ -0,0 +1,79 @@
+#ifndef MPSC_QUEUE_H
+#define MPSC_QUEUE_H
+
+/**
+ * @brief a node of an mpsc_queue_t
+ *
+ * the node is embedded in whatever is queued, like a wheel_timer_t
+ */
+typedef struct mpsc_node {
+    struct mpsc_node *next;
+} mpsc_node_t;
+
+/**
+ * @brief a lock-free intrusive queue with any number of producers and one consumer
+ *
+ * a producer swaps itself in as the newest node and then links the one before it, so a push
+ * is one atomic exchange and never waits. the consumer walks from the oldest node; it can
+ * catch a producer between those two steps, in which case the queue looks empty until the
+ * producer finishes. producers should signal the consumer after pushing, never before
+ */
+typedef struct {
+    mpsc_node_t *newest;                    // swapped by the producers
+    char pad[64 - sizeof(mpsc_node_t *)];
+    mpsc_node_t *oldest;                    // only touched by the consumer
+    mpsc_node_t stub;                       // keeps the queue non-empty so a push never touches oldest
+} mpsc_queue_t;
+
+/**
+ * @brief initializes an empty queue
+ */
+void mpsc_queue_init(mpsc_queue_t *q);
+
+/**
+ * @brief appends node to the queue, from any thread
+ */
+void mpsc_queue_push(mpsc_queue_t *q, mpsc_node_t *node);
+
+/**
+ * @brief takes the oldest node off the queue, from the consumer thread only
+ *
+ * @return the node, or NULL if the queue is empty or its next node is still being pushed
+ */
+mpsc_node_t *mpsc_queue_pop(mpsc_queue_t *q);
+
+/**
+ * @brief the eventfd producers raise after pushing onto a queue, so its consumer can sleep
+ *
+ * it is written at most once between two answers, however many producers push meanwhile
+ */
+typedef struct {
+    int fd;
+    int raised;                             // written since the consumer last answered
+} mpsc_bell_t;
+
+/**
+ * @brief opens the bell's eventfd
+ *
+ * @return 0 on success, -1 otherwise
+ */
+int mpsc_bell_init(mpsc_bell_t *bell);
+
+/**
+ * @brief wakes the consumer, from a producer that has just pushed
+ */
+void mpsc_bell_ring(mpsc_bell_t *bell);
+
+/**
+ * @brief resets the bell, from the consumer right before it drains the queue
+ *
+ * anything pushed after this rings the bell again
+ */
+void mpsc_bell_answer(mpsc_bell_t *bell);
+
+/**
+ * @brief closes the bell's eventfd
+ */
+void mpsc_bell_fini(mpsc_bell_t *bell);
+
+#endif
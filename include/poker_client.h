@@ -3,9 +3,16 @@
 
 #include "macros.h"
 #include "wchar.h"
+#include "transport.h"
 
 #define MAX_PLAYERS 6
-#define MAX_CLIENT_PACKET_PARAMS 1
+#define MAX_CLIENT_PACKET_PARAMS 3
+
+// let the server pick the seat when joining a table
+#define ANY_SEAT (-1)
+
+// JOIN flags: ask the server for DELTA packets instead of a full INFO on every update
+#define JOIN_DELTA_INFO 0x1
 
 // ---------------------------- utility functions ---------------------------- //
 
@@ -39,14 +46,37 @@ const wchar_t *fancy_card_name(card_t card);
 
 // ---------------------------- Underlying networking functions ---------------------------- //
 
+/**
+ * @brief picks how the following connections reach the server
+ *
+ * TRANSPORT_TCP (the default) connects to the server's port. TRANSPORT_UNIX and TRANSPORT_SHM
+ * only work on the server's host: the first connects to its unix socket, the second also
+ * exchanges packets through shared memory. packets mean the same on every transport. a
+ * client that never calls this takes the transport from the POKER_TRANSPORT environment
+ * variable ("tcp", "unix" or "shm")
+ */
+void set_transport(transport_t transport);
+
 /**
  * @brief connect to the the server as a player
+ *
+ * if the connection drops later on, the client reconnects on its own and resumes its seat
+ * with the token the server handed out at JOIN, as long as the server still holds the seat
  * 
  * @param player_id the player to connect to server as
  * @return 0 on success, -1 otherwise
  */
 int connect_to_serv(player_id_t player_id);
 
+/**
+ * @brief connect to the server and sit down at a specific table
+ * 
+ * @param table_id the table to join
+ * @param player_id the seat to take, or ANY_SEAT to let the server choose one
+ * @return the seat the server gave the player on success, -1 otherwise
+ */
+int connect_to_table(int table_id, player_id_t player_id);
+
 /**
  * @brief gracefully disconnect from the server
  *  
@@ -65,23 +95,45 @@ typedef enum client_packet_type
     RAISE,      // raise the bet
     CALL,       // call the bet 
     CHECK,      // check
-    FOLD        // fold hand
+    FOLD,       // fold hand
+    RESYNC,     // ask for a full INFO after losing track of the deltas
+    RESUME      // take a seat back after losing the connection
 } client_packet_type_t;
 
+/**
+ * params by packet type:
+ *  JOIN  - params[0] = table id, params[1] = seat (or ANY_SEAT), params[2] = JOIN_* flags
+ *  RAISE - params[0] = the new bet
+ *  RESUME - params[0] = table id, params[1] = seat, params[2] = the token from the JOIN ACK
+ */
 typedef struct client_packet
 {
     client_packet_type_t packet_type;
+    int seq; //set when sent, echoed back in the ACK/NACK that answers the packet
     int params[MAX_CLIENT_PACKET_PARAMS];
 } client_packet_t;
 
 /**
  * @brief sends a packet to the connected server, then waits for a response
  * 
+ * packets that arrive ahead of the response are kept for recv_packet()
+ * 
  * @param pkt the packet contents to send to the server
  * @return 0 on success (ACK response), -1 on failure
  */
 int send_packet(client_packet_t *pkt);
 
+/**
+ * @brief sends a packet to the connected server without waiting for the response
+ * 
+ * the ACK/NACK is picked up later by recv_packet() in the order it arrived and passed,
+ * with the sequence number returned here, to the handler set with set_on_ack_packet_handler()
+ * 
+ * @param pkt the packet contents to send to the server
+ * @return the sequence number of the packet on success, -1 on failure
+ */
+int send_packet_async(client_packet_t *pkt);
+
 /**
  * @brief the packet types that was sent by the server to the client
  */
@@ -91,7 +143,9 @@ typedef enum server_packet_type
     NACK,       // error with packet
     INFO,       // updated game information 
     END,        // game end along with  
-    HALT        // halt to end connection
+    HALT,       // halt to end connection
+    DELTA,      // changes to the last INFO, only sent to clients that joined with JOIN_DELTA_INFO
+    EQUITY      // the seats' chances, only sent by a server that works them out
 } server_packet_type_t;
 
 /**
@@ -108,8 +162,33 @@ typedef struct
     int bet_size; //bet that must be called
     int player_bets[MAX_PLAYERS]; //current max bet from each player
     int player_status[MAX_PLAYERS]; //1 for in hand, 0 for folded, 2 for left
+    int version; //version of the table state, DELTA packets are applied on top of it
 } info_packet_t;
 
+// bits of delta_packet_t.changed, one per field of info_packet_t
+#define DELTA_COMMUNITY     (1u << 0)
+#define DELTA_POT           (1u << 1)
+#define DELTA_DEALER        (1u << 2)
+#define DELTA_TURN          (1u << 3)
+#define DELTA_BET_SIZE      (1u << 4)
+#define DELTA_STACK(p)      (1u << (8 + (p)))
+#define DELTA_BET(p)        (1u << (16 + (p)))
+#define DELTA_STATUS(p)     (1u << (24 + (p)))
+
+/**
+ * @brief the fields of an INFO that changed since the previous one
+ *
+ * only the fields flagged in changed are meaningful in state. a delta is only valid on
+ * top of the INFO whose version is base_version; the player's own cards never change
+ * within a hand, so they are only ever sent in full
+ */
+typedef struct
+{
+    int base_version;
+    unsigned int changed;
+    info_packet_t state; //state.version is the version after applying the delta
+} delta_packet_t;
+
 /**
  * @brief information about the packet that is send to the client after a hand
  */
@@ -124,21 +203,60 @@ typedef struct
     int player_status[MAX_PLAYERS]; //1 for in hand, 0 for folded, 2 for left
 } end_packet_t;
 
+/**
+ * @brief the seat given to the client, sent with the ACK that answers JOIN
+ */
+typedef struct
+{
+    int table_id;
+    player_id_t player_id;
+    int token;          // lets a new connection RESUME the seat, 0 if the server holds no seats
+    int last_seq;       // on RESUME: the last packet of the player the server answered
+    int last_accepted;  // on RESUME: whether that answer was an ACK
+} join_packet_t;
+
+// an equity_packet_t figure the server has none of for the seat
+#define EQUITY_UNKNOWN -1
+
+/**
+ * @brief the chances of the seats, each in 1/10000 of the pot
+ *
+ * with all_in set, every seat still in once nobody can bet any more, before the rest of the
+ * board is dealt; the whole table gets it, usually after the END of the hand since the board
+ * is dealt at once. otherwise how the receiving seat stands against the others' unknown cards
+ * on the street just dealt, with the other seats' figures EQUITY_UNKNOWN
+ */
+typedef struct
+{
+    int all_in;
+    int board_cards;                // cards on the board the chances are for
+    int equity[MAX_PLAYERS];        // share of the pot the seat takes on average
+    int margin[MAX_PLAYERS];        // half-width of the 95% confidence interval on equity, 0 if exact
+    int strength[MAX_PLAYERS];      // share it takes against one random hand as the board stands, not all_in
+} equity_packet_t;
+
 /**
  * @brief information about the packet recieved by the client 
  */
 typedef struct server_packet
 {
     server_packet_type_t packet_type;
+    int seq; //for an ACK/NACK, the seq of the client packet it answers
     union
     {
         info_packet_t info;
         end_packet_t end;
+        join_packet_t join;
+        delta_packet_t delta;
+        equity_packet_t equity;
     };
 } server_packet_t;
 
 /**
  * @brief waits for a packet from the server.
+ *
+ * DELTA packets are applied to the last INFO and handed back as a complete INFO. EQUITY
+ * packets go to the handler set with set_on_equity_packet_handler() and are not handed back
  * 
  * @param pkt the memory to store the packet information
  * @return 0 if packet recieved, -1 on failure
@@ -150,6 +268,8 @@ int recv_packet(server_packet_t *pkt);
 typedef void(*info_packet_handler_t)(info_packet_t*);
 typedef void(*end_packet_handler_t)(end_packet_t*);
 typedef void(*on_halt_packet_handler_t)();
+typedef void(*ack_packet_handler_t)(int seq, int accepted);
+typedef void(*equity_packet_handler_t)(equity_packet_t*);
 
 /**
  * @brief set the handler that is called whenver an info packet is received 
@@ -174,6 +294,21 @@ void set_on_end_packet_handler(end_packet_handler_t handler);
  */
 void set_on_halt_packet_handler(end_packet_handler_t handler);
 
+/**
+ * @brief set the handler that is called whenever an ACK or NACK is received by recv_packet()
+ * 
+ * @note accepted is 1 for an ACK and 0 for a NACK
+ * @param handler the new handler
+ */
+void set_on_ack_packet_handler(ack_packet_handler_t handler);
+
+/**
+ * @brief set the handler that is called whenever recv_packet() reads an EQUITY packet
+ * 
+ * @param handler the new handler
+ */
+void set_on_equity_packet_handler(equity_packet_handler_t handler);
+
 /**
  * @brief the player states they are ready
  * 
@@ -242,4 +377,16 @@ int is_players_turn(player_id_t player_id);
  */
 int has_recv_halt();
 
+/**
+ * @brief the player's chances all in preflop against everyone else still in the hand
+ *
+ * read from the preflop table (`make preflop_table`), which the client maps read-only when it
+ * connects, sharing the pages with the server and every other client on the host
+ *
+ * @param info the most recent info packet
+ * @param equity set to the share of the pot the hole cards take on average
+ * @return 0 on success, -1 if no table is mapped, the flop is out, or there is no one to play
+ */
+int preflop_chances(const info_packet_t *info, double *equity);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,98 @@
+#ifndef PREFLOP_TABLE_H
+#define PREFLOP_TABLE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "poker_client.h"  // for card_t, MAX_PLAYERS
+
+// where `make preflop_table` writes the table, and where the server looks for it
+#define PREFLOP_TABLE_PATH "build/preflop_equity.bin"
+
+#define PREFLOP_MAGIC 0x51455250u  // "PREQ"
+#define PREFLOP_VERSION 1
+
+// starting hands up to suits: 13 pairs, 78 suited and 78 offsuit
+#define PREFLOP_CLASSES 169
+
+/**
+ * the head of a table file
+ *
+ * the file is written in the byte order of the host that built it; a table from a host that
+ * does not match fails the magic check
+ */
+typedef struct {
+    uint32_t magic;                         // PREFLOP_MAGIC
+    uint32_t version;                       // PREFLOP_VERSION
+    uint32_t classes;                       // PREFLOP_CLASSES
+    uint32_t max_players;                   // MAX_PLAYERS of the build that wrote it
+    uint64_t trials;                        // runouts behind every entry
+    uint64_t checksum;                      // FNV-1a of everything after the header
+} preflop_header_t;
+
+/**
+ * a table file as it is laid out on disk and in memory
+ *
+ * the share of the pot a starting hand takes all in preflop, splits divided, on average over
+ * the suits it can have. heads_up[h][v] is hand h against hand v; field[p][h] is hand h against
+ * p - 1 random hands, for p from 2 to MAX_PLAYERS
+ */
+typedef struct {
+    preflop_header_t header;
+    float heads_up[PREFLOP_CLASSES][PREFLOP_CLASSES];
+    float field[MAX_PLAYERS + 1][PREFLOP_CLASSES];
+} preflop_file_t;
+
+/**
+ * a table file mapped read-only; every process that maps it shares the same pages
+ */
+typedef struct {
+    const preflop_file_t *file;             // NULL while nothing is mapped
+} preflop_table_t;
+
+/**
+ * @brief the class of a starting hand
+ *
+ * the classes are laid out as the usual 13x13 grid: pairs on the diagonal, suited hands at
+ * [high][low] and offsuit hands at [low][high], each index being rank * 13 + rank
+ *
+ * @return 0 to PREFLOP_CLASSES - 1
+ */
+int preflop_class(card_t a, card_t b);
+
+/**
+ * @brief the checksum of a table file as it is stored in its header
+ */
+uint64_t preflop_checksum(const preflop_file_t *file);
+
+/**
+ * @brief maps a table file read-only and checks it
+ *
+ * @return 0 on success, -1 if the file is missing, of another version or layout, or corrupt
+ */
+int preflop_table_open(preflop_table_t *table, const char *path);
+
+/**
+ * @brief unmaps a table; does nothing if none is mapped
+ */
+void preflop_table_close(preflop_table_t *table);
+
+/**
+ * @brief the equity of starting hand class hero against class villain, heads up
+ */
+static inline double preflop_equity(const preflop_table_t *table, int hero, int villain)
+{
+    return table->file->heads_up[hero][villain];
+}
+
+/**
+ * @brief the equity of starting hand class hero against players - 1 random hands
+ *
+ * @param players 2 to MAX_PLAYERS
+ */
+static inline double preflop_equity_vs_field(const preflop_table_t *table, int hero, int players)
+{
+    return table->file->field[players][hero];
+}
+
+#endif
@@ -0,0 +1,33 @@
+#ifndef RNG_H
+#define RNG_H
+
+#include <stdint.h>
+
+/**
+ * splitmix64: a 64-bit state stepped by a constant and mixed on the way out
+ *
+ * a stream is nothing but its state, so any number of them can be started from a seed and an
+ * index, which is how the equity runs and the preflop generator keep their results independent
+ * of how the work is split over threads
+ */
+
+/**
+ * @brief the next number of a stream
+ */
+static inline uint64_t rng_next(uint64_t *state)
+{
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+/**
+ * @brief a number from 0 to n - 1, by multiplying rather than dividing
+ */
+static inline int rng_below(uint64_t *state, int n)
+{
+    return (int)(((rng_next(state) >> 32) * (uint64_t)n) >> 32);
+}
+
+#endif
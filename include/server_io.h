@@ -0,0 +1,107 @@
+#ifndef SERVER_IO_H
+#define SERVER_IO_H
+
+#include <stdint.h>
+#include <sys/uio.h>
+
+#include "uring.h"
+#include "transport.h"
+
+/**
+ * how a network thread writes to the connections it owns
+ *
+ * by default a send is a non-blocking sendmsg() on the socket. whatever the socket does not
+ * take is queued for the connection and written out as the thread's epoll reports it writable.
+ * with `make IO_URING=1`, a network thread running on a ring attaches it here: frames are copied into
+ * registered buffers and queued as ring submissions, so every send produced while handling a
+ * batch of events reaches the kernel in one io_uring_enter(). sends to one connection still go
+ * out in order
+ *
+ * either way the queue of a connection is bounded. past SERVER_IO_HIGH_WATER the connection is
+ * congested, and the table stops sending it updates that a later snapshot replaces, until it
+ * drains to SERVER_IO_LOW_WATER. a connection whose queue would pass SERVER_IO_QUEUE_LIMIT is
+ * too slow to keep at the table
+ *
+ * a connection on the shared memory transport (see transport.h) is written through its ring
+ * instead, and the ring is its queue
+ */
+
+#define SERVER_IO_QUEUE_LIMIT (64 * 1024)
+#define SERVER_IO_HIGH_WATER (16 * 1024)
+#define SERVER_IO_LOW_WATER (4 * 1024)
+
+/**
+ * @brief tells the calling thread how a connection it owns is read
+ *
+ * @param fd the connection
+ * @param epoll_fd the epoll set the connection is in, -1 if it is read on the thread's ring
+ * @param tag the tag the connection is registered with, kept when asking for EPOLLOUT
+ */
+void server_io_watch(int fd, int epoll_fd, uint64_t tag);
+
+/**
+ * @brief sends to a connection go into ring from now on, until server_io_forget()
+ */
+void server_io_shm(int fd, shm_ring_t *ring);
+
+/**
+ * @brief sends the frames in iov to a connection, queueing what cannot be written yet
+ *
+ * @param fd the connection
+ * @param iov the frames to send, back to back
+ * @param iovcnt the number of entries in iov
+ * @return 0 on success, -1 if the frames would take the queue past SERVER_IO_QUEUE_LIMIT.
+ *         nothing is queued then and the connection should be dropped
+ */
+int server_io_send(int fd, const struct iovec *iov, int iovcnt);
+
+/**
+ * @brief checks if a connection is over its high watermark
+ */
+int server_io_congested(int fd);
+
+/**
+ * @brief writes what is queued for a connection its epoll reported writable
+ *
+ * @return 1 if the connection was congested and has now drained to the low watermark, 0 otherwise
+ */
+int server_io_writable(int fd);
+
+/**
+ * @brief drops whatever is still queued for a connection that is about to be closed
+ */
+void server_io_forget(int fd);
+
+/**
+ * @brief frees what the calling thread kept for its connections
+ */
+void server_io_cleanup(void);
+
+#ifdef POKER_IO_URING
+
+// user_data tag of the send completions the network thread passes to server_io_complete()
+#define SERVER_IO_SEND_TAG (0xFFull << 56)
+
+/**
+ * @brief sends of the calling thread go through ring from now on
+ *
+ * @return 0 on success, -1 if the send buffers could not be registered
+ */
+int server_io_attach(uring_t *ring);
+
+/**
+ * @brief sends of the calling thread go back to plain sockets
+ */
+void server_io_detach(void);
+
+/**
+ * @brief handles the completion of a send queued by server_io_send()
+ *
+ * @param tag set to the tag of the connection when it drains
+ * @return 1 if the connection was congested and has now drained to the low watermark, 0 otherwise
+ */
+int server_io_complete(uint64_t user_data, int res, uint64_t *tag);
+
+#endif
+
+#endif
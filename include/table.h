@@ -0,0 +1,113 @@
+#ifndef TABLE_H
+#define TABLE_H
+
+#include <stddef.h>
+
+#include "poker_client.h"
+#include "game_logic.h"
+#include "broadcast.h"
+#include "connection.h"
+#include "mpsc_queue.h"
+#include "timer_wheel.h"
+#include "equity_service.h"
+
+/**
+ * @brief settings every table is created with
+ */
+typedef struct {
+    int action_ms;                          // time a player has to act, 0 to wait forever
+    int time_bank_ms;                       // extra time each seat can draw on once action_ms runs out
+    int resume_grace_ms;                    // how long a dropped seat is held for a RESUME, 0 to give it up at once
+    int min_players;                        // seated players needed before the first hand is dealt, 2 to MAX_PLAYERS
+    equity_service_t *equity;               // sends the players their chances once they are all in, NULL not to.
+                                            // with a cache, also how each one stands as every street is dealt
+} table_config_t;
+
+/**
+ * @brief connection state of one seat at a table
+ */
+typedef struct {
+    int joined;                             // the seat is taken; cleared when its player leaves between hands
+    int ready;                              // READY received for the next hand
+    int time_bank_ms;                       // time bank the seat has left
+    int token;                              // what a RESUME has to show to take the seat back
+    int away;                               // the connection dropped and the seat is held for a RESUME
+    uint64_t away_until;                    // when the seat stops being held
+    int last_seq;                           // the last packet of the seat answered with ACK/NACK
+    int last_accepted;                      // whether that answer was an ACK
+} seat_t;
+
+/**
+ * @brief one poker table: the game state plus the connections seated at it
+ *
+ * a table is only ever touched by the engine thread that owns it. the network threads that
+ * read its connections post what they read onto its commands, the equity service posts the
+ * runs it asked for there once they are done, and the engine drains them
+ */
+typedef struct table {
+    int id;                                 // index of the table in the table manager
+    game_state_t game;
+    seat_t seats[MAX_PLAYERS];
+    connection_t *conns[MAX_PLAYERS];       // the connection of each seat, NULL if none
+    mpsc_queue_t commands;                  // from the network threads and the equity service
+    mpsc_bell_t *bell;                      // rung after a command is posted
+    int joins;                              // JOINs accepted while the table waits to deal
+    int closed;                             // the table halted and takes no more players
+    outbox_t outbox;                        // packets produced by the event being handled
+    int hands;                              // hands dealt, and streets dealt: an equity run that
+    int streets;                            // comes back after its hand or street moved on is dropped
+    table_config_t config;
+    timer_wheel_t *wheel;                   // the owning engine's wheel the action clock runs on
+    wheel_timer_t clock;                    // the action clock of the player to act
+    player_id_t clock_seat;                 // the seat the clock runs for, -1 if stopped
+    int on_bank;                            // the clock is spending the seat's time bank
+    uint64_t bank_started;                  // when the seat started spending its time bank
+    wheel_timer_t grace;                    // due when the first held seat runs out of time
+    void (*on_halt)(struct table *table);   // told once, as the table halts
+} table_t;
+
+/**
+ * @brief sets up an empty table waiting for players to join
+ *
+ * @param table the table to initialize
+ * @param id the index of the table
+ * @param random_seed the seed for the table's deck
+ * @param config the action clock and resume settings
+ * @param wheel the timer wheel of the engine that owns the table
+ * @param bell what wakes that engine once a command is posted
+ * @param on_halt called from the owning engine when the table halts
+ */
+void table_init(table_t *table, int id, int random_seed, const table_config_t *config, timer_wheel_t *wheel,
+                mpsc_bell_t *bell, void (*on_halt)(table_t *table));
+
+/**
+ * @brief hands a command to the table's engine, from any network thread
+ *
+ * the commands of one network thread are run in the order they were posted
+ */
+void table_post(table_t *table, command_t *cmd);
+
+/**
+ * @brief runs every command posted so far through the game, from the owning engine
+ *
+ * a JOIN or RESUME is given the seat it asks for or refused. the packets of a seated
+ * connection are handled in the order they were sent, and the outbox is flushed after each
+ */
+void table_drain(table_t *table);
+
+/**
+ * @brief sends every seat a HALT, drops them and closes the table for good
+ *
+ * a table never halts on its own: once fewer than two players are left it waits for JOINs
+ * again. this is how the server shuts a table down; does nothing if it is closed already
+ *
+ * @param table the table to halt
+ */
+void table_halt(table_t *table);
+
+/**
+ * @brief frees the commands still posted, once no thread runs any more
+ */
+void table_discard(table_t *table);
+
+#endif
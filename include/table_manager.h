@@ -0,0 +1,56 @@
+#ifndef TABLE_MANAGER_H
+#define TABLE_MANAGER_H
+
+#include "table.h"
+
+#define BASE_PORT 2201
+
+/**
+ * @brief creates the tables and spreads them over the engine threads
+ *
+ * every client connects to BASE_PORT, or to TRANSPORT_UNIX_PATH from the same host; its JOIN
+ * names the table (and optionally the seat). sockets are handled by the network threads, each
+ * with its own event loop and its own socket on BASE_PORT (SO_REUSEPORT), so a connection may
+ * be accepted by any of them. the game runs on the engine threads: table t is owned by engine
+ * t % num_workers, and nothing else touches it. a network thread decodes what a connection
+ * sends and posts it to the command queue of its table, and the engine writes its frames back
+ * through the connection's out ring (see connection.h). when there is a CPU for every network
+ * thread, each one is pinned to its own, and so is each engine if there are CPUs enough for both
+ *
+ * @param num_tables how many tables the server hosts
+ * @param num_workers how many network threads, and engines, the server runs
+ * @param random_seed seed of table 0; table t is seeded with random_seed + t
+ * @param config the settings every table is created with
+ * @return 0 on success, -1 otherwise
+ */
+int table_manager_init(int num_tables, int num_workers, int random_seed, const table_config_t *config);
+
+/**
+ * @brief runs the network and engine threads until every table has halted
+ *
+ * tables do not halt on their own, so this returns once table_manager_stop() was called
+ *
+ * @return 0 on success, -1 if a thread could not be started
+ */
+int table_manager_run();
+
+/**
+ * @brief asks every engine to halt its tables, sending their players a HALT
+ *
+ * safe to call from a signal handler
+ */
+void table_manager_stop();
+
+/**
+ * @brief looks up a table by index
+ *
+ * @return the table, or NULL if the index is out of range
+ */
+table_t *table_manager_get(int table_id);
+
+/**
+ * @brief closes every socket and frees the tables
+ */
+void table_manager_fini();
+
+#endif
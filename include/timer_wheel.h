@@ -0,0 +1,75 @@
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <stdint.h>
+
+#define WHEEL_LEVELS 4
+#define WHEEL_BITS 6
+#define WHEEL_SLOTS (1 << WHEEL_BITS)
+
+/**
+ * @brief a timer that can be armed on a timer_wheel_t
+ *
+ * the node is embedded in whatever owns the timer; fire is called with it once it expires
+ */
+typedef struct wheel_timer {
+    struct wheel_timer *next, *prev;
+    uint64_t expires;                       // tick the timer is due on
+    void (*fire)(struct wheel_timer *timer);
+} wheel_timer_t;
+
+/**
+ * @brief a hierarchical timer wheel
+ *
+ * level 0 has one slot per tick, every level above covers WHEEL_SLOTS times the span of the
+ * one below, and timers move down a level as their slot comes up. arming and cancelling a
+ * timer is O(1) no matter how many are armed. with 100ms ticks the wheel reaches ~19 days
+ */
+typedef struct {
+    wheel_timer_t slots[WHEEL_LEVELS][WHEEL_SLOTS];     // list heads
+    uint64_t now;                           // the last tick that was run
+    uint64_t origin_ms;                     // clock time of tick 0
+    unsigned tick_ms;
+    int count;                              // timers armed
+} timer_wheel_t;
+
+/**
+ * @brief returns the monotonic clock in milliseconds
+ */
+uint64_t timer_wheel_clock_ms(void);
+
+/**
+ * @brief sets up an empty wheel starting at the current time
+ *
+ * @param tick_ms the resolution of the wheel
+ */
+void timer_wheel_init(timer_wheel_t *wheel, unsigned tick_ms);
+
+/**
+ * @brief prepares a timer node for use
+ */
+void wheel_timer_init(wheel_timer_t *timer, void (*fire)(wheel_timer_t *timer));
+
+/**
+ * @brief (re)arms a timer to fire after delay_ms, rounded up to the next tick
+ */
+void timer_wheel_add(timer_wheel_t *wheel, wheel_timer_t *timer, uint64_t delay_ms);
+
+/**
+ * @brief disarms a timer; does nothing if it is not armed
+ */
+void timer_wheel_cancel(timer_wheel_t *wheel, wheel_timer_t *timer);
+
+/**
+ * @brief checks if a timer is armed
+ */
+int wheel_timer_armed(const wheel_timer_t *timer);
+
+/**
+ * @brief runs every tick up to the current time and fires the timers that came due
+ *
+ * timers may be armed and cancelled from inside fire
+ */
+void timer_wheel_advance(timer_wheel_t *wheel);
+
+#endif
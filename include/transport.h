@@ -0,0 +1,127 @@
+#ifndef TRANSPORT_H
+#define TRANSPORT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+/**
+ * the ways a client on the same host can reach the server besides TCP
+ *
+ * every transport carries the same frames (see wire.h). an AF_UNIX client connects to
+ * TRANSPORT_UNIX_PATH instead of the TCP port. a shared memory client connects the same
+ * way, but sends a memfd holding a shm_channel_t along with its JOIN or RESUME (SCM_RIGHTS).
+ * every frame after that goes through the two rings of the channel, and the socket is
+ * only a doorbell:
+ *  - the server sleeps in epoll. a client that finds the waiting flag of to_server set
+ *    after writing sends one byte on the socket to wake it
+ *  - the client sleeps on a futex on the tail of to_client. the server wakes it after
+ *    writing if the waiting flag of to_client is set
+ * closing the socket ends the connection either way
+ */
+
+#define TRANSPORT_UNIX_PATH "/tmp/poker_server.sock"
+#define SHM_RING_SIZE (64 * 1024)           // a power of two
+
+typedef enum {
+    TRANSPORT_TCP,
+    TRANSPORT_UNIX,
+    TRANSPORT_SHM
+} transport_t;
+
+/**
+ * @brief a single producer single consumer byte ring
+ *
+ * head and tail only ever grow; they are reduced modulo SHM_RING_SIZE to index data
+ */
+typedef struct {
+    uint32_t head;                          // advanced by the consumer
+    uint8_t pad0[60];
+    uint32_t tail;                          // advanced by the producer, the futex word
+    uint8_t pad1[60];
+    uint32_t waiting;                       // the consumer is asleep, or about to be
+    uint8_t pad2[60];
+    uint8_t data[SHM_RING_SIZE];
+} shm_ring_t;
+
+/**
+ * @brief the pair of rings one seat talks through
+ */
+typedef struct {
+    shm_ring_t to_server;
+    shm_ring_t to_client;
+} shm_channel_t;
+
+/**
+ * @brief creates a channel in a new memfd and maps it
+ *
+ * @param fd set to the memfd, to be passed to the server and closed afterwards
+ * @return the channel, or NULL on failure
+ */
+shm_channel_t *shm_channel_create(int *fd);
+
+/**
+ * @brief maps a channel received from a client
+ *
+ * @return the channel, or NULL if fd does not hold one
+ */
+shm_channel_t *shm_channel_map(int fd);
+
+/**
+ * @brief unmaps a channel
+ */
+void shm_channel_unmap(shm_channel_t *channel);
+
+/**
+ * @brief the number of bytes waiting to be read, or -1 if the ring is corrupt
+ */
+ssize_t shm_ring_used(shm_ring_t *ring);
+
+/**
+ * @brief the producer copies in as much of buf as fits
+ *
+ * @return the number of bytes written, or -1 if the ring is corrupt
+ */
+ssize_t shm_ring_write(shm_ring_t *ring, const void *buf, size_t len);
+
+/**
+ * @brief the consumer copies out up to cap bytes
+ *
+ * @return the number of bytes read, or -1 if the ring is corrupt
+ */
+ssize_t shm_ring_read(shm_ring_t *ring, void *buf, size_t cap);
+
+/**
+ * @brief the consumer announces that it is going to sleep
+ *
+ * @return 1 if data arrived in the meantime and the consumer should read instead, 0 otherwise
+ */
+int shm_ring_park(shm_ring_t *ring);
+
+/**
+ * @brief the producer checks, after writing, if the consumer has to be woken
+ *
+ * @return 1 if the consumer was parked, 0 otherwise. the flag is cleared either way
+ */
+int shm_ring_take_waiter(shm_ring_t *ring);
+
+/**
+ * @brief the consumer sleeps on the futex until the producer writes or timeout_ms pass
+ *
+ * @param tail the tail the consumer saw when it found the ring empty
+ */
+void shm_ring_wait(shm_ring_t *ring, uint32_t tail, int timeout_ms);
+
+/**
+ * @brief the producer wakes a consumer sleeping in shm_ring_wait()
+ */
+void shm_ring_wake(shm_ring_t *ring);
+
+/**
+ * @brief sends buf on a unix socket with fd attached
+ *
+ * @return the number of bytes sent, -1 on error
+ */
+ssize_t transport_send_fd(int sock, const void *buf, size_t len, int fd);
+
+#endif
@@ -0,0 +1,107 @@
+#ifndef URING_H
+#define URING_H
+
+/**
+ * a thin wrapper over the io_uring system calls, only built with `make IO_URING=1`
+ *
+ * it covers what the server needs and nothing more: one submission and completion
+ * queue per thread, multishot accept/recv/poll, a provided buffer ring that multishot
+ * recv picks its buffers from, and registered buffers for writes
+ */
+#ifdef POKER_IO_URING
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/uio.h>
+#include <linux/io_uring.h>
+
+typedef struct {
+    int fd;
+
+    unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+    struct io_uring_sqe *sqes;
+    unsigned sq_entries;
+    unsigned sq_pending;                    // sqes filled in but not yet submitted
+
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    struct io_uring_cqe *cqes;
+
+    void *sq_ring, *cq_ring;
+    size_t sq_ring_size, cq_ring_size, sqes_size;
+
+    struct io_uring_buf_ring *buf_ring;     // buffers multishot recv picks from
+    uint8_t *recv_bufs;
+    unsigned recv_buf_count, recv_buf_size;
+    int buf_group;
+} uring_t;
+
+/**
+ * @brief sets up a ring with room for entries submissions
+ *
+ * @return 0 on success, -1 if the kernel does not offer io_uring (errno is set)
+ */
+int uring_init(uring_t *ring, unsigned entries);
+
+/**
+ * @brief unmaps the ring and closes it
+ */
+void uring_fini(uring_t *ring);
+
+/**
+ * @brief hands out the next free submission entry, cleared
+ *
+ * submits what is queued first if the submission queue is full
+ */
+struct io_uring_sqe *uring_get_sqe(uring_t *ring);
+
+/**
+ * @brief submits everything queued and waits for at least wait_nr completions
+ *
+ * @return 0 on success, -1 on error (errno is set)
+ */
+int uring_submit_and_wait(uring_t *ring, unsigned wait_nr);
+
+/**
+ * @brief the oldest completion not yet consumed, or NULL if there is none
+ */
+struct io_uring_cqe *uring_peek_cqe(uring_t *ring);
+
+/**
+ * @brief consumes the completion returned by uring_peek_cqe()
+ */
+void uring_cqe_seen(uring_t *ring);
+
+/**
+ * @brief registers count buffers of size bytes as buffer group group for multishot recv
+ *
+ * @return 0 on success, -1 otherwise
+ */
+int uring_setup_recv_buffers(uring_t *ring, int group, unsigned count, unsigned size);
+
+/**
+ * @brief the provided buffer a recv completion filled in
+ */
+const uint8_t *uring_recv_buffer(uring_t *ring, const struct io_uring_cqe *cqe);
+
+/**
+ * @brief gives the buffer of a recv completion back to the kernel
+ */
+void uring_recycle_buffer(uring_t *ring, const struct io_uring_cqe *cqe);
+
+/**
+ * @brief registers fixed buffers that uring_prep_write_fixed() can refer to by index
+ *
+ * @return 0 on success, -1 otherwise
+ */
+int uring_register_buffers(uring_t *ring, const struct iovec *iov, unsigned count);
+
+void uring_prep_accept_multishot(struct io_uring_sqe *sqe, int fd, uint64_t user_data);
+void uring_prep_recv_multishot(struct io_uring_sqe *sqe, int fd, int group, uint64_t user_data);
+void uring_prep_poll(struct io_uring_sqe *sqe, int fd, uint64_t user_data);
+void uring_prep_poll_multishot(struct io_uring_sqe *sqe, int fd, uint64_t user_data);
+void uring_prep_send(struct io_uring_sqe *sqe, int fd, const void *buf, size_t len, uint64_t user_data);
+void uring_prep_write_fixed(struct io_uring_sqe *sqe, int fd, const void *buf, size_t len, int buf_index, uint64_t user_data);
+
+#endif
+
+#endif
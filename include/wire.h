@@ -0,0 +1,107 @@
+#ifndef WIRE_H
+#define WIRE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "poker_client.h"
+
+/**
+ * the encoding packets travel in between the client and the server
+ *
+ * every packet is one frame:
+ *  u16 body length (big endian) | u8 WIRE_VERSION | u8 packet type | body
+ *
+ * inside the body cards are one byte (0..51, 0xFF for NOCARD), player statuses are one
+ * byte and every other integer is a zigzag varint, so small amounts take a single byte.
+ * client packets start with their seq, and ACK/NACK carry the seq of the packet they
+ * answer (the ACK answering JOIN or RESUME is followed by the seat, the resume token and the
+ * last packet the server answered on that seat). HALT has an empty body
+ *
+ * an INFO starts with the two hole cards, so the rest of the frame is the same for the
+ * whole table and only WIRE_INFO_CARDS_SIZE bytes at WIRE_INFO_CARDS_OFFSET differ per seat.
+ * a DELTA only carries the fields flagged in its changed mask. an EQUITY is all_in and
+ * board_cards, a byte each, then the equity, margin and strength of every seat in turn
+ */
+
+#define WIRE_VERSION 2
+#define WIRE_HEADER_SIZE 4
+#define WIRE_MAX_BODY 252
+#define WIRE_MAX_FRAME (WIRE_HEADER_SIZE + WIRE_MAX_BODY)
+
+#define WIRE_INFO_CARDS_OFFSET WIRE_HEADER_SIZE
+#define WIRE_INFO_CARDS_SIZE 2
+
+/**
+ * @brief an encoded frame
+ */
+typedef struct {
+    uint8_t bytes[WIRE_MAX_FRAME];
+    size_t len;
+} wire_buf_t;
+
+/**
+ * @brief how many more bytes are needed to complete the frame at the start of buf
+ *
+ * @param buf the bytes received so far
+ * @param have the number of bytes in buf
+ * @return 0 once a whole frame is in buf, the number of missing bytes otherwise
+ */
+size_t wire_bytes_wanted(const uint8_t *buf, size_t have);
+
+/**
+ * @brief encodes one card as a single byte
+ */
+uint8_t wire_card(card_t card);
+
+/**
+ * @brief encodes a packet sent by the client
+ *
+ * @param pkt the packet to encode
+ * @param out where to write the frame
+ * @return the size of the frame, or -1 if the packet cannot be encoded
+ */
+int wire_encode_client(const client_packet_t *pkt, wire_buf_t *out);
+
+/**
+ * @brief encodes a packet sent by the server
+ *
+ * @param pkt the packet to encode
+ * @param out where to write the frame
+ * @return the size of the frame, or -1 if the packet cannot be encoded
+ */
+int wire_encode_server(const server_packet_t *pkt, wire_buf_t *out);
+
+/**
+ * @brief encodes the ACK that answers JOIN or RESUME with the seat the player was given
+ *
+ * @param seq the seq of the JOIN or RESUME
+ * @param join the table and seat
+ * @param out where to write the frame
+ * @return the size of the frame
+ */
+int wire_encode_join_ack(int seq, const join_packet_t *join, wire_buf_t *out);
+
+/**
+ * @brief decodes the client frame at the start of buf straight into pkt
+ *
+ * @param buf the received bytes
+ * @param len the number of bytes in buf
+ * @param pkt the packet to fill in
+ * @return the size of the frame consumed, 0 if buf does not hold a whole frame yet,
+ *         -1 if the frame is malformed or from another protocol version
+ */
+int wire_decode_client(const uint8_t *buf, size_t len, client_packet_t *pkt);
+
+/**
+ * @brief decodes the server frame at the start of buf straight into pkt
+ *
+ * @param buf the received bytes
+ * @param len the number of bytes in buf
+ * @param pkt the packet to fill in
+ * @return the size of the frame consumed, 0 if buf does not hold a whole frame yet,
+ *         -1 if the frame is malformed or from another protocol version
+ */
+int wire_decode_server(const uint8_t *buf, size_t len, server_packet_t *pkt);
+
+#endif
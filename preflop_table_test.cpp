@@ -0,0 +1,110 @@
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <unistd.h>
+
+extern "C" {
+#include "preflop_table.h"
+#include "equity_cache.h"
+}
+
+// a small table, written once for every test by the generator `make test.preflop_table` builds
+static const char *TABLE = "build/preflop_test.bin";
+static const int TRIALS = 200;
+
+static std::string copy_of_table(const char *name) {
+    std::string path = std::string("build/") + name;
+    FILE *in = fopen(TABLE, "rb"), *out = fopen(path.c_str(), "wb");
+    EXPECT_TRUE(in && out);
+    preflop_file_t file;
+    EXPECT_EQ(fread(&file, sizeof(file), 1, in), 1u);
+    EXPECT_EQ(fwrite(&file, sizeof(file), 1, out), 1u);
+    fclose(in);
+    fclose(out);
+    return path;
+}
+
+static void flip_byte(const std::string &path, long offset) {
+    FILE *f = fopen(path.c_str(), "r+b");
+    ASSERT_NE(f, nullptr);
+    fseek(f, offset, SEEK_SET);
+    int c = fgetc(f);
+    fseek(f, offset, SEEK_SET);
+    fputc(c ^ 0x01, f);
+    fclose(f);
+}
+
+class PreflopTableTest : public ::testing::Test {
+protected:
+    static void SetUpTestSuite() {
+        std::string cmd = "build/server.preflop_gen " + std::string(TABLE) + " " + std::to_string(TRIALS) + " 4 > /dev/null";
+        ASSERT_EQ(system(cmd.c_str()), 0);
+    }
+
+    static void TearDownTestSuite() {
+        unlink(TABLE);
+    }
+};
+
+TEST_F(PreflopTableTest, OpensAndLooksUp) {
+    preflop_table_t table;
+    ASSERT_EQ(preflop_table_open(&table, TABLE), 0);
+    EXPECT_EQ(table.file->header.trials, (uint64_t)TRIALS);
+
+    int aces = preflop_class(ACE OF SPADE, ACE OF HEART);
+    int seven_deuce = preflop_class(SEVEN OF CLUB, TWO OF DIAMOND);
+    int suited = preflop_class(KING OF HEART, QUEEN OF HEART), offsuit = preflop_class(KING OF HEART, QUEEN OF CLUB);
+    EXPECT_EQ(aces, 12 * 13 + 12);
+    EXPECT_NE(suited, offsuit);
+
+    // about 0.87 with a margin of some 0.05 at this many trials
+    EXPECT_GT(preflop_equity(&table, aces, seven_deuce), 0.75);
+    EXPECT_NEAR(preflop_equity(&table, aces, seven_deuce) + preflop_equity(&table, seven_deuce, aces), 1.0, 1e-6);
+    EXPECT_EQ(preflop_equity(&table, aces, aces), 0.5);
+    EXPECT_GT(preflop_equity_vs_field(&table, aces, 2), preflop_equity_vs_field(&table, aces, MAX_PLAYERS));
+    preflop_table_close(&table);
+    EXPECT_EQ(table.file, nullptr);
+}
+
+TEST_F(PreflopTableTest, CorruptByteFailsTheOpen) {
+    preflop_table_t table;
+    std::string body = copy_of_table("preflop_body.bin");
+    flip_byte(body, sizeof(preflop_header_t) + 1000);
+    EXPECT_EQ(preflop_table_open(&table, body.c_str()), -1);
+    EXPECT_EQ(table.file, nullptr);
+
+    std::string header = copy_of_table("preflop_header.bin");
+    flip_byte(header, offsetof(preflop_header_t, magic));
+    EXPECT_EQ(preflop_table_open(&table, header.c_str()), -1);
+
+    std::string shorter = copy_of_table("preflop_short.bin");
+    ASSERT_EQ(truncate(shorter.c_str(), sizeof(preflop_file_t) - 1), 0);
+    EXPECT_EQ(preflop_table_open(&table, shorter.c_str()), -1);
+
+    EXPECT_EQ(preflop_table_open(&table, "build/no_such_table.bin"), -1);
+    unlink(body.c_str());
+    unlink(header.c_str());
+    unlink(shorter.c_str());
+}
+
+// the cache takes preflop equities from the table instead of running them
+TEST_F(PreflopTableTest, CacheReadsPreflopFromTheTable) {
+    preflop_table_t table;
+    ASSERT_EQ(preflop_table_open(&table, TABLE), 0);
+    equity_pool_t pool;
+    equity_cache_t cache;
+    ASSERT_EQ(equity_pool_init(&pool, 2), 0);
+    ASSERT_EQ(equity_cache_init(&cache, 64, &table), 0);
+
+    hand_outlook_t o;
+    card_set_t hand = CARD_SET_BIT(KING OF HEART) | CARD_SET_BIT(QUEEN OF HEART);
+    ASSERT_EQ(equity_hand_cached(&cache, &pool, hand, CARD_SET_EMPTY, 3, 100000, 0.01, 1, &o), 0);
+    EXPECT_EQ(o.equity, (double)preflop_equity_vs_field(&table, preflop_class(KING OF HEART, QUEEN OF HEART), 4));
+    EXPECT_EQ(o.trials, (uint64_t)TRIALS);
+    EXPECT_GT(o.margin, 0);
+
+    equity_cache_fini(&cache);
+    equity_pool_fini(&pool);
+    preflop_table_close(&table);
+}
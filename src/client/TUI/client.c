@@ -479,6 +479,12 @@ static void write_player_turn(poker_screen_t *poker_screen, player_id_t player_i
     wrefresh(poker_screen->player_panels[player_id]);
 }
 
+static void write_preflop_equity(poker_screen_t *poker_screen, double equity)
+{
+    mvwprintw(poker_screen->main_window, 0, 20, " All in preflop: %.1f%% ", 100 * equity);
+    wrefresh(poker_screen->main_window);
+}
+
 static void write_player_fold(poker_screen_t *poker_screen, player_id_t player_id)
 {
     mvwprintw(poker_screen->player_panels[player_id], 3, 18, "[F]");
@@ -809,6 +815,11 @@ static void draw_poker_info(info_packet_t *pkt)
     // draw community cards
     for (size_t i = 0; i < 5; ++i)
         write_community_card(&poker_screen, i, pkt->community_cards[i]);
+
+    // chances from the preflop table, until the flop comes
+    double equity;
+    if (preflop_chances(pkt, &equity) == 0)
+        write_preflop_equity(&poker_screen, equity);
 }
 
 static void poker_game_screen(info_packet_t *pkt)
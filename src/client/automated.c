@@ -1,4 +1,6 @@
 /**
+ * usage: client.automated PLAYER_ID [TABLE_ID]
+ *
  * Supported commands
  *  - ready
  *  - leave
@@ -363,9 +365,9 @@ int main(int argc, char *argv[])
 {
     int ret;
 
-    if (argc != 2) 
+    if (argc != 2 && argc != 3) 
     {
-        fprintf(stderr, "incorrect number of args. expecting 1, got %d.\n", argc - 1);
+        fprintf(stderr, "incorrect number of args. expecting 1 or 2, got %d.\n", argc - 1);
         return 1;
     }
 
@@ -381,10 +383,23 @@ int main(int argc, char *argv[])
         return 1;
     }
 
-    log_player_init(id);
+    int table_id = 0;
+    if (argc == 3 && sscanf(argv[2], " %d ", &table_id) != 1)
+    {
+        fprintf(stderr, "table arg is not integer.\n");
+        return 1;
+    }
+
+    if (table_id == 0) log_player_init(id);
+    else
+    {
+        char tag[32];
+        snprintf(tag, sizeof(tag), "table%d.player%d", table_id, id);
+        log_init(tag);
+    }
 
     // attempt to connect to the server
-    ret = connect_to_serv(id);
+    ret = connect_to_table(table_id, id) < 0 ? -1 : 0;
     if (ret == -1) // connection failed 
     {   
         log_err("Failed to connect to server as player %d. Exiting...", id);
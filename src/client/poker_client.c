@@ -3,25 +3,54 @@
 #include <string.h>
 #include <unistd.h>
 #include <time.h>
+#include <errno.h>
 #include <arpa/inet.h>
 #include <sys/socket.h>
+#include <sys/un.h>
 
 #include "poker_client.h"
 #include "utility.h"
 #include "logs.h"
+#include "wire.h"
+#include "frame_reader.h"
+#include "transport.h"
+#include "preflop_table.h"
 
 #define SERVER_IP   "127.0.0.1"
 #define BASE_PORT 2201
-#define NUM_PORTS 6
 #define BUFFER_SIZE 1024
+#define BACKLOG_SIZE 16
+// how often a client waiting on its ring checks that the server is still there
+#define SHM_POLL_MS 100
 
 // Static vars
 static int client_fd = -1;
+static transport_t transport = TRANSPORT_TCP;
+static int transport_chosen = 0;    // set_transport() was called, POKER_TRANSPORT is not looked at
+static shm_channel_t *shm = NULL;   // the rings of the current connection on TRANSPORT_SHM
+static int shm_fd = -1;             // the memfd behind shm, until it is passed to the server
+static frame_reader_t rx;
+static int joined_table = -1;
+static player_id_t joined_seat = -1;
 static info_packet_handler_t info_handler = NULL;
 static end_packet_handler_t end_handler = NULL;
 static on_halt_packet_handler_t halt_handler = NULL;
+static ack_packet_handler_t ack_handler = NULL;
+static equity_packet_handler_t equity_handler = NULL;
+static int next_seq = 1;
+// packets that arrived while send_packet() waited for its response, in arrival order
+static server_packet_t backlog[BACKLOG_SIZE];
+static int backlog_head = 0;
+static int backlog_count = 0;
 static server_packet_t last_server_packet;
+static info_packet_t last_info;     // the state DELTA packets are applied to
+static int last_info_version = 0;   // 0 until the first full INFO arrives
 static int halt_received = 0;
+static int resume_token = 0;        // from the JOIN ACK, 0 if the server will not hold our seat
+static int resumes = 0;             // times the connection was resumed
+static int resumed_last_seq = 0;    // the last of our packets the server answered before the resume
+static int resumed_last_accepted = 0;
+static preflop_table_t preflop;     // mapped at connect if `make preflop_table` wrote one
 
 static const char *CLIENT_PACKET_TYPE_NAMES[] = {
     "JOIN",
@@ -30,7 +59,9 @@ static const char *CLIENT_PACKET_TYPE_NAMES[] = {
     "RAISE",
     "CALL",
     "CHECK",
-    "FOLD"
+    "FOLD",
+    "RESYNC",
+    "RESUME"
 };
 
 static const char *SERVER_PACKET_TYPE_NAMES[] = {
@@ -38,7 +69,9 @@ static const char *SERVER_PACKET_TYPE_NAMES[] = {
     "NACK",
     "INFO",
     "END",
-    "HALT"
+    "HALT",
+    "DELTA",
+    "EQUITY"
 };
 
 // ---------------------------- Logging Functions ---------------------------- //
@@ -85,21 +118,175 @@ void log_end_packet(const end_packet_t *end) {
     }
 }
 
+void log_equity_packet(const equity_packet_t *equity) {
+    if (!equity) return;
+
+    log_info("[EQUITY_PACKET] all_in=%d, board_cards=%d", equity->all_in, equity->board_cards);
+
+    for (int i = 0; i < MAX_PLAYERS; i++) {
+        if (equity->equity[i] != EQUITY_UNKNOWN) {
+            log_info("[EQUITY_PACKET] Player %d: equity=%d, margin=%d, strength=%d",
+                     i, equity->equity[i], equity->margin[i], equity->strength[i]);
+        }
+    }
+}
+
 // ---------------------------- Networking Functions ---------------------------- //
 
 #define NANOSEC_IN_SEC 1000000000ul
 #define MAX_CONNECTION_ATTEMPT_TIME 7500000000ul
+#define MAX_RESUME_ATTEMPT_TIME 1600000000ul
+
+static int resume_session();
+
+void set_transport(transport_t t) {
+    transport = t;
+    transport_chosen = 1;
+}
+
+// the server closing the socket is how a connection on shared memory ends
+static int server_gone() {
+    char c;
+    ssize_t r = recv(client_fd, &c, 1, MSG_PEEK | MSG_DONTWAIT);
+    return r == 0 || (r < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR);
+}
+
+// copies a frame into the ring, ringing the doorbell if the server went to sleep on it
+static int write_ring(const uint8_t *bytes, size_t len) {
+    while (len > 0) {
+        ssize_t n = shm_ring_write(&shm->to_server, bytes, len);
+        if (n < 0) return -1;
+        bytes += n;
+        len -= n;
+        if (n > 0 && shm_ring_take_waiter(&shm->to_server)) {
+            char bell = 0;
+            if (send(client_fd, &bell, 1, MSG_NOSIGNAL) != 1) return -1;
+        }
+        if (len > 0) {
+            // the server empties the ring as soon as it wakes up
+            if (server_gone()) return -1;
+            struct timespec tm = { 0, 100000 };
+            nanosleep(&tm, NULL);
+        }
+    }
+    return 0;
+}
+
+// waits for the server to write to the ring, and moves what it wrote into rx
+static int fill_ring() {
+    for (;;) {
+        uint32_t tail = __atomic_load_n(&shm->to_client.tail, __ATOMIC_ACQUIRE);
+        ssize_t r = frame_reader_fill_ring(&rx, &shm->to_client);
+        if (r != 0) return r < 0 ? -1 : 0;
+        if (shm_ring_park(&shm->to_client)) continue;
+        shm_ring_wait(&shm->to_client, tail, SHM_POLL_MS);
+        if (shm_ring_used(&shm->to_client) == 0 && server_gone()) return -1;
+    }
+}
+
+// encodes and sends one packet on the current connection
+static int write_frame(const client_packet_t *pkt) {
+    wire_buf_t frame;
+    if (wire_encode_client(pkt, &frame) < 0) return -1;
+    if (shm) return write_ring(frame.bytes, frame.len);
+    return send(client_fd, frame.bytes, frame.len, MSG_NOSIGNAL) == (ssize_t)frame.len ? 0 : -1;
+}
+
+// sends the JOIN or RESUME that opens a connection; on shared memory the channel goes with it
+static int write_hello(const client_packet_t *pkt) {
+    if (!shm) return write_frame(pkt);
+    wire_buf_t frame;
+    if (wire_encode_client(pkt, &frame) < 0) return -1;
+    ssize_t sent = transport_send_fd(client_fd, frame.bytes, frame.len, shm_fd);
+    close(shm_fd);
+    shm_fd = -1;
+    return sent == (ssize_t)frame.len ? 0 : -1;
+}
+
+// returns the next packet of the current connection, reading only when no whole frame is buffered
+static int read_frame(server_packet_t *pkt) {
+    int got;
+    while ((got = frame_reader_next_server(&rx, pkt)) == 0) {
+        if (shm) {
+            if (fill_ring() < 0) return -1;
+        }
+        else if (frame_reader_fill(&rx, client_fd, 0) <= 0) return -1;
+    }
+    return got > 0 ? 0 : -1;
+}
+
+static void close_connection() {
+    if (client_fd >= 0) close(client_fd);
+    client_fd = -1;
+    shm_channel_unmap(shm);
+    shm = NULL;
+    if (shm_fd >= 0) close(shm_fd);
+    shm_fd = -1;
+}
+
+// like write_frame(), but a dropped connection is resumed and the packet sent again
+static int write_packet(const client_packet_t *pkt) {
+    if (write_frame(pkt) == 0) return 0;
+    if (resume_session() < 0) return -1;
+    return write_frame(pkt);
+}
+
+// like read_frame(), but a dropped connection is resumed and reading goes on
+static int read_packet(server_packet_t *pkt) {
+    while (read_frame(pkt) < 0) {
+        if (resume_session() < 0) return -1;
+    }
+    return 0;
+}
+
+// the next packet in arrival order: first whatever send_packet() set aside, then the socket
+static int next_packet(server_packet_t *pkt) {
+    if (backlog_count > 0) {
+        *pkt = backlog[backlog_head];
+        backlog_head = (backlog_head + 1) % BACKLOG_SIZE;
+        --backlog_count;
+        return 0;
+    }
+    return read_packet(pkt);
+}
+
+static int push_backlog(const server_packet_t *pkt) {
+    if (backlog_count == BACKLOG_SIZE) return -1;
+    backlog[(backlog_head + backlog_count) % BACKLOG_SIZE] = *pkt;
+    ++backlog_count;
+    return 0;
+}
 
 int connect_to_serv(player_id_t player_id) {
+    return connect_to_table(0, player_id) < 0 ? -1 : 0;
+}
+
+// POKER_TRANSPORT=unix or shm picks the transport of a client that did not call set_transport()
+static void choose_transport() {
+    if (transport_chosen) return;
+    const char *name = getenv("POKER_TRANSPORT");
+    if (name && strcmp(name, "unix") == 0) transport = TRANSPORT_UNIX;
+    else if (name && strcmp(name, "shm") == 0) transport = TRANSPORT_SHM;
+    else transport = TRANSPORT_TCP;
+}
+
+// opens client_fd to the server, retrying with a growing backoff for up to max_time nanoseconds
+static int open_connection(size_t max_time) {
     struct sockaddr_in serv_addr;
+    struct sockaddr_un unix_addr;
+    struct sockaddr *addr = (struct sockaddr *)&serv_addr;
+    socklen_t addr_len = sizeof(serv_addr);
 
-    int port = BASE_PORT + player_id;
+    int port = BASE_PORT;
 
-    client_fd = socket(AF_INET, SOCK_STREAM, 0);
+    choose_transport();
+    client_fd = socket(transport == TRANSPORT_TCP ? AF_INET : AF_UNIX, SOCK_STREAM, 0);
     if (client_fd < 0) {
         log_err("socket failed in connect_to_serv");
         return -1;
     }
+    frame_reader_init(&rx);
+    backlog_head = backlog_count = 0;
 
     memset(&serv_addr, 0, sizeof(serv_addr));
     serv_addr.sin_family = AF_INET;
@@ -112,12 +299,20 @@ int connect_to_serv(player_id_t player_id) {
         return -1;
     }
 
+    if (transport != TRANSPORT_TCP) {
+        memset(&unix_addr, 0, sizeof(unix_addr));
+        unix_addr.sun_family = AF_UNIX;
+        strncpy(unix_addr.sun_path, TRANSPORT_UNIX_PATH, sizeof(unix_addr.sun_path) - 1);
+        addr = (struct sockaddr *)&unix_addr;
+        addr_len = sizeof(unix_addr);
+    }
+
     int connection_success = 0;
     int attempt_num = 0;
     struct timespec tm;
-    for (size_t timer = 100000000; timer < MAX_CONNECTION_ATTEMPT_TIME; timer *= 2)
+    for (size_t timer = 100000000; timer < max_time; timer *= 2)
     {
-        if (connect(client_fd, (struct sockaddr *)&serv_addr, sizeof(serv_addr)) >= 0) 
+        if (connect(client_fd, addr, addr_len) >= 0) 
         {
             connection_success = 1;
             break;
@@ -137,51 +332,153 @@ int connect_to_serv(player_id_t player_id) {
         return -1;
     }
 
-    log_info("[Client] Successfully connected to server at %s:%d", SERVER_IP, port);
+    if (transport == TRANSPORT_SHM && !(shm = shm_channel_create(&shm_fd))) {
+        log_err("could not set up shared memory in connect_to_serv");
+        close_connection();
+        return -1;
+    }
+
+    if (transport == TRANSPORT_TCP)
+        log_info("[Client] Successfully connected to server at %s:%d", SERVER_IP, port);
+    else
+        log_info("[Client] Successfully connected to server at %s", TRANSPORT_UNIX_PATH);
+    return 0;
+}
+
+int connect_to_table(int table_id, player_id_t player_id) {
+    if (open_connection(MAX_CONNECTION_ATTEMPT_TIME) < 0) return -1;
+    // quietly, so the logs read the same with or without a table
+    if (preflop.file == NULL)
+        preflop_table_open(&preflop, PREFLOP_TABLE_PATH);
 
     client_packet_t pkt = { 0 };
     pkt.packet_type = JOIN;
+    pkt.seq = next_seq++;
+    pkt.params[0] = table_id;
+    pkt.params[1] = player_id;
+    pkt.params[2] = JOIN_DELTA_INFO;
 
     log_info("[Client ~> Server] Sending packet: type=%s", CLIENT_PACKET_TYPE_NAMES[pkt.packet_type]);
 
-    if (send(client_fd, &pkt, sizeof(client_packet_t), 0) <= 0) {
+    if (write_hello(&pkt) < 0) {
         log_err("send failed in join.");
         return -1;
     }
 
+    // the server answers JOIN with the seat it gave us (or NACK if there is none)
+    server_packet_t response;
+    if (read_frame(&response) < 0) {
+        log_err("recv failed after sending join.");
+        disconnect_to_serv();
+        return -1;
+    }
+    if (response.packet_type != ACK) {
+        log_err("server refused to seat us at table %d", table_id);
+        disconnect_to_serv();
+        return -1;
+    }
+
+    joined_table = response.join.table_id;
+    joined_seat = response.join.player_id;
+    resume_token = response.join.token;
+    last_info_version = 0;
+    return joined_seat;
+}
+
+// reconnects after the connection dropped and takes the seat back with the token from JOIN
+static int resume_session() {
+    if (joined_table < 0 || resume_token == 0 || halt_received) return -1;
+
+    log_err("lost the connection to the server, resuming seat %d at table %d", joined_seat, joined_table);
+    close_connection();
+    if (open_connection(MAX_RESUME_ATTEMPT_TIME) < 0) return -1;
+
+    client_packet_t pkt = { .packet_type = RESUME, .seq = next_seq++ };
+    pkt.params[0] = joined_table;
+    pkt.params[1] = joined_seat;
+    pkt.params[2] = resume_token;
+    server_packet_t response;
+    if (write_hello(&pkt) < 0 || read_frame(&response) < 0 || response.packet_type != ACK) {
+        log_err("server did not give back seat %d at table %d", joined_seat, joined_table);
+        disconnect_to_serv();
+        return -1;
+    }
+
+    // the server follows up with the full INFO; deltas until then are of no use
+    last_info_version = 0;
+    resumed_last_seq = response.join.last_seq;
+    resumed_last_accepted = response.join.last_accepted;
+    ++resumes;
     return 0;
 }
 
 int disconnect_to_serv() {
+    joined_table = -1;
+    resume_token = 0;
+    preflop_table_close(&preflop);
     if (client_fd >= 0) {
-        close(client_fd);
-        client_fd = -1;
+        close_connection();
         return 0;
     }
     return -1;
 }
 
-int send_packet(client_packet_t *pkt) {
+int send_packet_async(client_packet_t *pkt) {
     if (!pkt || client_fd < 0) return -1;
 
+    pkt->seq = next_seq++;
     if (pkt->packet_type == RAISE)
         log_info("[Client ~> Server] Sending packet: type=%s, param[0]=%d", CLIENT_PACKET_TYPE_NAMES[pkt->packet_type], pkt->params[0]);
     else
         log_info("[Client ~> Server] Sending packet: type=%s", CLIENT_PACKET_TYPE_NAMES[pkt->packet_type]);
 
-    if (send(client_fd, pkt, sizeof(client_packet_t), 0) <= 0) {
+    if (write_packet(pkt) < 0) {
         log_err("send failed in send_packet");
         return -1;
     }
+    return pkt->seq;
+}
+
+int send_packet(client_packet_t *pkt) {
+    int seq = send_packet_async(pkt);
+    if (seq < 0) return -1;
 
-    if (pkt->packet_type == READY || pkt->packet_type == LEAVE) {
+    if (pkt->packet_type == READY || pkt->packet_type == LEAVE || pkt->packet_type == RESYNC) {
         return 0;
     }
 
     server_packet_t response;
-    if (recv(client_fd, &response, sizeof(server_packet_t), 0) <= 0) {
-        log_err("recv failed after sending packet");
-        return -1;
+    int resumes_seen = resumes;
+    for (;;) {
+        if (read_packet(&response) < 0) {
+            log_err("recv failed after sending packet");
+            return -1;
+        }
+        if (resumes != resumes_seen) {
+            // the connection dropped while we waited: the packet either never got there,
+            // or its answer was lost with the connection
+            resumes_seen = resumes;
+            if (resumed_last_seq == seq) {
+                if (push_backlog(&response) < 0) {
+                    log_err("too many packets queued ahead of the response to packet %d", seq);
+                    return -1;
+                }
+                response.packet_type = resumed_last_accepted ? ACK : NACK;
+                response.seq = seq;
+                break;
+            }
+            if (resumed_last_seq < seq && write_packet(pkt) < 0) {
+                log_err("send failed in send_packet");
+                return -1;
+            }
+        }
+        if ((response.packet_type == ACK || response.packet_type == NACK) && response.seq == seq) {
+            break;
+        }
+        if (push_backlog(&response) < 0) {
+            log_err("too many packets queued ahead of the response to packet %d", seq);
+            return -1;
+        }
     }
 
     log_info("[Server ~> Client] Received response packet: type=%s", SERVER_PACKET_TYPE_NAMES[response.packet_type]);
@@ -189,12 +486,70 @@ int send_packet(client_packet_t *pkt) {
     return (response.packet_type == ACK) ? 0 : -1;
 }
 
+// applies the fields flagged in a delta on top of last_info
+static void apply_delta(const delta_packet_t *delta) {
+    const info_packet_t *next = &delta->state;
+    if (delta->changed & DELTA_COMMUNITY)
+        memcpy(last_info.community_cards, next->community_cards, sizeof(last_info.community_cards));
+    if (delta->changed & DELTA_POT)
+        last_info.pot_size = next->pot_size;
+    if (delta->changed & DELTA_DEALER)
+        last_info.dealer = next->dealer;
+    if (delta->changed & DELTA_TURN)
+        last_info.player_turn = next->player_turn;
+    if (delta->changed & DELTA_BET_SIZE)
+        last_info.bet_size = next->bet_size;
+    for (int i = 0; i < MAX_PLAYERS; i++) {
+        if (delta->changed & DELTA_STACK(i))
+            last_info.player_stacks[i] = next->player_stacks[i];
+        if (delta->changed & DELTA_BET(i))
+            last_info.player_bets[i] = next->player_bets[i];
+        if (delta->changed & DELTA_STATUS(i))
+            last_info.player_status[i] = next->player_status[i];
+    }
+    last_info.version = next->version;
+}
+
 int recv_packet(server_packet_t *pkt) {
     if (!pkt || client_fd < 0) return -1;
 
-    if (recv(client_fd, pkt, sizeof(server_packet_t), 0) <= 0) {
-        log_err("recv failed in recv_packet");
-        return -1;
+    for (;;) {
+        if (next_packet(pkt) < 0) {
+            log_err("recv failed in recv_packet");
+            return -1;
+        }
+        if (pkt->packet_type == INFO) {
+            last_info = pkt->info;
+            last_info_version = pkt->info.version;
+            break;
+        }
+        // the chances are passed on as they come and do not count as the last packet, so
+        // is_players_turn() still answers from the INFO before them
+        if (pkt->packet_type == EQUITY) {
+            log_equity_packet(&pkt->equity);
+            if (equity_handler) {
+                equity_handler(&pkt->equity);
+            }
+            continue;
+        }
+        if (pkt->packet_type != DELTA) {
+            break;
+        }
+        // a delta on top of a state we do not have is dropped until the full INFO arrives
+        if (last_info_version == 0 || pkt->delta.base_version != last_info_version) {
+            log_err("missed an update (have version %d, delta needs %d), resyncing", last_info_version, pkt->delta.base_version);
+            last_info_version = 0;
+            client_packet_t resync = { .packet_type = RESYNC };
+            if (send_packet(&resync) < 0) {
+                return -1;
+            }
+            continue;
+        }
+        apply_delta(&pkt->delta);
+        last_info_version = last_info.version;
+        pkt->packet_type = INFO;
+        pkt->info = last_info;
+        break;
     }
 
     memcpy(&last_server_packet, pkt, sizeof(server_packet_t));
@@ -221,9 +576,15 @@ int recv_packet(server_packet_t *pkt) {
             break;
         case ACK:
             log_info("[Server ~> Client] Received ACK");
+            if (ack_handler) {
+                ack_handler(pkt->seq, 1);
+            }
             break;
         case NACK:
             log_info("[Server ~> Client] Received NACK");
+            if (ack_handler) {
+                ack_handler(pkt->seq, 0);
+            }
             break;
         default:
             log_info("[Server ~> Client] Received unknown packet type: %d", pkt->packet_type);
@@ -247,6 +608,14 @@ void set_on_halt_packet_handler(on_halt_packet_handler_t handler) {
     halt_handler = handler;
 }
 
+void set_on_ack_packet_handler(ack_packet_handler_t handler) {
+    ack_handler = handler;
+}
+
+void set_on_equity_packet_handler(equity_packet_handler_t handler) {
+    equity_handler = handler;
+}
+
 // ------------------------- Poker move functions --------------------------- //
 
 int ready() {
@@ -291,4 +660,17 @@ int is_players_turn(player_id_t player_id) {
 
 int has_recv_halt() {
     return halt_received;
-}
\ No newline at end of file
+}
+
+int preflop_chances(const info_packet_t *info, double *equity) {
+    if (preflop.file == NULL || info->community_cards[0] != NOCARD
+        || info->player_cards[0] == NOCARD || info->player_cards[1] == NOCARD)
+        return -1;
+    int players = 0;
+    for (int i = 0; i < MAX_PLAYERS; i++)
+        players += info->player_status[i] == 1;
+    if (players < 2)
+        return -1;
+    *equity = preflop_equity_vs_field(&preflop, preflop_class(info->player_cards[0], info->player_cards[1]), players);
+    return 0;
+}
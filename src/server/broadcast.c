@@ -0,0 +1,151 @@
+// broadcast.c
+#include <string.h>
+#include <sys/uio.h>
+
+#include "broadcast.h"
+#include "client_action_handler.h"
+
+// flags every field of next that differs from prev and copies it into the delta
+static unsigned int info_diff(const info_packet_t *prev, const info_packet_t *next, delta_packet_t *delta) {
+    unsigned int changed = 0;
+    if(memcmp(prev->community_cards, next->community_cards, sizeof(next->community_cards)) != 0){
+        changed |= DELTA_COMMUNITY;
+    }
+    if(prev->pot_size != next->pot_size){
+        changed |= DELTA_POT;
+    }
+    if(prev->dealer != next->dealer){
+        changed |= DELTA_DEALER;
+    }
+    if(prev->player_turn != next->player_turn){
+        changed |= DELTA_TURN;
+    }
+    if(prev->bet_size != next->bet_size){
+        changed |= DELTA_BET_SIZE;
+    }
+    for(int i = 0; i < MAX_PLAYERS; i++){
+        if(prev->player_stacks[i] != next->player_stacks[i]){
+            changed |= DELTA_STACK(i);
+        }
+        if(prev->player_bets[i] != next->player_bets[i]){
+            changed |= DELTA_BET(i);
+        }
+        if(prev->player_status[i] != next->player_status[i]){
+            changed |= DELTA_STATUS(i);
+        }
+    }
+    delta->changed = changed;
+    delta->state = *next;
+    return changed;
+}
+
+void outbox_reset(outbox_t *box) {
+    memset(box->has_reply, 0, sizeof(box->has_reply));
+    box->has_shared = 0;
+    box->has_delta = 0;
+}
+
+void outbox_subscribe(outbox_t *box, player_id_t pid, int flags) {
+    box->seat_version[pid] = 0;
+    box->wants_delta[pid] = (flags & JOIN_DELTA_INFO) != 0;
+}
+
+static void set_shared(outbox_t *box, const server_packet_t *pkt) {
+    box->has_shared = wire_encode_server(pkt, &box->shared) > 0;
+    box->shared_type = pkt->packet_type;
+}
+
+void outbox_reply(outbox_t *box, player_id_t pid, const server_packet_t *pkt) {
+    box->has_reply[pid] = wire_encode_server(pkt, &box->replies[pid]) > 0;
+}
+
+void outbox_joined(outbox_t *box, const join_packet_t *join, int seq) {
+    player_id_t pid = join->player_id;
+    box->has_reply[pid] = wire_encode_join_ack(seq, join, &box->replies[pid]) > 0;
+}
+
+void outbox_info(outbox_t *box, game_state_t *game) {
+    server_packet_t pkt;
+    build_public_info_packet(game, &pkt);
+    pkt.info.version = box->info_version + 1;
+    set_shared(box, &pkt);
+
+    box->has_delta = 0;
+    if(box->info_version > 0){
+        server_packet_t delta = { .packet_type = DELTA };
+        delta.delta.base_version = box->info_version;
+        info_diff(&box->last_info, &pkt.info, &delta.delta);
+        box->delta_base = box->info_version;
+        box->has_delta = wire_encode_server(&delta, &box->delta) > 0;
+    }
+    box->last_info = pkt.info;
+    box->info_version = pkt.info.version;
+}
+
+void outbox_snapshot(outbox_t *box, game_state_t *game) {
+    outbox_info(box, game);
+    box->has_delta = 0;
+}
+
+void outbox_resync(outbox_t *box, game_state_t *game, player_id_t pid) {
+    if(box->info_version == 0){
+        return;
+    }
+    server_packet_t pkt;
+    build_info_packet(game, pid, &pkt);
+    pkt.info.version = box->info_version;
+    outbox_reply(box, pid, &pkt);
+    box->seat_version[pid] = box->info_version;
+}
+
+void outbox_end(outbox_t *box, game_state_t *game, player_id_t winner) {
+    server_packet_t pkt;
+    build_end_packet(game, winner, &pkt);
+    set_shared(box, &pkt);
+}
+
+void outbox_halt(outbox_t *box) {
+    server_packet_t pkt = { .packet_type = HALT };
+    set_shared(box, &pkt);
+}
+
+unsigned outbox_flush(outbox_t *box, game_state_t *game, connection_t *const conns[MAX_PLAYERS]) {
+    unsigned evicted = 0;
+    uint8_t *shared = box->shared.bytes;
+    size_t rest = WIRE_INFO_CARDS_OFFSET + WIRE_INFO_CARDS_SIZE;
+    for(int p = 0; p < MAX_PLAYERS; p++){
+        if(!conns[p]){
+            continue;
+        }
+        uint8_t cards[WIRE_INFO_CARDS_SIZE] = { wire_card(game->player_hands[p][0]), wire_card(game->player_hands[p][1]) };
+        struct iovec iov[4];
+        int n = 0;
+        if(box->has_reply[p]){
+            iov[n++] = (struct iovec){ box->replies[p].bytes, box->replies[p].len };
+        }
+        // a congested seat skips INFOs; it is sent the one it missed once it drains. a seat
+        // sitting the hand out is sent everything the players are
+        int coalesce = box->shared_type == INFO && connection_congested(conns[p]);
+        if(box->has_shared && !coalesce){
+            if(box->shared_type == INFO && box->has_delta && box->wants_delta[p] && box->seat_version[p] == box->delta_base){
+                iov[n++] = (struct iovec){ box->delta.bytes, box->delta.len };
+            }
+            else if(box->shared_type == INFO){
+                iov[n++] = (struct iovec){ shared, WIRE_INFO_CARDS_OFFSET };
+                iov[n++] = (struct iovec){ cards, WIRE_INFO_CARDS_SIZE };
+                iov[n++] = (struct iovec){ shared + rest, box->shared.len - rest };
+            }
+            else{
+                iov[n++] = (struct iovec){ shared, box->shared.len };
+            }
+            if(box->shared_type == INFO){
+                box->seat_version[p] = box->info_version;
+            }
+        }
+        if(n > 0 && connection_send(conns[p], iov, n) < 0){
+            evicted |= 1u << p;
+        }
+    }
+    outbox_reset(box);
+    return evicted;
+}
@@ -35,8 +35,7 @@ int handle_client_action(game_state_t *game, player_id_t pid, const client_packe
     if(pid != game->current_player || game->player_status[pid] != PLAYER_ACTIVE){
         return -1;
     }
-    int have = game->current_bets[pid];
-    int callAmt = have < 0 ? game->highest_bet : game->highest_bet - have;
+    int callAmt = game->highest_bet - game->current_bets[pid];
     switch(in->packet_type){
         case CHECK:
             if(callAmt!=0){
@@ -73,8 +72,8 @@ int handle_client_action(game_state_t *game, player_id_t pid, const client_packe
             game->highest_bet = newAmt;
             game->pot_size += diff;
             for(int i = 0; i < MAX_PLAYERS; i++){
-                if(i != pid && game->player_status[i] == PLAYER_ACTIVE){
-                    game->current_bets[i] = -1;
+                if(i != pid){
+                    game->has_acted[i] = 0;
                 }
             }
             break;
@@ -85,9 +84,7 @@ int handle_client_action(game_state_t *game, player_id_t pid, const client_packe
         default:
             return -1;
     }
-    if(game->player_status[pid] == PLAYER_ACTIVE || game->player_status[pid] == PLAYER_ALLIN){
-        game->current_bets[pid] = game->highest_bet;
-    }
+    game->has_acted[pid] = 1;
 
     int nxt = (pid + 1) % MAX_PLAYERS;
     while(nxt != pid && game->player_status[nxt] != PLAYER_ACTIVE){
@@ -96,19 +93,18 @@ int handle_client_action(game_state_t *game, player_id_t pid, const client_packe
     game->current_player = nxt;
 
     out->packet_type = ACK;
-    for(int p = 0; p < MAX_PLAYERS; p++){
-        if(game->player_status[p] != PLAYER_LEFT){
-            server_packet_t infoPkt;
-            build_info_packet(game, p, &infoPkt);
-            send(game->sockets[p], &infoPkt, sizeof(infoPkt), 0);
-        }
-    }
     return 0;
 }
 
-void build_info_packet(game_state_t *game, player_id_t pid, server_packet_t *out) {
+void build_public_info_packet(game_state_t *game, server_packet_t *out) {
     out->packet_type = INFO;
     save_state(game, &out->info);
+    out->info.player_cards[0] = NOCARD;
+    out->info.player_cards[1] = NOCARD;
+}
+
+void build_info_packet(game_state_t *game, player_id_t pid, server_packet_t *out) {
+    build_public_info_packet(game, out);
     out->info.player_cards[0] = game->player_hands[pid][0];
     out->info.player_cards[1] = game->player_hands[pid][1];
 }
@@ -0,0 +1,114 @@
+// connection.c
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "connection.h"
+#include "server_io.h"
+
+connection_t *connection_new(int fd, uint32_t gen, outbound_t *outbound) {
+    connection_t *conn = calloc(1, sizeof(connection_t));
+    if(!conn){
+        return NULL;
+    }
+    conn->fd = fd;
+    conn->gen = gen;
+    conn->table_id = -1;
+    conn->shm_fd = -1;
+    conn->pid = -1;
+    conn->outbound = outbound;
+    frame_reader_init(&conn->rx);
+    conn->join.conn = conn->gone.conn = conn->release.conn = conn;
+    conn->join.kind = COMMAND_JOIN;
+    conn->release.kind = COMMAND_RELEASE;
+    return conn;
+}
+
+void connection_free(connection_t *conn) {
+    free(conn);
+}
+
+command_t *command_new(connection_t *conn, command_kind_t kind, const client_packet_t *pkt) {
+    command_t *cmd = malloc(sizeof(command_t));
+    if(!cmd){
+        return NULL;
+    }
+    cmd->kind = kind;
+    cmd->allocated = 1;
+    cmd->conn = conn;
+    if(pkt){
+        cmd->pkt = *pkt;
+    }
+    return cmd;
+}
+
+void command_free(command_t *cmd) {
+    if(cmd->allocated){
+        free(cmd);
+    }
+}
+
+// the connection goes onto the outbound queue unless it is there already. the network thread
+// clears queued before it looks at the ring, so whatever is written after that queues it again
+static void wake_sender(connection_t *conn) {
+    if(__atomic_exchange_n(&conn->queued, 1, __ATOMIC_SEQ_CST)){
+        return;
+    }
+    mpsc_queue_push(&conn->outbound->ready, &conn->ready);
+    mpsc_bell_ring(&conn->outbound->bell);
+}
+
+int connection_send(connection_t *conn, const struct iovec *iov, int iovcnt) {
+    size_t total = 0;
+    for(int i = 0; i < iovcnt; i++){
+        total += iov[i].iov_len;
+    }
+    ssize_t used = shm_ring_used(&conn->out);
+    if(used < 0 || used + total > SHM_RING_SIZE){
+        return -1;
+    }
+    for(int i = 0; i < iovcnt; i++){
+        shm_ring_write(&conn->out, iov[i].iov_base, iov[i].iov_len);
+    }
+    wake_sender(conn);
+    return 0;
+}
+
+int connection_congested(connection_t *conn) {
+    return __atomic_load_n(&conn->congested, __ATOMIC_RELAXED) || shm_ring_used(&conn->out) > SERVER_IO_HIGH_WATER;
+}
+
+void connection_close(connection_t *conn) {
+    __atomic_store_n(&conn->closed, 1, __ATOMIC_SEQ_CST);
+    wake_sender(conn);
+}
+
+int connection_closing(connection_t *conn) {
+    return __atomic_load_n(&conn->closed, __ATOMIC_SEQ_CST);
+}
+
+// the engine's last touch of a connection is the wake_sender() of connection_close(). if that
+// found queued clear it pushes the connection again, and freeing it now would leave it on the
+// queue; setting queued here either waits for that push or keeps it from happening
+int connection_done(connection_t *conn) {
+    return __atomic_exchange_n(&conn->queued, 1, __ATOMIC_SEQ_CST) == 0;
+}
+
+int outbound_init(outbound_t *outbound) {
+    mpsc_queue_init(&outbound->ready);
+    return mpsc_bell_init(&outbound->bell);
+}
+
+connection_t *outbound_pop(outbound_t *outbound) {
+    mpsc_node_t *node = mpsc_queue_pop(&outbound->ready);
+    if(!node){
+        return NULL;
+    }
+    connection_t *conn = (connection_t *)((char *)node - offsetof(connection_t, ready));
+    __atomic_store_n(&conn->queued, 0, __ATOMIC_SEQ_CST);
+    return conn;
+}
+
+void outbound_fini(outbound_t *outbound) {
+    mpsc_bell_fini(&outbound->bell);
+}
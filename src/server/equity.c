@@ -0,0 +1,429 @@
+// equity.c
+#include <string.h>
+#include <math.h>
+
+#include "equity.h"
+#include "hand_eval.h"
+#include "rng.h"
+
+// shares of the pot are counted in 60ths, which every split between up to MAX_PLAYERS divides
+// evenly. whole numbers add up the same in any order, so the totals of a run do not depend on
+// which thread finished which chunk first
+#define POT_UNITS 60
+
+/**
+ * what one chunk of runouts added up to
+ */
+typedef struct {
+    uint64_t trials;
+    uint64_t wins[MAX_PLAYERS], ties[MAX_PLAYERS];
+    uint64_t share[MAX_PLAYERS], share_sq[MAX_PLAYERS];   // in POT_UNITS
+} tally_t;
+
+static card_set_t held_cards(const equity_spot_t *spot) {
+    card_set_t held = spot->board | spot->dead;
+    for(int i = 0; i < MAX_PLAYERS; i++){
+        held |= spot->hands[i];
+    }
+    return held;
+}
+
+static int valid_spot(const equity_spot_t *spot) {
+    card_set_t seen = spot->board | spot->dead;
+    int seats = 0;
+    if((seen & ~CARD_SET_DECK) || (spot->board & spot->dead)
+        || card_set_count(spot->board) > MAX_COMMUNITY_CARDS){
+        return 0;
+    }
+    for(int i = 0; i < MAX_PLAYERS; i++){
+        card_set_t hand = spot->hands[i];
+        if(hand == CARD_SET_EMPTY){
+            continue;
+        }
+        if((hand & ~CARD_SET_DECK) || (hand & seen) || card_set_count(hand) != HAND_SIZE){
+            return 0;
+        }
+        seen |= hand;
+        seats++;
+    }
+    int need = MAX_COMMUNITY_CARDS - card_set_count(spot->board) + HAND_SIZE * spot->random_hands;
+    return seats > 0 && spot->random_hands >= 0 && seats + spot->random_hands <= MAX_PLAYERS
+        && card_set_count(CARD_SET_DECK & ~seen) >= need;
+}
+
+// C(n, k), for k up to MAX_COMMUNITY_CARDS
+static uint64_t choose(int n, int k) {
+    if(k < 0 || k > n){
+        return 0;
+    }
+    uint64_t c = 1;
+    for(int i = 1; i <= k; i++){
+        c = c * (n - k + i) / i;
+    }
+    return c;
+}
+
+// runouts waiting to be valued together through hand_eval_batch(). each one queues the hand
+// of every seat in, then its random hands; card k of hand i is cards[k * EQUITY_BATCH + i]
+typedef struct {
+    const equity_spot_t *spot;
+    card_t board[MAX_COMMUNITY_CARDS];      // the cards of the spot's board, then room for the runout
+    int board_cards;
+    int seats[MAX_PLAYERS];                 // the seats in, in the order their hands are queued
+    card_t holes[MAX_PLAYERS][HAND_SIZE];
+    int seat_count;
+    int per_runout;                         // hands queued for each runout
+    int runouts;
+    card_t cards[HAND_BATCH_CARDS * EQUITY_BATCH];
+    uint64_t values[EQUITY_BATCH];
+} batch_t;
+
+static void batch_init(batch_t *batch, const equity_spot_t *spot) {
+    batch->spot = spot;
+    batch->board_cards = card_set_cards(spot->board, batch->board);
+    batch->seat_count = 0;
+    for(int i = 0; i < MAX_PLAYERS; i++){
+        if(spot->hands[i] != CARD_SET_EMPTY){
+            card_set_cards(spot->hands[i], batch->holes[batch->seat_count]);
+            batch->seats[batch->seat_count++] = i;
+        }
+    }
+    batch->per_runout = batch->seat_count + spot->random_hands;
+    batch->runouts = 0;
+    // lanes past the last runout of a batch are valued too, and have to hold cards
+    for(int i = 0; i < HAND_BATCH_CARDS * EQUITY_BATCH; i++){
+        batch->cards[i] = NOCARD;
+    }
+}
+
+static void queue_hand(batch_t *batch, int i, const card_t *board, const card_t *hole) {
+    card_t *lane = batch->cards + i;
+    for(int k = 0; k < MAX_COMMUNITY_CARDS; k++){
+        lane[k * EQUITY_BATCH] = board[k];
+    }
+    lane[MAX_COMMUNITY_CARDS * EQUITY_BATCH] = hole[0];
+    lane[(MAX_COMMUNITY_CARDS + 1) * EQUITY_BATCH] = hole[1];
+}
+
+// values the queued runouts and adds up who won each
+static void batch_flush(batch_t *batch, tally_t *tally) {
+    if(batch->runouts == 0){
+        return;
+    }
+    hand_eval_batch(batch->cards, EQUITY_BATCH, batch->values);
+    for(int r = 0; r < batch->runouts; r++){
+        const uint64_t *value = batch->values + r * batch->per_runout;
+        uint64_t best = 0;
+        int winners = 0;
+        for(int j = 0; j < batch->per_runout; j++){
+            if(value[j] > best){
+                best = value[j];
+                winners = 1;
+            }
+            else if(value[j] == best){
+                winners++;
+            }
+        }
+        uint64_t share = POT_UNITS / winners;
+        for(int j = 0; j < batch->seat_count; j++){
+            if(value[j] != best){
+                continue;
+            }
+            int i = batch->seats[j];
+            if(winners == 1){
+                tally->wins[i]++;
+            }
+            else{
+                tally->ties[i]++;
+            }
+            tally->share[i] += share;
+            tally->share_sq[i] += share * share;
+        }
+    }
+    tally->trials += batch->runouts;
+    batch->runouts = 0;
+}
+
+// queues every seat's hand, and the random hands, on one complete board
+static void batch_runout(batch_t *batch, card_set_t runout, const card_set_t *randoms, tally_t *tally) {
+    if((batch->runouts + 1) * batch->per_runout > EQUITY_BATCH){
+        batch_flush(batch, tally);
+    }
+    card_t board[MAX_COMMUNITY_CARDS];
+    memcpy(board, batch->board, sizeof(board));
+    card_set_cards(runout, board + batch->board_cards);
+
+    int first = batch->runouts * batch->per_runout;
+    for(int j = 0; j < batch->seat_count; j++){
+        queue_hand(batch, first + j, board, batch->holes[j]);
+    }
+    for(int r = 0; r < batch->spot->random_hands; r++){
+        card_t hole[HAND_SIZE];
+        card_set_cards(randoms[r], hole);
+        queue_hand(batch, first + batch->seat_count + r, board, hole);
+    }
+    batch->runouts++;
+}
+
+// deals a chunk of random runouts
+static void deal_chunk(const equity_job_t *job, uint64_t chunk, card_set_t live, batch_t *batch, tally_t *tally) {
+    // every chunk starts its own stream from the run's seed and its index, so a run that is
+    // not stopped early gives the same totals however many threads share it
+    uint64_t rng = job->seed ^ (chunk * 0xD1B54A32D192ED03ull);
+    int live_count = card_set_count(live);
+    for(int t = 0; t < EQUITY_CHUNK; t++){
+        card_set_t deck = live, runout = CARD_SET_EMPTY, randoms[MAX_PLAYERS] = {0};
+        int left = live_count;
+        for(int k = 0; k < job->need; k++, left--){
+            card_set_t card = card_set_bit(card_set_nth(deck, rng_below(&rng, left)));
+            deck &= ~card;
+            runout |= card;
+        }
+        for(int r = 0; r < job->spot.random_hands; r++){
+            for(int k = 0; k < HAND_SIZE; k++, left--){
+                card_set_t card = card_set_bit(card_set_nth(deck, rng_below(&rng, left)));
+                deck &= ~card;
+                randoms[r] |= card;
+            }
+        }
+        batch_runout(batch, runout, randoms, tally);
+    }
+}
+
+// deals runouts chunk * EQUITY_CHUNK onwards in the order of the combinatorial number system:
+// the first is unranked from its index, and each one after is the next combination of the
+// live cards' positions, found by moving the lowest position that can move up by one
+static void enumerate_chunk(const equity_job_t *job, uint64_t chunk, card_set_t live, batch_t *batch, tally_t *tally) {
+    card_set_t cards[DECK_SIZE];
+    int pos[MAX_COMMUNITY_CARDS + 1];
+    int n = 0, k = job->need;
+    for(card_set_t rest = live; rest; rest &= rest - 1){
+        cards[n++] = rest & -rest;
+    }
+
+    uint64_t first = chunk * EQUITY_CHUNK;
+    uint64_t count = job->combinations - first < EQUITY_CHUNK ? job->combinations - first : EQUITY_CHUNK;
+    uint64_t rank = first;
+    for(int i = k, top = n - 1; i > 0; i--){
+        while(choose(top, i) > rank){
+            top--;
+        }
+        pos[i - 1] = top;
+        rank -= choose(top, i);
+        top--;
+    }
+    pos[k] = n;
+
+    for(uint64_t t = 0; t < count; t++){
+        card_set_t runout = CARD_SET_EMPTY;
+        for(int i = 0; i < k; i++){
+            runout |= cards[pos[i]];
+        }
+        batch_runout(batch, runout, NULL, tally);
+
+        int j = 0;
+        while(j < k && pos[j] + 1 == pos[j + 1]){
+            pos[j] = j;
+            j++;
+        }
+        if(j < k){
+            pos[j]++;
+        }
+    }
+}
+
+static void run_chunk(const equity_job_t *job, uint64_t chunk, tally_t *tally) {
+    card_set_t live = CARD_SET_DECK & ~held_cards(&job->spot);
+    batch_t batch;
+    batch_init(&batch, &job->spot);
+    memset(tally, 0, sizeof(*tally));
+    if(job->exact){
+        enumerate_chunk(job, chunk, live, &batch, tally);
+    }
+    else{
+        deal_chunk(job, chunk, live, &batch, tally);
+    }
+    batch_flush(&batch, tally);
+}
+
+static void add_tally(equity_job_t *job, const tally_t *tally) {
+    job->trials += tally->trials;
+    for(int i = 0; i < MAX_PLAYERS; i++){
+        job->wins[i] += tally->wins[i];
+        job->ties[i] += tally->ties[i];
+        job->share[i] += tally->share[i];
+        job->share_sq[i] += tally->share_sq[i];
+    }
+}
+
+static double margin_of(uint64_t trials, uint64_t share, uint64_t share_sq) {
+    if(trials == 0){
+        return 0;
+    }
+    double mean = (double)share / POT_UNITS / trials;
+    return equity_margin((double)share_sq / (POT_UNITS * POT_UNITS) / trials - mean * mean, trials);
+}
+
+// called with the pool locked
+static int tight_enough(const equity_job_t *job) {
+    if(job->target_margin <= 0 || job->trials < EQUITY_MIN_TRIALS){
+        return 0;
+    }
+    for(int i = 0; i < MAX_PLAYERS; i++){
+        if(job->spot.hands[i] != CARD_SET_EMPTY
+            && margin_of(job->trials, job->share[i], job->share_sq[i]) > job->target_margin){
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static void work_on(equity_pool_t *pool) {
+    equity_job_t *job = &pool->job;
+    while(!__atomic_load_n(&job->stop, __ATOMIC_ACQUIRE)){
+        uint64_t chunk = __atomic_fetch_add(&job->next_chunk, 1, __ATOMIC_RELAXED);
+        if(chunk >= job->max_chunks){
+            break;
+        }
+        tally_t tally;
+        run_chunk(job, chunk, &tally);
+
+        pthread_mutex_lock(&pool->lock);
+        add_tally(job, &tally);
+        if(tight_enough(job)){
+            __atomic_store_n(&job->stop, 1, __ATOMIC_RELEASE);
+        }
+        pthread_mutex_unlock(&pool->lock);
+    }
+}
+
+static void *equity_thread(void *arg) {
+    equity_pool_t *pool = arg;
+    uint64_t seen = 0;
+    pthread_mutex_lock(&pool->lock);
+    for(;;){
+        while(!pool->stopping && pool->run_id == seen){
+            pthread_cond_wait(&pool->work, &pool->lock);
+        }
+        if(pool->stopping){
+            break;
+        }
+        seen = pool->run_id;
+        pthread_mutex_unlock(&pool->lock);
+        work_on(pool);
+        pthread_mutex_lock(&pool->lock);
+        if(--pool->busy == 0){
+            pthread_cond_signal(&pool->done);
+        }
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+int equity_pool_init(equity_pool_t *pool, int num_threads) {
+    if(num_threads < 1 || num_threads > EQUITY_MAX_THREADS){
+        return -1;
+    }
+    memset(pool, 0, sizeof(*pool));
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_mutex_init(&pool->run_lock, NULL);
+    pthread_cond_init(&pool->work, NULL);
+    pthread_cond_init(&pool->done, NULL);
+    for(int i = 0; i < num_threads; i++){
+        if(pthread_create(&pool->threads[i], NULL, equity_thread, pool) != 0){
+            equity_pool_fini(pool);
+            return -1;
+        }
+        pool->num_threads++;
+    }
+    return 0;
+}
+
+void equity_pool_fini(equity_pool_t *pool) {
+    pthread_mutex_lock(&pool->lock);
+    pool->stopping = 1;
+    pthread_cond_broadcast(&pool->work);
+    pthread_mutex_unlock(&pool->lock);
+    for(int i = 0; i < pool->num_threads; i++){
+        pthread_join(pool->threads[i], NULL);
+    }
+    pool->num_threads = 0;
+    pthread_cond_destroy(&pool->work);
+    pthread_cond_destroy(&pool->done);
+    pthread_mutex_destroy(&pool->lock);
+    pthread_mutex_destroy(&pool->run_lock);
+}
+
+double equity_margin(double variance, uint64_t trials) {
+    return variance > 0 && trials > 0 ? EQUITY_Z_95 * sqrt(variance / trials) : 0;
+}
+
+static void fill_result(const equity_job_t *job, equity_result_t *result) {
+    memset(result, 0, sizeof(*result));
+    result->trials = job->trials;
+    result->exact = job->exact;
+    for(int i = 0; i < MAX_PLAYERS && job->trials > 0; i++){
+        result->win[i] = (double)job->wins[i] / job->trials;
+        result->tie[i] = (double)job->ties[i] / job->trials;
+        result->equity[i] = (double)job->share[i] / POT_UNITS / job->trials;
+        result->margin[i] = job->exact ? 0 : margin_of(job->trials, job->share[i], job->share_sq[i]);
+    }
+}
+
+int equity_run(equity_pool_t *pool, const equity_spot_t *spot, uint64_t max_trials,
+               double target_margin, uint64_t seed, equity_result_t *result) {
+    if(max_trials == 0 || !valid_spot(spot)){
+        return -1;
+    }
+    equity_job_t job;
+    memset(&job, 0, sizeof(job));
+    job.spot = *spot;
+    job.seed = seed;
+    job.need = MAX_COMMUNITY_CARDS - card_set_count(spot->board);
+    job.combinations = choose(card_set_count(CARD_SET_DECK & ~held_cards(spot)), job.need);
+    job.exact = spot->random_hands == 0 && job.combinations <= max_trials;
+    if(job.exact){
+        // every runout counts once, so there is nothing to stop early on
+        job.max_chunks = (job.combinations + EQUITY_CHUNK - 1) / EQUITY_CHUNK;
+    }
+    else{
+        job.max_chunks = (max_trials + EQUITY_CHUNK - 1) / EQUITY_CHUNK;
+        job.target_margin = target_margin;
+    }
+
+    // a single chunk is done on the calling thread, without waking the pool
+    if(job.max_chunks <= 1){
+        tally_t tally;
+        run_chunk(&job, 0, &tally);
+        add_tally(&job, &tally);
+        fill_result(&job, result);
+        return 0;
+    }
+
+    pthread_mutex_lock(&pool->run_lock);
+    pthread_mutex_lock(&pool->lock);
+    pool->job = job;
+    pool->run_id++;
+    pool->busy = pool->num_threads;
+    pthread_cond_broadcast(&pool->work);
+    while(pool->busy > 0){
+        pthread_cond_wait(&pool->done, &pool->lock);
+    }
+    fill_result(&pool->job, result);
+    pthread_mutex_unlock(&pool->lock);
+    pthread_mutex_unlock(&pool->run_lock);
+    return 0;
+}
+
+void equity_spot_of_game(const game_state_t *game, equity_spot_t *spot) {
+    card_set_t in = CARD_SET_EMPTY;
+    memset(spot, 0, sizeof(*spot));
+    for(int i = 0; i < MAX_PLAYERS; i++){
+        if(game->player_status[i] == PLAYER_ACTIVE || game->player_status[i] == PLAYER_ALLIN){
+            spot->hands[i] = game->hand_sets[i];
+            in |= game->hand_sets[i];
+        }
+    }
+    spot->board = game->board_set;
+    spot->dead = game->dealt_set & ~in & ~game->board_set;
+}
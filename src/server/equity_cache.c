@@ -0,0 +1,233 @@
+// equity_cache.c
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "equity_cache.h"
+#include "hand_iso.h"
+#include "hand_eval.h"
+
+static uint64_t key_hash(const equity_key_t *key) {
+    uint64_t words[] = {
+        key->index, key->max_trials,
+        (uint64_t)key->margin << 16 | (uint64_t)key->board_cards << 8 | key->opponents,
+    };
+    uint64_t h = 0;
+    for(size_t i = 0; i < sizeof(words) / sizeof(words[0]); i++){
+        h = (h ^ words[i]) * 0x9E3779B97F4A7C15ull;
+        h ^= h >> 29;
+    }
+    return h;
+}
+
+static int key_equal(const equity_key_t *a, const equity_key_t *b) {
+    return a->index == b->index && a->max_trials == b->max_trials && a->margin == b->margin
+        && a->board_cards == b->board_cards && a->opponents == b->opponents;
+}
+
+static void lru_unlink(equity_entry_t *e) {
+    e->newer->older = e->older;
+    e->older->newer = e->newer;
+}
+
+// the list runs from the head through the newest entry down to the oldest and back
+static void lru_push_newest(equity_shard_t *shard, equity_entry_t *e) {
+    e->newer = &shard->lru;
+    e->older = shard->lru.older;
+    shard->lru.older->newer = e;
+    shard->lru.older = e;
+}
+
+static equity_entry_t **bucket_of(equity_shard_t *shard, uint64_t hash) {
+    return &shard->buckets[(hash >> 4) % shard->num_buckets];
+}
+
+static equity_entry_t *find(equity_shard_t *shard, uint64_t hash, const equity_key_t *key) {
+    for(equity_entry_t *e = *bucket_of(shard, hash); e != NULL; e = e->chain){
+        if(key_equal(&e->key, key)){
+            return e;
+        }
+    }
+    return NULL;
+}
+
+static void unchain(equity_shard_t *shard, equity_entry_t *e) {
+    equity_entry_t **link = bucket_of(shard, key_hash(&e->key));
+    while(*link != e){
+        link = &(*link)->chain;
+    }
+    *link = e->chain;
+}
+
+static equity_shard_t *shard_of(equity_cache_t *cache, uint64_t hash) {
+    return &cache->shards[hash % EQUITY_CACHE_SHARDS];
+}
+
+int equity_cache_init(equity_cache_t *cache, int capacity, const preflop_table_t *preflop) {
+    int per_shard = capacity > EQUITY_CACHE_SHARDS ? (capacity + EQUITY_CACHE_SHARDS - 1) / EQUITY_CACHE_SHARDS : 1;
+    memset(cache, 0, sizeof(*cache));
+    cache->preflop = preflop != NULL && preflop->file != NULL ? preflop : NULL;
+    for(int s = 0; s < EQUITY_CACHE_SHARDS; s++){
+        equity_shard_t *shard = &cache->shards[s];
+        pthread_mutex_init(&shard->lock, NULL);
+        shard->lru.newer = shard->lru.older = &shard->lru;
+        shard->capacity = per_shard;
+        shard->num_buckets = 2 * per_shard;
+        shard->entries = calloc(per_shard, sizeof(equity_entry_t));
+        shard->buckets = calloc(shard->num_buckets, sizeof(equity_entry_t *));
+        if(shard->entries == NULL || shard->buckets == NULL){
+            equity_cache_fini(cache);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+void equity_cache_fini(equity_cache_t *cache) {
+    for(int s = 0; s < EQUITY_CACHE_SHARDS; s++){
+        equity_shard_t *shard = &cache->shards[s];
+        if(shard->capacity == 0){
+            continue;
+        }
+        free(shard->entries);
+        free(shard->buckets);
+        pthread_mutex_destroy(&shard->lock);
+        memset(shard, 0, sizeof(*shard));
+    }
+}
+
+int equity_cache_get(equity_cache_t *cache, const equity_key_t *key, hand_outlook_t *outlook) {
+    uint64_t hash = key_hash(key);
+    equity_shard_t *shard = shard_of(cache, hash);
+    pthread_mutex_lock(&shard->lock);
+    equity_entry_t *e = find(shard, hash, key);
+    if(e != NULL){
+        lru_unlink(e);
+        lru_push_newest(shard, e);
+        *outlook = e->outlook;
+        shard->hits++;
+    }
+    else{
+        shard->misses++;
+    }
+    pthread_mutex_unlock(&shard->lock);
+    return e != NULL;
+}
+
+void equity_cache_put(equity_cache_t *cache, const equity_key_t *key, const hand_outlook_t *outlook) {
+    uint64_t hash = key_hash(key);
+    equity_shard_t *shard = shard_of(cache, hash);
+    pthread_mutex_lock(&shard->lock);
+    equity_entry_t *e = find(shard, hash, key);
+    if(e != NULL){
+        lru_unlink(e);
+    }
+    else{
+        if(shard->used < shard->capacity){
+            e = &shard->entries[shard->used++];
+        }
+        else{
+            e = shard->lru.newer;
+            lru_unlink(e);
+            unchain(shard, e);
+        }
+        e->key = *key;
+        equity_entry_t **bucket = bucket_of(shard, hash);
+        e->chain = *bucket;
+        *bucket = e;
+    }
+    e->outlook = *outlook;
+    lru_push_newest(shard, e);
+    pthread_mutex_unlock(&shard->lock);
+}
+
+void equity_key_of(card_set_t hand, card_set_t board, int opponents, uint64_t max_trials,
+                   double target_margin, equity_key_t *key) {
+    memset(key, 0, sizeof(*key));
+    key->index = hand_iso_index(hand, board);
+    key->max_trials = max_trials;
+    // -0.0 and NaN fail the test as well as 0 does
+    key->margin = target_margin > 0 ? (uint32_t)lround(target_margin * EQUITY_MARGIN_STEPS) : 0;
+    key->board_cards = (uint8_t)card_set_count(board);
+    key->opponents = (uint8_t)opponents;
+}
+
+// the share of the pot a hand takes against every hole pair left, as the board stands
+static double hand_strength(card_set_t hand, card_set_t board, uint64_t *pairs) {
+    card_set_t live = CARD_SET_DECK & ~hand & ~board;
+    hand_state_t walked = hand_state_add(HAND_STATE_EMPTY, board);
+    uint64_t mine = hand_state_value(hand_state_add(walked, hand));
+    uint64_t ahead = 0, tied = 0;
+    *pairs = 0;
+    for(card_set_t a = live; a; a &= a - 1){
+        card_set_t first = a & -a;
+        for(card_set_t b = a & (a - 1); b; b &= b - 1){
+            uint64_t theirs = hand_state_value(hand_state_add(walked, first | (b & -b)));
+            ahead += mine > theirs;
+            tied += mine == theirs;
+            ++*pairs;
+        }
+    }
+    return (ahead + tied / 2.0) / *pairs;
+}
+
+int equity_hand_cached(equity_cache_t *cache, equity_pool_t *pool, card_set_t hand, card_set_t board,
+                       int opponents, uint64_t max_trials, double target_margin, uint64_t seed,
+                       hand_outlook_t *outlook) {
+    if(card_set_count(hand) != HAND_SIZE || ((hand | board) & ~CARD_SET_DECK) || (hand & board)
+        || card_set_count(board) > MAX_COMMUNITY_CARDS || opponents < 1 || opponents >= MAX_PLAYERS){
+        return -1;
+    }
+    equity_key_t key;
+    equity_key_of(hand, board, opponents, max_trials, target_margin, &key);
+    if(equity_cache_get(cache, &key, outlook)){
+        return 0;
+    }
+
+    card_set_t canon_hand, canon_board;
+    hand_iso_unindex(key.board_cards, key.index, &canon_hand, &canon_board);
+    uint64_t pairs;
+    outlook->strength = hand_strength(canon_hand, canon_board, &pairs);
+    if(key.board_cards == 0 && cache->preflop != NULL){
+        card_t cards[HAND_SIZE];
+        card_set_cards(canon_hand, cards);
+        double equity = preflop_equity_vs_field(cache->preflop, preflop_class(cards[0], cards[1]), opponents + 1);
+        uint64_t trials = cache->preflop->file->header.trials;
+        outlook->equity = equity;
+        outlook->margin = equity_margin(equity * (1 - equity), trials);
+        outlook->trials = trials;
+    }
+    else if(key.board_cards == MAX_COMMUNITY_CARDS && opponents == 1){
+        // nothing left to come, so the showdown is the board as it stands
+        outlook->equity = outlook->strength;
+        outlook->margin = 0;
+        outlook->trials = pairs;
+    }
+    else{
+        equity_spot_t spot;
+        equity_result_t result;
+        memset(&spot, 0, sizeof(spot));
+        spot.hands[0] = canon_hand;
+        spot.board = canon_board;
+        spot.random_hands = opponents;
+        if(equity_run(pool, &spot, max_trials, (double)key.margin / EQUITY_MARGIN_STEPS, seed, &result) < 0){
+            return -1;
+        }
+        outlook->equity = result.equity[0];
+        outlook->margin = result.margin[0];
+        outlook->trials = result.trials;
+    }
+    equity_cache_put(cache, &key, outlook);
+    return 0;
+}
+
+void equity_cache_stats(equity_cache_t *cache, uint64_t *hits, uint64_t *misses) {
+    *hits = *misses = 0;
+    for(int s = 0; s < EQUITY_CACHE_SHARDS; s++){
+        equity_shard_t *shard = &cache->shards[s];
+        pthread_mutex_lock(&shard->lock);
+        *hits += shard->hits;
+        *misses += shard->misses;
+        pthread_mutex_unlock(&shard->lock);
+    }
+}
@@ -0,0 +1,98 @@
+// equity_service.c
+#include <stdio.h>
+#include <stddef.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+
+#include "equity_service.h"
+
+static void answer(equity_service_t *svc, equity_request_t *req) {
+    if(req->kind == EQUITY_ALL_IN){
+        req->answered = equity_run(svc->pool, &req->spot, req->max_trials, req->target_margin, req->seed,
+                                   &req->result) == 0;
+        return;
+    }
+    if(!svc->cache){
+        return;
+    }
+    for(int i = 0; i < MAX_PLAYERS; i++){
+        if(req->spot.hands[i] == CARD_SET_EMPTY){
+            continue;
+        }
+        req->has_outlook[i] = equity_hand_cached(svc->cache, svc->pool, req->spot.hands[i], req->spot.board,
+                                                 req->opponents, req->max_trials, req->target_margin, req->seed,
+                                                 &req->outlooks[i]) == 0;
+        req->answered |= req->has_outlook[i];
+    }
+}
+
+// the request may be freed by done, so it is counted off first
+static void hand_back(equity_service_t *svc, equity_request_t *req) {
+    __atomic_sub_fetch(&svc->pending, 1, __ATOMIC_RELEASE);
+    req->done(req);
+}
+
+static void *service_main(void *arg) {
+    equity_service_t *svc = arg;
+    struct pollfd bell = { svc->bell.fd, POLLIN, 0 };
+    for(;;){
+        int stopping = __atomic_load_n(&svc->stopping, __ATOMIC_ACQUIRE);
+        mpsc_bell_answer(&svc->bell);
+        mpsc_node_t *node;
+        while((node = mpsc_queue_pop(&svc->requests)) != NULL){
+            equity_request_t *req = (equity_request_t *)((char *)node - offsetof(equity_request_t, node));
+            if(!stopping){
+                answer(svc, req);
+            }
+            hand_back(svc, req);
+        }
+        if(stopping){
+            break;
+        }
+        if(poll(&bell, 1, -1) < 0 && errno != EINTR){
+            perror("poll");
+            break;
+        }
+    }
+    return NULL;
+}
+
+int equity_service_init(equity_service_t *svc, equity_pool_t *pool, equity_cache_t *cache) {
+    memset(svc, 0, sizeof(*svc));
+    svc->pool = pool;
+    svc->cache = cache;
+    mpsc_queue_init(&svc->requests);
+    if(mpsc_bell_init(&svc->bell) < 0){
+        return -1;
+    }
+    if(pthread_create(&svc->thread, NULL, service_main, svc) != 0){
+        mpsc_bell_fini(&svc->bell);
+        return -1;
+    }
+    svc->started = 1;
+    return 0;
+}
+
+void equity_service_fini(equity_service_t *svc) {
+    if(!svc->started){
+        return;
+    }
+    __atomic_store_n(&svc->stopping, 1, __ATOMIC_RELEASE);
+    mpsc_bell_ring(&svc->bell);
+    pthread_join(svc->thread, NULL);
+    svc->started = 0;
+    mpsc_bell_fini(&svc->bell);
+}
+
+int equity_service_submit(equity_service_t *svc, equity_request_t *req) {
+    if(__atomic_add_fetch(&svc->pending, 1, __ATOMIC_ACQ_REL) > EQUITY_SERVICE_BACKLOG){
+        __atomic_sub_fetch(&svc->pending, 1, __ATOMIC_RELEASE);
+        return -1;
+    }
+    req->answered = 0;
+    memset(req->has_outlook, 0, sizeof(req->has_outlook));
+    mpsc_queue_push(&svc->requests, &req->node);
+    mpsc_bell_ring(&svc->bell);
+    return 0;
+}
@@ -10,229 +10,103 @@
 #include "poker_client.h"
 #include "client_action_handler.h"
 #include "game_logic.h"
+#include "hand_eval.h"
 
-static inline uint64_t bit(int rank){
-    return 1ULL << rank;
+void print_game_state(game_state_t *game) {
+    (void)game;
 }
 
-static uint64_t value_of_hand(const card_t cards[7]){
-    int rankCnt[13] = {0};
-    uint16_t suitRanks[4] = {0};
-    for(int i = 0; i < 7; i++){
-	    if(cards[i] == NOCARD){
-		    continue;
-	    }
-        int r = RANK(cards[i]);
-        int s = SUITE(cards[i]);
-        rankCnt[r]++;
-        suitRanks[s] |= 1 << r;
-    }
-    
-    int flushSuit = -1;
-    for(int s = 0; s < 4; s++){
-        if(__builtin_popcount(suitRanks[s]) >= 5){
-            flushSuit = s;
-            break;
-        }
-    }
-    
-    int straightHi = -1, sfHi = -1;
-    uint16_t ranksMask = 0;
+void init_deck(card_t deck[DECK_SIZE]) {
+    int i = 0;
     for(int r = 0; r < 13; r++){
-        if(rankCnt[r]){
-            ranksMask |= 1 << r;
-        }
-    }
-    if(ranksMask & bit(12)){
-        ranksMask |= 1;
-    }
-    for(int hi = 12; hi >= 4; hi--){
-	uint16_t straightMask = 0x1F << (hi - 4);
-        if((ranksMask & straightMask) == straightMask){
-            straightHi = hi; break;
-        }
-    }
-    if(flushSuit != -1){
-        uint16_t fm = suitRanks[flushSuit];
-        if(fm & bit(12)){
-            fm |= 1;
-        }
-        for(int hi = 12; hi >= 4; hi--){
-	        uint16_t straightMask = 0x1F << (hi - 4);
-            if((fm & straightMask) == straightMask){
-                sfHi = hi;
-                break;
-            }
+        for(int s = 0; s < 4; s++){
+            deck[i++] = (r << SUITE_BITS) | s;
         }
     }
-    
-    enum { 
-        HICARD = 1, 
-        ONE_PAIR, 
-        TWO_PAIR, 
-        THREE_OF_A_KIND, 
-        STRAIGHT, 
-        FLUSH, 
-        FULL_HOUSE, 
-        FOUR_OF_A_KIND, 
-        STR_FLUSH 
-    };
-    
-    uint64_t best = 0;
-    
-    if(sfHi != -1){
-        return ((uint64_t)STR_FLUSH << 60) | sfHi;
-    }
+}
 
-    int quad = -1, trips[3] = {-1,-1,-1}, tCnt = 0, pairs[3] = {-1,-1,-1}, pCnt = 0;
-    for(int r = 12; r >= 0; r--){
-        if(rankCnt[r] == 4){
-            quad=r;
-        }
-        else if(rankCnt[r] == 3){
-            trips[tCnt++] = r;
-        }
-        else if(rankCnt[r] == 2){
-            pairs[pCnt++] = r;
-        }
-    }
-    if(quad != -1){
-        int hiCard5 = -1;
-        for(int r = 12; r >= 0; r--){
-            if(r != quad && rankCnt[r]){
-                hiCard5 = r;
-                break;
-            }
-        }
-        return ((uint64_t)FOUR_OF_A_KIND << 60) | (quad<<4) | hiCard5;
-    }
-    if(trips[0] != -1 && (pairs[0] != -1 || trips[1] != -1)){
-        int three = trips[0], two = ((trips[1] != -1) ? trips[1] : pairs[0]);
-        return ((uint64_t)FULL_HOUSE << 60) | (three << 4) | two;
-    }
-    if(flushSuit != -1){
-        uint16_t fm = suitRanks[flushSuit];
-        uint64_t val = 0; int cnt = 0;
-        for(int r = 12; r >= 0 && cnt<5; r--){
-            if(fm & bit(r)){
-                val = (val << 4) | r;
-                cnt++;
-            }
-        }
-        return ((uint64_t)FLUSH << 60) | val;
-    }
-    if(straightHi != -1){
-        return ((uint64_t)STRAIGHT << 60) | straightHi;
-    }
-    if(trips[0] != -1){
-        int k1 = -1,k2 = -1;
-        for(int r = 12; r >= 0; r--){
-            if(r != trips[0] && rankCnt[r]){
-                if(k1 == -1){
-                    k1 = r;
-                }
-                else{
-                    k2 = r;
-                    break;
-                }
-            }
-        }
-        return ((uint64_t)THREE_OF_A_KIND << 60) | (trips[0] << 8) | (k1 << 4) | k2;
-    }
-    if(pCnt >= 2){
-        int hi = pairs[0], lo = pairs[1], k = -1;
-        for(int r = 12; r >= 0; r--){
-            if(rankCnt[r] && r != hi && r != lo){
-                k = r;
-                break;
-            }
-        }
-        return ((uint64_t)TWO_PAIR << 60) | (hi << 8) | (lo << 4) | k;
+static int next_random(deck_rng_t *rng) {
+    uint32_t v = (uint32_t)rng->state[rng->front] + (uint32_t)rng->state[rng->rear];
+    rng->state[rng->front] = (int32_t)v;
+    if(++rng->front >= 31){
+        rng->front = 0;
     }
-    if(pCnt == 1){
-        int k1 = -1, k2 = -1, k3 = -1;
-        for(int r = 12; r >= 0; r--){
-            if(rankCnt[r] && r != pairs[0]){
-                if(k1 == -1){
-                    k1 = r;
-                }
-                else if(k2 == -1){
-                    k2 = r;
-                }
-                else{
-                    k3 = r;
-                    break;
-                }
-            }
-        }
-        return ((uint64_t)ONE_PAIR << 60) | (pairs[0] << 12) | (k1 << 8) |(k2 << 4) | k3;
-    }
-    {
-        uint64_t val = 0; int cnt = 0;
-        for(int r = 12; r >= 0 && cnt < 5; r--){
-            if(rankCnt[r]){
-                val = (val << 4) | r;
-                cnt++;
-            }
-        }
-        return ((uint64_t)HICARD << 60) | val;
+    if(++rng->rear >= 31){
+        rng->rear = 0;
     }
+    return (int)(v >> 1);
 }
 
-void print_game_state(game_state_t *game) {
-    (void)game;
-}
-
-void init_deck(card_t deck[DECK_SIZE], int seed) {
-    srand(seed);
-    int i = 0;
-    for(int r = 0; r < 13; r++){
-        for(int s = 0; s < 4; s++){
-            deck[i++] = (r << SUITE_BITS) | s;
-        }
+// same additive feedback generator as glibc's rand(), kept per table so that
+// tables running on different threads don't share (or race on) one global state
+void seed_deck_rng(deck_rng_t *rng, unsigned int seed) {
+    rng->state[0] = seed ? (int32_t)seed : 1;
+    for(int i = 1; i < 31; i++){
+        int32_t hi = rng->state[i - 1] / 127773, lo = rng->state[i - 1] % 127773;
+        int32_t word = 16807 * lo - 2836 * hi;
+        rng->state[i] = word < 0 ? word + 2147483647 : word;
+    }
+    rng->front = 3;
+    rng->rear = 0;
+    for(int i = 0; i < 310; i++){
+        next_random(rng);
     }
 }
 
-void shuffle_deck(card_t deck[DECK_SIZE]) {
+void shuffle_deck(card_t deck[DECK_SIZE], deck_rng_t *rng) {
     for(int i=0; i < DECK_SIZE; i++){
-        int j = rand() % DECK_SIZE;
+        int j = next_random(rng) % DECK_SIZE;
         card_t t = deck[i]; deck[i] = deck[j]; deck[j] = t;
     }
 }
 
 void init_game_state(game_state_t *game, int starting_stack, int random_seed) {
     memset(game,0,sizeof(*game));
-    init_deck(game->deck,random_seed);
+    init_deck(game->deck);
+    seed_deck_rng(&game->rng, random_seed);
     for(int i = 0; i < MAX_PLAYERS; i++){
         game->player_stacks[i] = starting_stack;
     }
     game->dealer_player=0;
     game->current_player=1;
-    game->round_stage=ROUND_INIT;
+    game->round_stage=ROUND_JOIN;
 }
 
 void reset_game_state(game_state_t *game) {
-    shuffle_deck(game->deck);
+    shuffle_deck(game->deck, &game->rng);
 
     game->next_card = 0;
     memset(game->community_cards, NOCARD, sizeof(game->community_cards));
     memset(game->player_hands, NOCARD, sizeof(game->player_hands));
+    memset(game->hand_sets, 0, sizeof(game->hand_sets));
+    game->board_set = CARD_SET_EMPTY;
+    game->board_state = HAND_STATE_EMPTY;
+    game->dealt_set = CARD_SET_EMPTY;
     for(int i = 0; i < MAX_PLAYERS; i++){
         game->current_bets[i] = 0;
     }
     game->highest_bet = 0;
     game->pot_size = 0;
+    int nd = game->dealer_player;
     if(game->round_stage != ROUND_INIT){
-        int nd = (game->dealer_player + 1) % MAX_PLAYERS;
-        while(game->player_status[nd] == PLAYER_LEFT){
-            nd=(nd + 1) % MAX_PLAYERS;
-        }
-        game->dealer_player = nd;
+        nd = (nd + 1) % MAX_PLAYERS;
     }
+    while(game->player_status[nd] == PLAYER_LEFT){
+        nd=(nd + 1) % MAX_PLAYERS;
+    }
+    game->dealer_player = nd;
     game->current_player = -1;
     game->round_stage = ROUND_PREFLOP;
 }
 
+// takes the next card off the deck and marks it dealt
+static card_t draw_card(game_state_t *game) {
+    card_t card = game->deck[game->next_card++];
+    assert(!CARD_SET_HAS(game->dealt_set, card));
+    game->dealt_set |= CARD_SET_BIT(card);
+    return card;
+}
+
 int server_ready(game_state_t *game) {
     int cnt = 0;
     for(int i = 0; i < MAX_PLAYERS; i++){
@@ -246,6 +120,7 @@ int server_ready(game_state_t *game) {
 void server_deal(game_state_t *game) {
     for(int i = 0; i < MAX_PLAYERS; i++){
 	game->current_bets[i] = 0;	
+	game->has_acted[i] = 0;
     }
     game->highest_bet = 0;
 	
@@ -259,98 +134,95 @@ void server_deal(game_state_t *game) {
     game->current_player = first;
     for(int i = 0; i < MAX_PLAYERS; i++){
         if(game->player_status[i] == PLAYER_ACTIVE){
-            game->player_hands[i][0] = game->deck[game->next_card++];
-            game->player_hands[i][1] = game->deck[game->next_card++];
+            game->player_hands[i][0] = draw_card(game);
+            game->player_hands[i][1] = draw_card(game);
+            game->hand_sets[i] = card_set_of(game->player_hands[i], HAND_SIZE);
         }
     }
 }
 
 int check_betting_end(game_state_t *game) {
-    int active = 0, allSame = 1, activeBet = -1;
+    int active = 0, inHand = 0, pending = 0, lastActive = -1;
     for(int i = 0; i < MAX_PLAYERS; i++){
         if(game->player_status[i] == PLAYER_ACTIVE){
             active++;
-            if(activeBet == -1){
-                activeBet = game->current_bets[i];
-            }
-            else if(game->current_bets[i] != activeBet){
-                allSame = 0;
+            inHand++;
+            lastActive = i;
+            if(!game->has_acted[i] || game->current_bets[i] != game->highest_bet){
+                pending++;
             }
         }
         else if(game->player_status[i] == PLAYER_ALLIN){
-		active++;
-	    }
+            inHand++;
+        }
+    }
+    // a lone active player facing only all-ins has nobody left to bet against
+    if(active == 1 && game->current_bets[lastActive] >= game->highest_bet){
+        return 1;
     }
-    return (active <= 1) || (allSame && (activeBet == game->highest_bet || activeBet == -1));
+    return (inHand <= 1) || (pending == 0);
 }
 
 void server_community(game_state_t *game) {
     if(game->round_stage == ROUND_PREFLOP){
         for(int i = 0; i < 3; i++){
-            game->community_cards[i] = game->deck[game->next_card++];
+            game->community_cards[i] = draw_card(game);
         }
         game->round_stage = ROUND_FLOP;
     } 
     else if(game->round_stage == ROUND_FLOP){
-        game->community_cards[3] = game->deck[game->next_card++];
+        game->community_cards[3] = draw_card(game);
         game->round_stage = ROUND_TURN;
     } 
     else if(game->round_stage == ROUND_TURN){
-        game->community_cards[4] = game->deck[game->next_card++];
+        game->community_cards[4] = draw_card(game);
         game->round_stage = ROUND_RIVER;
     }
+    // only the street just dealt is walked; every showdown hand starts from this state
+    card_set_t board = card_set_of(game->community_cards, MAX_COMMUNITY_CARDS);
+    game->board_state = hand_state_add(game->board_state, board & ~game->board_set);
+    game->board_set = board;
     for(int i = 0; i < MAX_PLAYERS; i++){
-        if(game->player_status[i] == PLAYER_ACTIVE){
-            game->current_bets[i]=0;
-        }
+        game->current_bets[i]=0;
+        game->has_acted[i] = 0;
     }
     game->highest_bet = 0;
     int p = (game->dealer_player + 1) % MAX_PLAYERS;
     while(game->player_status[p] != PLAYER_ACTIVE){
         p=(p + 1) % MAX_PLAYERS;
+        if(p == game->dealer_player){
+            break;
+        }
     }
     game->current_player=p;
 }
 
-void server_end(game_state_t *game) {
+// awards the pot to the winner; pot_size is left intact for the END packet
+// and cleared by reset_game_state() at the start of the next hand
+int server_end(game_state_t *game) {
     int won = find_winner(game);
 
     if(won >= 0 && won < MAX_PLAYERS){
 	    game->player_stacks[won] += game->pot_size;
-	    game->pot_size = 0;
     }
+    game->round_stage = ROUND_SHOWDOWN;
+    return won;
 }
 
 int evaluate_hand(game_state_t *game, player_id_t pid) {
-    card_t c[7]= {game->player_hands[pid][0],
-                  game->player_hands[pid][1],
-                  game->community_cards[0],
-                  game->community_cards[1],
-                  game->community_cards[2],
-                  game->community_cards[3],
-                  game->community_cards[4] 
-                };
-    return (int)value_of_hand(c);
+    return (int)hand_state_value(hand_state_add(game->board_state, game->hand_sets[pid]));
 }
 
 int find_winner(game_state_t *game) {
+    // the board is already walked, so each hand still in costs two steps and its flush lookups
     uint64_t bestHand = 0; int bestPlyr = -1;
     for(int i = 0; i < MAX_PLAYERS; i++){
         if(game->player_status[i] == PLAYER_ACTIVE || game->player_status[i] == PLAYER_ALLIN){
-            card_t hand[7] = {game->player_hands[i][0],
-		                    game->player_hands[i][1],
-		                    game->community_cards[0],
-		                    game->community_cards[1],
-		                    game->community_cards[2],
-		                    game->community_cards[3],
-		                    game->community_cards[4]
-	                        };
-		
-	        uint64_t v = value_of_hand(hand);
-	        if(v > bestHand){
-		        bestHand = v;
-		        bestPlyr = i;
-	        }
+            uint64_t value = hand_state_value(hand_state_add(game->board_state, game->hand_sets[i]));
+            if(value > bestHand){
+                bestHand = value;
+                bestPlyr = i;
+            }
         }
     }
     return bestPlyr;
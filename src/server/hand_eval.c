@@ -0,0 +1,230 @@
+// hand_eval.c
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAND_EVAL_X86
+#endif
+
+#include "hand_eval.h"
+
+#define RANKS 13
+#define SUITS 4
+
+// next_state, rank_class, flush_class and class_value, written out at build time by
+// hand_tables_gen.c. a hand is followed through a DAG of rank-count states, one step per card;
+// states are numbered by card count, so the ones that can still take a card come first. suits
+// only matter for flushes, which are looked up separately by the ranks held in one suit. the
+// class tables have one spare entry, as the vector code gathers them 32 bits at a time
+#include "hand_tables.h"
+
+// ---------------------------- evaluation ---------------------------- //
+
+static inline uint16_t hand_class(const card_t *cards, int n) {
+    uint32_t state = 0;
+    uint16_t suits[SUITS] = {0};
+    for(int i = 0; i < n; i++){
+        if(cards[i] == NOCARD){
+            continue;
+        }
+        state = next_state[state][RANK(cards[i])];
+        suits[SUITE(cards[i])] |= 1 << RANK(cards[i]);
+    }
+
+    // quads and full houses outrank a flush, and at most one suit of 7 cards holds one
+    uint16_t cls = rank_class[state];
+    for(int s = 0; s < SUITS; s++){
+        if(flush_class[suits[s]] > cls){
+            cls = flush_class[suits[s]];
+        }
+    }
+    return cls;
+}
+
+static inline uint32_t walk_set(uint32_t state, card_set_t set) {
+    for(; set; set &= set - 1){
+        state = next_state[state][__builtin_ctzll(set) % CARD_SET_LANE];
+    }
+    return state;
+}
+
+// the class of a walked hand; the flush lookups read the suit lanes of its set as they are
+static inline uint16_t state_class(uint32_t state, card_set_t set) {
+    uint16_t cls = rank_class[state];
+    for(int s = 0; s < SUITS; s++){
+        if(flush_class[CARD_SET_SUIT(set, s)] > cls){
+            cls = flush_class[CARD_SET_SUIT(set, s)];
+        }
+    }
+    return cls;
+}
+
+static void batch_scalar(const card_t *cards, int n, uint64_t *values) {
+    for(int i = 0; i < n; i++){
+        card_t hand[HAND_BATCH_CARDS];
+        for(int k = 0; k < HAND_BATCH_CARDS; k++){
+            hand[k] = cards[k * n + i];
+        }
+        values[i] = class_value[hand_class(hand, HAND_BATCH_CARDS)];
+    }
+}
+
+#ifdef HAND_EVAL_X86
+// the same walk for 8 hands at once, one per 32-bit lane: each card is a gather into the DAG,
+// and the suit masks are built with variable shifts
+__attribute__((target("avx2")))
+static void eval_lanes_avx2(const card_t *cards, int stride, uint64_t *values) {
+    const __m256i none = _mm256_set1_epi32(NOCARD);
+    const __m256i three = _mm256_set1_epi32(3);
+    const __m256i one = _mm256_set1_epi32(1);
+    const __m256i ranks = _mm256_set1_epi32(RANKS);
+    const __m256i low16 = _mm256_set1_epi32(0xFFFF);
+    __m256i state = _mm256_setzero_si256();
+    __m256i suits[SUITS];
+    for(int s = 0; s < SUITS; s++){
+        suits[s] = _mm256_setzero_si256();
+    }
+
+    for(int k = 0; k < HAND_BATCH_CARDS; k++){
+        __m256i card = _mm256_loadu_si256((const __m256i *)(cards + k * stride));
+        __m256i held = _mm256_xor_si256(_mm256_cmpeq_epi32(card, none), _mm256_set1_epi32(-1));
+        __m256i rank = _mm256_srai_epi32(card, SUITE_BITS);
+        __m256i suit = _mm256_and_si256(card, three);
+        __m256i index = _mm256_add_epi32(_mm256_mullo_epi32(state, ranks), rank);
+        state = _mm256_mask_i32gather_epi32(state, (const int *)next_state, index, held, 4);
+        __m256i bit = _mm256_and_si256(_mm256_sllv_epi32(one, rank), held);
+        for(int s = 0; s < SUITS; s++){
+            __m256i in_suit = _mm256_cmpeq_epi32(suit, _mm256_set1_epi32(s));
+            suits[s] = _mm256_or_si256(suits[s], _mm256_and_si256(bit, in_suit));
+        }
+    }
+
+    __m256i cls = _mm256_and_si256(_mm256_i32gather_epi32((const int *)rank_class, state, 2), low16);
+    for(int s = 0; s < SUITS; s++){
+        __m256i flush = _mm256_and_si256(_mm256_i32gather_epi32((const int *)flush_class, suits[s], 2), low16);
+        cls = _mm256_max_epu32(cls, flush);
+    }
+    __m256i lo = _mm256_i32gather_epi64((const long long *)class_value, _mm256_castsi256_si128(cls), 8);
+    __m256i hi = _mm256_i32gather_epi64((const long long *)class_value, _mm256_extracti128_si256(cls, 1), 8);
+    _mm256_storeu_si256((__m256i *)values, lo);
+    _mm256_storeu_si256((__m256i *)(values + 4), hi);
+}
+
+__attribute__((target("avx512f")))
+static void eval_lanes_avx512(const card_t *cards, int stride, uint64_t *values) {
+    const __m512i three = _mm512_set1_epi32(3);
+    const __m512i one = _mm512_set1_epi32(1);
+    const __m512i ranks = _mm512_set1_epi32(RANKS);
+    const __m512i low16 = _mm512_set1_epi32(0xFFFF);
+    __m512i state = _mm512_setzero_si512();
+    __m512i suits[SUITS];
+    for(int s = 0; s < SUITS; s++){
+        suits[s] = _mm512_setzero_si512();
+    }
+
+    for(int k = 0; k < HAND_BATCH_CARDS; k++){
+        __m512i card = _mm512_loadu_si512(cards + k * stride);
+        __mmask16 held = _mm512_cmpneq_epi32_mask(card, _mm512_set1_epi32(NOCARD));
+        __m512i rank = _mm512_srai_epi32(card, SUITE_BITS);
+        __m512i suit = _mm512_and_si512(card, three);
+        __m512i index = _mm512_add_epi32(_mm512_mullo_epi32(state, ranks), rank);
+        state = _mm512_mask_i32gather_epi32(state, held, index, next_state, 4);
+        __m512i bit = _mm512_sllv_epi32(one, rank);
+        for(int s = 0; s < SUITS; s++){
+            __mmask16 in_suit = _mm512_mask_cmpeq_epi32_mask(held, suit, _mm512_set1_epi32(s));
+            suits[s] = _mm512_mask_or_epi32(suits[s], in_suit, suits[s], bit);
+        }
+    }
+
+    __m512i cls = _mm512_and_si512(_mm512_i32gather_epi32(state, rank_class, 2), low16);
+    for(int s = 0; s < SUITS; s++){
+        cls = _mm512_max_epu32(cls, _mm512_and_si512(_mm512_i32gather_epi32(suits[s], flush_class, 2), low16));
+    }
+    _mm512_storeu_si512(values, _mm512_i32gather_epi64(_mm512_castsi512_si256(cls), class_value, 8));
+    _mm512_storeu_si512(values + 8, _mm512_i32gather_epi64(_mm512_extracti64x4_epi64(cls, 1), class_value, 8));
+}
+#endif
+
+// runs whole groups of lanes in place; the hands left over are copied into a group padded
+// with empty hands, so even a batch smaller than one group is evaluated in vector code
+static void batch_lanes(const card_t *cards, int n, uint64_t *values, int lanes,
+                        void (*eval_lanes)(const card_t *, int, uint64_t *)) {
+    int i = 0;
+    for(; i + lanes <= n; i += lanes){
+        eval_lanes(cards + i, n, values + i);
+    }
+    if(i == n){
+        return;
+    }
+    card_t tail[HAND_BATCH_CARDS * 16];
+    uint64_t tail_values[16];
+    for(int k = 0; k < HAND_BATCH_CARDS; k++){
+        for(int j = 0; j < lanes; j++){
+            tail[k * lanes + j] = i + j < n ? cards[k * n + i + j] : NOCARD;
+        }
+    }
+    eval_lanes(tail, lanes, tail_values);
+    memcpy(values + i, tail_values, (n - i) * sizeof(uint64_t));
+}
+
+#ifdef HAND_EVAL_X86
+static void batch_avx2(const card_t *cards, int n, uint64_t *values) {
+    batch_lanes(cards, n, values, 8, eval_lanes_avx2);
+}
+
+static void batch_avx512(const card_t *cards, int n, uint64_t *values) {
+    batch_lanes(cards, n, values, 16, eval_lanes_avx512);
+}
+#endif
+
+static void (*batch_impl)(const card_t *, int, uint64_t *) = batch_scalar;
+static pthread_once_t batch_once = PTHREAD_ONCE_INIT;
+
+static void init_once(void) {
+#ifdef HAND_EVAL_X86
+    if(__builtin_cpu_supports("avx512f")){
+        batch_impl = batch_avx512;
+    }
+    else if(__builtin_cpu_supports("avx2")){
+        batch_impl = batch_avx2;
+    }
+#endif
+}
+
+void hand_eval_init(void) {
+    pthread_once(&batch_once, init_once);
+}
+
+uint64_t hand_eval(const card_t *cards, int n) {
+    // the usual sizes get their own copy of the walk, with the card loop unrolled
+    switch(n){
+    case 5:
+        return class_value[hand_class(cards, 5)];
+    case 6:
+        return class_value[hand_class(cards, 6)];
+    case 7:
+        return class_value[hand_class(cards, 7)];
+    default:
+        return class_value[hand_class(cards, n)];
+    }
+}
+
+uint64_t hand_eval_set(card_set_t cards) {
+    return class_value[state_class(walk_set(0, cards), cards)];
+}
+
+hand_state_t hand_state_add(hand_state_t hand, card_set_t cards) {
+    hand.state = walk_set(hand.state, cards);
+    hand.cards |= cards;
+    return hand;
+}
+
+uint64_t hand_state_value(hand_state_t hand) {
+    return class_value[state_class(hand.state, hand.cards)];
+}
+
+void hand_eval_batch(const card_t *cards, int n, uint64_t *values) {
+    hand_eval_init();
+    batch_impl(cards, n, values);
+}
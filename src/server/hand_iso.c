@@ -0,0 +1,268 @@
+// hand_iso.c
+#include <pthread.h>
+
+#include "hand_iso.h"
+#include "game_logic.h"
+
+#define RANKS 13
+#define SUITS 4
+
+// a suit's shape is how many hole cards and how many board cards it holds, as h * SHAPE_BOARD + b
+#define SHAPE_BOARD 8
+#define SHAPE_BITS 6
+
+// four shapes in descending order fit in a key; there are a few dozen per board size
+#define MAX_CONFIGS 256
+
+/**
+ * the shapes of the four suits, in descending order, and where their block of indices starts
+ */
+typedef struct {
+    uint32_t key;       // the four shapes, SHAPE_BITS each, the largest on top
+    uint64_t offset;
+} config_t;
+
+static config_t configs[MAX_COMMUNITY_CARDS + 1][MAX_CONFIGS];
+static int num_configs[MAX_COMMUNITY_CARDS + 1];
+static uint64_t sizes[MAX_COMMUNITY_CARDS + 1];
+static pthread_once_t configs_once = PTHREAD_ONCE_INIT;
+
+static uint64_t choose(int n, int k) {
+    if(k < 0 || k > n){
+        return 0;
+    }
+    uint64_t c = 1;
+    for(int i = 1; i <= k; i++){
+        c = c * (n - k + i) / i;
+    }
+    return c;
+}
+
+// the numbers a suit of the shape can take: its hole ranks, then its board ranks from the rest
+static uint64_t shape_size(int shape) {
+    int h = shape / SHAPE_BOARD, b = shape % SHAPE_BOARD;
+    return choose(RANKS, h) * choose(RANKS - h, b);
+}
+
+// a multiset of m numbers below n
+static uint64_t group_size(int shape, int m) {
+    return choose((int)shape_size(shape) + m - 1, m);
+}
+
+static int shape_at(uint32_t key, int i) {
+    return (key >> (SHAPE_BITS * (SUITS - 1 - i))) & ((1 << SHAPE_BITS) - 1);
+}
+
+// the indices of a configuration: one multiset per run of equal shapes
+static uint64_t config_size(uint32_t key) {
+    uint64_t size = 1;
+    for(int i = 0, j; i < SUITS; i = j){
+        for(j = i + 1; j < SUITS && shape_at(key, j) == shape_at(key, i); j++);
+        size *= group_size(shape_at(key, i), j - i);
+    }
+    return size;
+}
+
+// every way to spread two hole cards and b board cards over the suits, with the shapes in
+// descending order, so the keys come out in descending order too
+static void build_configs(void) {
+    for(int b = 0; b <= MAX_COMMUNITY_CARDS; b++){
+        uint64_t offset = 0;
+        int top = HAND_SIZE * SHAPE_BOARD + b;
+        for(int s0 = top; s0 >= 0; s0--)
+        for(int s1 = s0; s1 >= 0; s1--)
+        for(int s2 = s1; s2 >= 0; s2--)
+        for(int s3 = s2; s3 >= 0; s3--){
+            int shapes[SUITS] = {s0, s1, s2, s3};
+            int holes = 0, boards = 0, fits = 1;
+            uint32_t key = 0;
+            for(int i = 0; i < SUITS; i++){
+                int h = shapes[i] / SHAPE_BOARD, c = shapes[i] % SHAPE_BOARD;
+                fits &= h <= HAND_SIZE && c <= b && h + c <= RANKS;
+                holes += h;
+                boards += c;
+                key = (key << SHAPE_BITS) | shapes[i];
+            }
+            if(!fits || holes != HAND_SIZE || boards != b){
+                continue;
+            }
+            configs[b][num_configs[b]++] = (config_t){key, offset};
+            offset += config_size(key);
+        }
+        sizes[b] = offset;
+    }
+}
+
+static void ensure_configs(void) {
+    pthread_once(&configs_once, build_configs);
+}
+
+// the colex rank of a set of ranks among the sets of its size
+static uint64_t colex_rank(uint32_t ranks) {
+    uint64_t rank = 0;
+    for(int i = 1; ranks; i++, ranks &= ranks - 1){
+        rank += choose(__builtin_ctz(ranks), i);
+    }
+    return rank;
+}
+
+static uint32_t colex_unrank(uint64_t rank, int k) {
+    uint32_t ranks = 0;
+    for(int i = k, top = RANKS - 1; i > 0; i--){
+        while(choose(top, i) > rank){
+            top--;
+        }
+        ranks |= 1u << top;
+        rank -= choose(top, i);
+        top--;
+    }
+    return ranks;
+}
+
+// the board ranks renumbered over the ranks the hole cards leave free
+static uint32_t squeeze(uint32_t board, uint32_t hole) {
+    uint32_t out = 0;
+    for(; board; board &= board - 1){
+        int r = __builtin_ctz(board);
+        out |= 1u << (r - __builtin_popcount(hole & ((1u << r) - 1)));
+    }
+    return out;
+}
+
+static uint32_t unsqueeze(uint32_t board, uint32_t hole) {
+    uint32_t out = 0;
+    for(int r = 0, free = 0; r < RANKS; r++){
+        if(hole & (1u << r)){
+            continue;
+        }
+        if(board & (1u << free)){
+            out |= 1u << r;
+        }
+        free++;
+    }
+    return out;
+}
+
+// numbers in descending order, as the colex rank of the strictly descending n[k] + (m - 1 - k)
+static uint64_t group_rank(const uint64_t *numbers, int m) {
+    uint64_t rank = 0;
+    for(int k = 0; k < m; k++){
+        rank += choose((int)numbers[k] + m - 1 - k, m - k);
+    }
+    return rank;
+}
+
+static void group_unrank(uint64_t rank, int shape, int m, uint64_t *numbers) {
+    for(int k = 0; k < m; k++){
+        int t = m - k;
+        // the largest j with C(j, t) <= rank
+        int lo = t - 1, hi = (int)shape_size(shape) + m - 1;
+        while(lo < hi){
+            int mid = lo + (hi - lo + 1) / 2;
+            if(choose(mid, t) <= rank){
+                lo = mid;
+            }
+            else{
+                hi = mid - 1;
+            }
+        }
+        rank -= choose(lo, t);
+        numbers[k] = lo - (t - 1);
+    }
+}
+
+uint64_t hand_iso_size(int board_cards) {
+    if(board_cards < 0 || board_cards > MAX_COMMUNITY_CARDS){
+        return 0;
+    }
+    ensure_configs();
+    return sizes[board_cards];
+}
+
+uint64_t hand_iso_index(card_set_t hand, card_set_t board) {
+    ensure_configs();
+    int b = card_set_count(board);
+
+    // each suit as (shape, number), sorted descending
+    uint64_t suits[SUITS];
+    for(int s = 0; s < SUITS; s++){
+        uint32_t hole = CARD_SET_SUIT(hand, s), shared = CARD_SET_SUIT(board, s);
+        int h = __builtin_popcount(hole);
+        uint64_t number = colex_rank(hole) + choose(RANKS, h) * colex_rank(squeeze(shared, hole));
+        uint64_t shape = h * SHAPE_BOARD + __builtin_popcount(shared);
+        uint64_t v = shape << 32 | number;
+        int i = s;
+        for(; i > 0 && suits[i - 1] < v; i--){
+            suits[i] = suits[i - 1];
+        }
+        suits[i] = v;
+    }
+
+    uint32_t key = 0;
+    for(int s = 0; s < SUITS; s++){
+        key = (key << SHAPE_BITS) | (uint32_t)(suits[s] >> 32);
+    }
+    // the keys are in descending order
+    int lo = 0, hi = num_configs[b] - 1;
+    while(lo < hi){
+        int mid = (lo + hi) / 2;
+        if(configs[b][mid].key > key){
+            lo = mid + 1;
+        }
+        else{
+            hi = mid;
+        }
+    }
+
+    uint64_t index = 0;
+    for(int i = 0, j; i < SUITS; i = j){
+        uint64_t numbers[SUITS];
+        for(j = i; j < SUITS && shape_at(key, j) == shape_at(key, i); j++){
+            numbers[j - i] = suits[j] & 0xFFFFFFFF;
+        }
+        index = index * group_size(shape_at(key, i), j - i) + group_rank(numbers, j - i);
+    }
+    return configs[b][lo].offset + index;
+}
+
+void hand_iso_unindex(int board_cards, uint64_t index, card_set_t *hand, card_set_t *board) {
+    ensure_configs();
+    const config_t *list = configs[board_cards];
+    int lo = 0, hi = num_configs[board_cards] - 1;
+    while(lo < hi){
+        int mid = lo + (hi - lo + 1) / 2;
+        if(list[mid].offset <= index){
+            lo = mid;
+        }
+        else{
+            hi = mid - 1;
+        }
+    }
+    uint32_t key = list[lo].key;
+    index -= list[lo].offset;
+
+    // the groups were folded in first to last, so they come back out last to first
+    int starts[SUITS + 1], groups = 0;
+    for(int i = 0; i < SUITS; groups++){
+        starts[groups] = i;
+        for(i++; i < SUITS && shape_at(key, i) == shape_at(key, starts[groups]); i++);
+    }
+    starts[groups] = SUITS;
+    uint64_t numbers[SUITS];
+    for(int g = groups - 1; g >= 0; g--){
+        int shape = shape_at(key, starts[g]), m = starts[g + 1] - starts[g];
+        uint64_t size = group_size(shape, m);
+        group_unrank(index % size, shape, m, numbers + starts[g]);
+        index /= size;
+    }
+
+    *hand = *board = CARD_SET_EMPTY;
+    for(int s = 0; s < SUITS; s++){
+        int shape = shape_at(key, s), h = shape / SHAPE_BOARD, b = shape % SHAPE_BOARD;
+        uint64_t per_hole = choose(RANKS, h);
+        uint32_t hole = colex_unrank(numbers[s] % per_hole, h);
+        uint32_t shared = unsqueeze(colex_unrank(numbers[s] / per_hole, b), hole);
+        *hand |= (card_set_t)hole << (CARD_SET_LANE * s);
+        *board |= (card_set_t)shared << (CARD_SET_LANE * s);
+    }
+}
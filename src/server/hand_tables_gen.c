@@ -0,0 +1,358 @@
+// hand_tables_gen.c
+/**
+ * usage: hand_tables_gen > hand_tables.h
+ *
+ * builds the lookup tables behind hand_eval() from the straightforward scan over the cards
+ * and prints them as const C arrays. the makefile runs it before compiling hand_eval.c, so the
+ * tables sit in the server's read-only data instead of being built when it starts
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+
+#include "hand_eval.h"
+
+#define RANKS 13
+#define SUITS 4
+#define MAX_CARDS 7
+
+// every way to hold up to MAX_CARDS cards by rank alone (at most four of each), and the
+// ones among them that can still take a card
+#define RANK_STATES 76155
+#define OPEN_STATES 26950
+
+// values a hand can take, ranked: more than enough for every 0 to 7 card hand
+#define MAX_CLASSES 16384
+
+static inline uint64_t bit(int rank){
+    return 1ULL << rank;
+}
+
+// a hand of fewer than five cards runs out of kickers; the missing ones count as 0 instead of
+// spilling a -1 over the whole value
+static uint64_t kicker(int rank){
+    return rank < 0 ? 0 : (uint64_t)rank;
+}
+
+// the straightforward scan over the cards; it defines the encoding, and the tables are built from it
+static uint64_t scan_value(const card_t cards[7]){
+    int rankCnt[13] = {0};
+    uint16_t suitRanks[4] = {0};
+    for(int i = 0; i < 7; i++){
+	    if(cards[i] == NOCARD){
+		    continue;
+	    }
+        int r = RANK(cards[i]);
+        int s = SUITE(cards[i]);
+        rankCnt[r]++;
+        suitRanks[s] |= 1 << r;
+    }
+    
+    int flushSuit = -1;
+    for(int s = 0; s < 4; s++){
+        if(__builtin_popcount(suitRanks[s]) >= 5){
+            flushSuit = s;
+            break;
+        }
+    }
+    
+    int straightHi = -1, sfHi = -1;
+    uint16_t ranksMask = 0;
+    for(int r = 0; r < 13; r++){
+        if(rankCnt[r]){
+            ranksMask |= 1 << r;
+        }
+    }
+    if(ranksMask & bit(12)){
+        ranksMask |= 1;
+    }
+    for(int hi = 12; hi >= 4; hi--){
+	uint16_t straightMask = 0x1F << (hi - 4);
+        if((ranksMask & straightMask) == straightMask){
+            straightHi = hi; break;
+        }
+    }
+    if(flushSuit != -1){
+        uint16_t fm = suitRanks[flushSuit];
+        if(fm & bit(12)){
+            fm |= 1;
+        }
+        for(int hi = 12; hi >= 4; hi--){
+	        uint16_t straightMask = 0x1F << (hi - 4);
+            if((fm & straightMask) == straightMask){
+                sfHi = hi;
+                break;
+            }
+        }
+    }
+
+    if(sfHi != -1){
+        return ((uint64_t)HAND_STRAIGHT_FLUSH << 60) | sfHi;
+    }
+
+    int quad = -1, trips[3] = {-1,-1,-1}, tCnt = 0, pairs[3] = {-1,-1,-1}, pCnt = 0;
+    for(int r = 12; r >= 0; r--){
+        if(rankCnt[r] == 4){
+            quad=r;
+        }
+        else if(rankCnt[r] == 3){
+            trips[tCnt++] = r;
+        }
+        else if(rankCnt[r] == 2){
+            pairs[pCnt++] = r;
+        }
+    }
+    if(quad != -1){
+        int hiCard5 = -1;
+        for(int r = 12; r >= 0; r--){
+            if(r != quad && rankCnt[r]){
+                hiCard5 = r;
+                break;
+            }
+        }
+        return ((uint64_t)HAND_FOUR_OF_A_KIND << 60) | (quad<<4) | kicker(hiCard5);
+    }
+    if(trips[0] != -1 && (pairs[0] != -1 || trips[1] != -1)){
+        int three = trips[0], two = ((trips[1] != -1) ? trips[1] : pairs[0]);
+        return ((uint64_t)HAND_FULL_HOUSE << 60) | (three << 4) | two;
+    }
+    if(flushSuit != -1){
+        uint16_t fm = suitRanks[flushSuit];
+        uint64_t val = 0; int cnt = 0;
+        for(int r = 12; r >= 0 && cnt<5; r--){
+            if(fm & bit(r)){
+                val = (val << 4) | r;
+                cnt++;
+            }
+        }
+        return ((uint64_t)HAND_FLUSH << 60) | val;
+    }
+    if(straightHi != -1){
+        return ((uint64_t)HAND_STRAIGHT << 60) | straightHi;
+    }
+    if(trips[0] != -1){
+        int k1 = -1,k2 = -1;
+        for(int r = 12; r >= 0; r--){
+            if(r != trips[0] && rankCnt[r]){
+                if(k1 == -1){
+                    k1 = r;
+                }
+                else{
+                    k2 = r;
+                    break;
+                }
+            }
+        }
+        return ((uint64_t)HAND_THREE_OF_A_KIND << 60) | (trips[0] << 8) | (kicker(k1) << 4) | kicker(k2);
+    }
+    if(pCnt >= 2){
+        int hi = pairs[0], lo = pairs[1], k = -1;
+        for(int r = 12; r >= 0; r--){
+            if(rankCnt[r] && r != hi && r != lo){
+                k = r;
+                break;
+            }
+        }
+        return ((uint64_t)HAND_TWO_PAIR << 60) | (hi << 8) | (lo << 4) | kicker(k);
+    }
+    if(pCnt == 1){
+        int k1 = -1, k2 = -1, k3 = -1;
+        for(int r = 12; r >= 0; r--){
+            if(rankCnt[r] && r != pairs[0]){
+                if(k1 == -1){
+                    k1 = r;
+                }
+                else if(k2 == -1){
+                    k2 = r;
+                }
+                else{
+                    k3 = r;
+                    break;
+                }
+            }
+        }
+        return ((uint64_t)HAND_ONE_PAIR << 60) | (pairs[0] << 12) | (kicker(k1) << 8) | (kicker(k2) << 4) | kicker(k3);
+    }
+    {
+        uint64_t val = 0; int cnt = 0;
+        for(int r = 12; r >= 0 && cnt < 5; r--){
+            if(rankCnt[r]){
+                val = (val << 4) | r;
+                cnt++;
+            }
+        }
+        return ((uint64_t)HAND_HIGH_CARD << 60) | val;
+    }
+}
+
+// a hand is followed through a DAG of rank-count states, one step per card; states are
+// numbered by card count, so the ones that can still take a card come first. suits only
+// matter for flushes, which are looked up separately by the ranks held in one suit
+static uint32_t next_state[OPEN_STATES][RANKS];
+// the class tables get one spare entry: hand_eval.c's vector code gathers them 32 bits at a time
+static uint16_t rank_class[RANK_STATES + 1];    // the value of the ranks, flushes aside
+static uint16_t flush_class[(1 << RANKS) + 1];  // the flush made by these ranks of a suit, 0 if none
+static uint64_t class_value[MAX_CLASSES];       // every value, in increasing order
+static int class_count;
+
+// a state's key orders states by card count first, then by the counts as a base 5 number
+static uint64_t state_key(int cards, uint32_t counts) {
+    return ((uint64_t)cards << 32) | counts;
+}
+
+static uint32_t pow5(int rank) {
+    uint32_t p = 1;
+    for(int r = 0; r < rank; r++){
+        p *= 5;
+    }
+    return p;
+}
+
+static void collect_states(uint64_t *keys, int *n, int rank, int cards, uint32_t counts) {
+    if(rank == RANKS){
+        keys[(*n)++] = state_key(cards, counts);
+        return;
+    }
+    for(int c = 0; c <= 4 && cards + c <= MAX_CARDS; c++){
+        collect_states(keys, n, rank + 1, cards + c, counts + c * pow5(rank));
+    }
+}
+
+static int cmp_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static int find_u64(const uint64_t *sorted, int n, uint64_t key) {
+    const uint64_t *hit = bsearch(&key, sorted, n, sizeof(uint64_t), cmp_u64);
+    return hit ? (int)(hit - sorted) : -1;
+}
+
+// cards with the ranks of a state, suited so that no suit holds a flush
+static void state_cards(uint32_t counts, card_t cards[MAX_CARDS]) {
+    int n = 0;
+    for(int r = 0; r < RANKS; r++, counts /= 5){
+        for(int c = 0; c < (int)(counts % 5); c++, n++){
+            cards[n] = (r << SUITE_BITS) | (n % SUITS);
+        }
+    }
+    while(n < MAX_CARDS){
+        cards[n++] = NOCARD;
+    }
+}
+
+static void suited_cards(int mask, card_t cards[MAX_CARDS]) {
+    int n = 0;
+    for(int r = 0; r < RANKS; r++){
+        if(mask & (1 << r)){
+            cards[n++] = (r << SUITE_BITS) | SPADE;
+        }
+    }
+    while(n < MAX_CARDS){
+        cards[n++] = NOCARD;
+    }
+}
+
+static uint16_t class_of(uint64_t value) {
+    return (uint16_t)find_u64(class_value, class_count, value);
+}
+
+static void build_tables(void) {
+    static uint64_t keys[RANK_STATES];
+    static uint64_t state_value[RANK_STATES];
+    static uint64_t flush_value[1 << RANKS];
+    static uint64_t values[1 + RANK_STATES + (1 << RANKS)];
+    card_t cards[MAX_CARDS];
+
+    int n = 0;
+    collect_states(keys, &n, 0, 0, 0);
+    qsort(keys, n, sizeof(uint64_t), cmp_u64);
+
+    // value 0 is the class of "no flush", below every hand
+    int count = 0;
+    values[count++] = 0;
+    for(int s = 0; s < RANK_STATES; s++){
+        state_cards((uint32_t)keys[s], cards);
+        state_value[s] = scan_value(cards);
+        values[count++] = state_value[s];
+    }
+    for(int mask = 0; mask < (1 << RANKS); mask++){
+        flush_value[mask] = 0;
+        if(__builtin_popcount(mask) >= 5 && __builtin_popcount(mask) <= MAX_CARDS){
+            suited_cards(mask, cards);
+            flush_value[mask] = scan_value(cards);
+            values[count++] = flush_value[mask];
+        }
+    }
+    qsort(values, count, sizeof(uint64_t), cmp_u64);
+    class_count = 0;
+    for(int c = 0; c < count && class_count < MAX_CLASSES; c++){
+        if(class_count == 0 || values[c] != class_value[class_count - 1]){
+            class_value[class_count++] = values[c];
+        }
+    }
+
+    for(int s = 0; s < RANK_STATES; s++){
+        rank_class[s] = class_of(state_value[s]);
+    }
+    for(int mask = 0; mask < (1 << RANKS); mask++){
+        flush_class[mask] = class_of(flush_value[mask]);
+    }
+    for(int s = 0; s < OPEN_STATES; s++){
+        int held = (int)(keys[s] >> 32);
+        uint32_t counts = (uint32_t)keys[s];
+        for(int r = 0; r < RANKS; r++){
+            // a fifth card of a rank cannot be dealt; it is left pointing at the empty hand
+            int next = (counts / pow5(r)) % 5 < 4 ? find_u64(keys, n, state_key(held + 1, counts + pow5(r))) : 0;
+            next_state[s][r] = (uint32_t)next;
+        }
+    }
+}
+
+// ---------------------------- output ---------------------------- //
+
+static void print_row(const char *fmt, const void *row, int size, int n) {
+    for(int i = 0; i < n; i++){
+        uint64_t v = size == 8 ? ((const uint64_t *)row)[i]
+                   : size == 4 ? ((const uint32_t *)row)[i]
+                   : ((const uint16_t *)row)[i];
+        printf(i ? ", " : "    ");
+        printf(fmt, v);
+    }
+    printf(",\n");
+}
+
+// a flat table, a few entries to a line
+static void print_table(const char *decl, const char *fmt, const void *table, int size, int n, int per_line) {
+    printf("\n%s = {\n", decl);
+    for(int i = 0; i < n; i += per_line){
+        print_row(fmt, (const char *)table + (size_t)i * size, size, n - i < per_line ? n - i : per_line);
+    }
+    printf("};\n");
+}
+
+int main(void) {
+    build_tables();
+
+    printf("// generated by hand_tables_gen.c; do not edit\n\n");
+    printf("#define RANK_STATES %d\n", RANK_STATES);
+    printf("#define OPEN_STATES %d\n", OPEN_STATES);
+    printf("#define HAND_CLASSES %d\n", class_count);
+
+    // one state to a line, so each row is the 13 ranks a card can add
+    printf("\nstatic const uint32_t next_state[OPEN_STATES][RANKS] = {\n");
+    for(int s = 0; s < OPEN_STATES; s++){
+        printf("    {");
+        for(int r = 0; r < RANKS; r++){
+            printf(r ? ", %u" : "%u", next_state[s][r]);
+        }
+        printf("},\n");
+    }
+    printf("};\n");
+    print_table("static const uint16_t rank_class[RANK_STATES + 1]", "%" PRIu64, rank_class, 2, RANK_STATES + 1, 16);
+    print_table("static const uint16_t flush_class[(1 << RANKS) + 1]", "%" PRIu64, flush_class, 2, (1 << RANKS) + 1, 16);
+    print_table("static const uint64_t class_value[HAND_CLASSES]", "0x%016" PRIx64 "ull", class_value, 8, class_count, 4);
+    return 0;
+}
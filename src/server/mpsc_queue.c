@@ -0,0 +1,86 @@
+// mpsc_queue.c
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/eventfd.h>
+
+#include "mpsc_queue.h"
+
+void mpsc_queue_init(mpsc_queue_t *q) {
+    q->stub.next = NULL;
+    q->newest = &q->stub;
+    q->oldest = &q->stub;
+}
+
+void mpsc_queue_push(mpsc_queue_t *q, mpsc_node_t *node) {
+    __atomic_store_n(&node->next, NULL, __ATOMIC_RELAXED);
+    mpsc_node_t *prev = __atomic_exchange_n(&q->newest, node, __ATOMIC_ACQ_REL);
+    // until this store lands the consumer cannot reach node, or anything pushed after it
+    __atomic_store_n(&prev->next, node, __ATOMIC_RELEASE);
+}
+
+mpsc_node_t *mpsc_queue_pop(mpsc_queue_t *q) {
+    mpsc_node_t *oldest = q->oldest;
+    mpsc_node_t *next = __atomic_load_n(&oldest->next, __ATOMIC_ACQUIRE);
+
+    // the stub is skipped over; it only stands in for an empty queue
+    if(oldest == &q->stub){
+        if(!next){
+            return NULL;
+        }
+        q->oldest = next;
+        oldest = next;
+        next = __atomic_load_n(&oldest->next, __ATOMIC_ACQUIRE);
+    }
+    if(next){
+        q->oldest = next;
+        return oldest;
+    }
+
+    // oldest is the last node that was linked: it can only be handed out once something is
+    // behind it, so the stub is pushed back unless a producer is already past its exchange
+    if(oldest != __atomic_load_n(&q->newest, __ATOMIC_ACQUIRE)){
+        return NULL;
+    }
+    mpsc_queue_push(q, &q->stub);
+    next = __atomic_load_n(&oldest->next, __ATOMIC_ACQUIRE);
+    if(next){
+        q->oldest = next;
+        return oldest;
+    }
+    return NULL;
+}
+
+int mpsc_bell_init(mpsc_bell_t *bell) {
+    bell->raised = 0;
+    bell->fd = eventfd(0, EFD_NONBLOCK);
+    return bell->fd < 0 ? -1 : 0;
+}
+
+void mpsc_bell_ring(mpsc_bell_t *bell) {
+    if(__atomic_exchange_n(&bell->raised, 1, __ATOMIC_SEQ_CST)){
+        return;
+    }
+    uint64_t one = 1;
+    if(write(bell->fd, &one, sizeof(one)) < 0){
+        perror("write");
+    }
+}
+
+// a push the consumer might miss rang after the flag was cleared, so it wakes it again
+void mpsc_bell_answer(mpsc_bell_t *bell) {
+    uint64_t count;
+    if(read(bell->fd, &count, sizeof(count)) < 0 && errno != EAGAIN){
+        perror("read");
+    }
+    __atomic_store_n(&bell->raised, 0, __ATOMIC_SEQ_CST);
+}
+
+void mpsc_bell_fini(mpsc_bell_t *bell) {
+    if(bell->fd >= 0){
+        close(bell->fd);
+    }
+    bell->fd = -1;
+}
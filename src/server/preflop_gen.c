@@ -0,0 +1,181 @@
+// preflop_gen.c
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "preflop_table.h"
+#include "hand_eval.h"
+#include "card_set.h"
+#include "rng.h"
+#include "game_logic.h"
+
+/**
+ * usage: preflop_gen OUT_FILE [trials] [threads]
+ *
+ * OUT_FILE - where to write the table; `make preflop_table` writes PREFLOP_TABLE_PATH
+ * trials   - random deals behind every entry, defaults to 20000 (about +/-0.006 at 95%)
+ * threads  - threads to spread the entries over, defaults to one per online core
+ *
+ * a heads-up entry deals a random hand of each class, dealing both again if they share a
+ * card, and then a random board from the rest of the deck. a field entry deals a random hand
+ * of the class and random hands for everyone else. the table is written to OUT_FILE.tmp and
+ * renamed over OUT_FILE, so a process that still maps the old table keeps reading it as it was
+ */
+
+#define BOARD_CARDS 5
+
+// each row of heads_up, then each class of field
+#define WORK_ITEMS (2 * PREFLOP_CLASSES)
+
+static preflop_file_t table;
+static uint64_t trials = 20000;
+static int next_item = 0;
+
+// a random hand of a class: suited hands share a suit, pairs and offsuit hands never do
+static card_set_t deal_class(int cls, uint64_t *rng) {
+    int a = cls / 13, b = cls % 13;
+    int s1 = rng_below(rng, 4), s2 = s1;
+    if(a <= b){
+        s2 = rng_below(rng, 3);
+        if(s2 >= s1){
+            s2++;
+        }
+    }
+    return CARD_SET_BIT((a << SUITE_BITS) | s1) | CARD_SET_BIT((b << SUITE_BITS) | s2);
+}
+
+// n random cards from live
+static card_set_t deal_from(card_set_t live, int n, uint64_t *rng) {
+    card_set_t dealt = CARD_SET_EMPTY;
+    int left = card_set_count(live);
+    for(int k = 0; k < n; k++, left--){
+        card_set_t card = card_set_bit(card_set_nth(live, rng_below(rng, left)));
+        live &= ~card;
+        dealt |= card;
+    }
+    return dealt;
+}
+
+// hero's share of the pot against the other hands on a board
+static double showdown(card_set_t board, card_set_t hero, const card_set_t *others, int n) {
+    hand_state_t walked = hand_state_add(HAND_STATE_EMPTY, board);
+    uint64_t mine = hand_state_value(hand_state_add(walked, hero));
+    int tied = 1;
+    for(int i = 0; i < n; i++){
+        uint64_t theirs = hand_state_value(hand_state_add(walked, others[i]));
+        if(theirs > mine){
+            return 0;
+        }
+        tied += theirs == mine;
+    }
+    return 1.0 / tied;
+}
+
+static double heads_up(int hero, int villain, uint64_t *rng) {
+    double share = 0;
+    for(uint64_t t = 0; t < trials; t++){
+        card_set_t h, v;
+        do{
+            h = deal_class(hero, rng);
+            v = deal_class(villain, rng);
+        } while(h & v);
+        card_set_t board = deal_from(CARD_SET_DECK & ~(h | v), BOARD_CARDS, rng);
+        share += showdown(board, h, &v, 1);
+    }
+    return share / trials;
+}
+
+static double vs_field(int hero, int players, uint64_t *rng) {
+    double share = 0;
+    card_set_t others[MAX_PLAYERS];
+    for(uint64_t t = 0; t < trials; t++){
+        card_set_t h = deal_class(hero, rng);
+        card_set_t live = CARD_SET_DECK & ~h;
+        for(int i = 0; i < players - 1; i++){
+            others[i] = deal_from(live, HAND_SIZE, rng);
+            live &= ~others[i];
+        }
+        share += showdown(deal_from(live, BOARD_CARDS, rng), h, others, players - 1);
+    }
+    return share / trials;
+}
+
+static void *generate(void *arg) {
+    (void)arg;
+    int item;
+    while((item = __atomic_fetch_add(&next_item, 1, __ATOMIC_RELAXED)) < WORK_ITEMS){
+        // seeded by the work item, so the table does not depend on the thread count
+        uint64_t rng = (uint64_t)item * 0xD1B54A32D192ED03ull;
+        if(item < PREFLOP_CLASSES){
+            // the two sides of a matchup add up to the whole pot, so each pair is dealt once
+            int hero = item;
+            table.heads_up[hero][hero] = 0.5f;
+            for(int villain = hero + 1; villain < PREFLOP_CLASSES; villain++){
+                double equity = heads_up(hero, villain, &rng);
+                table.heads_up[hero][villain] = (float)equity;
+                table.heads_up[villain][hero] = (float)(1 - equity);
+            }
+        }
+        else{
+            int hero = item - PREFLOP_CLASSES;
+            for(int players = 2; players <= MAX_PLAYERS; players++){
+                table.field[players][hero] = (float)vs_field(hero, players, &rng);
+            }
+        }
+    }
+    return NULL;
+}
+
+int main(int argc, char **argv) {
+    if(argc < 2){
+        fprintf(stderr, "usage: %s OUT_FILE [trials] [threads]\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    const char *path = argv[1];
+    if(argc >= 3 && atoll(argv[2]) > 0){
+        trials = (uint64_t)atoll(argv[2]);
+    }
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    int num_threads = argc >= 4 ? atoi(argv[3]) : (cores > 0 ? (int)cores : 1);
+    if(num_threads < 1){
+        num_threads = 1;
+    }
+
+    pthread_t *threads = calloc(num_threads, sizeof(pthread_t));
+    for(int i = 0; i < num_threads; i++){
+        if(pthread_create(&threads[i], NULL, generate, NULL) != 0){
+            perror("pthread_create");
+            exit(EXIT_FAILURE);
+        }
+    }
+    for(int i = 0; i < num_threads; i++){
+        pthread_join(threads[i], NULL);
+    }
+    free(threads);
+
+    table.header = (preflop_header_t){
+        .magic = PREFLOP_MAGIC,
+        .version = PREFLOP_VERSION,
+        .classes = PREFLOP_CLASSES,
+        .max_players = MAX_PLAYERS,
+        .trials = trials,
+    };
+    table.header.checksum = preflop_checksum(&table);
+
+    char tmp[4096];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    FILE *out = fopen(tmp, "wb");
+    if(out == NULL || fwrite(&table, sizeof(table), 1, out) != 1 || fclose(out) != 0){
+        perror(tmp);
+        exit(EXIT_FAILURE);
+    }
+    if(rename(tmp, path) < 0){
+        perror(path);
+        exit(EXIT_FAILURE);
+    }
+    printf("[preflop_gen] wrote %s: %d classes, %llu deals per entry\n", path, PREFLOP_CLASSES,
+           (unsigned long long)trials);
+    return 0;
+}
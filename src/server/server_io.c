@@ -0,0 +1,446 @@
+// server_io.c
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+
+#include "server_io.h"
+#include "wire.h"
+#include "transport.h"
+
+#ifdef POKER_IO_URING
+
+#define SEND_SLOT_SIZE (2 * WIRE_MAX_FRAME)     // a reply plus a broadcast
+#define SEND_SLOTS 256
+
+/**
+ * one write queued on the ring. the head of a connection's queue is the one in flight,
+ * the rest wait behind it so the connection sees its frames in order
+ */
+typedef struct send_req {
+    struct send_req *next;
+    int fd;
+    int closed;                             // the connection was closed while this was in flight
+    int fixed;                              // buf lies in the registered slab
+    size_t len;
+    size_t off;                             // bytes already written
+    uint8_t *buf;
+} send_req_t;
+
+typedef struct {
+    uring_t *ring;
+    uint8_t *slab;                          // SEND_SLOTS registered buffers of SEND_SLOT_SIZE
+    send_req_t slots[SEND_SLOTS];
+    send_req_t *free_slots;
+} io_state_t;
+
+static __thread io_state_t *io = NULL;
+
+#endif
+
+/**
+ * what the thread keeps for one connection it owns
+ */
+typedef struct {
+    uint64_t tag;                           // what the network thread knows the connection by
+    int epoll_fd;                           // epoll set the connection is read through, -1 if none
+    size_t queued;                          // bytes taken by server_io_send() and not yet written
+    int congested;                          // passed the high watermark, not yet back to the low one
+    uint8_t *pending;                       // SERVER_IO_QUEUE_LIMIT bytes waiting for EPOLLOUT, as a ring
+    size_t start;                           // offset of the oldest pending byte
+    shm_ring_t *shm_out;                    // frames go here instead of the socket, NULL if none
+#ifdef POKER_IO_URING
+    send_req_t *head, *tail;
+#endif
+} conn_t;
+
+static __thread conn_t *conns = NULL;      // indexed by fd
+static __thread int conn_cap = 0;
+
+static conn_t *conn_of(int fd) {
+    if(fd >= conn_cap){
+        int cap = conn_cap ? conn_cap : 64;
+        while(cap <= fd){
+            cap *= 2;
+        }
+        conn_t *c = realloc(conns, cap * sizeof(conn_t));
+        if(!c){
+            return NULL;
+        }
+        memset(c + conn_cap, 0, (cap - conn_cap) * sizeof(conn_t));
+        for(int i = conn_cap; i < cap; i++){
+            c[i].epoll_fd = -1;
+        }
+        conns = c;
+        conn_cap = cap;
+    }
+    return &conns[fd];
+}
+
+static void add_queued(conn_t *c, size_t bytes) {
+    c->queued += bytes;
+    if(c->queued > SERVER_IO_HIGH_WATER){
+        c->congested = 1;
+    }
+}
+
+// returns 1 when a congested connection is back at the low watermark
+static int sub_queued(conn_t *c, size_t bytes) {
+    c->queued -= bytes < c->queued ? bytes : c->queued;
+    if(c->congested && c->queued <= SERVER_IO_LOW_WATER){
+        c->congested = 0;
+        return 1;
+    }
+    return 0;
+}
+
+static size_t iov_total(const struct iovec *iov, int iovcnt) {
+    size_t total = 0;
+    for(int i = 0; i < iovcnt; i++){
+        total += iov[i].iov_len;
+    }
+    return total;
+}
+
+void server_io_watch(int fd, int epoll_fd, uint64_t tag) {
+    conn_t *c = conn_of(fd);
+    if(!c){
+        perror("server_io_watch");
+        return;
+    }
+    c->epoll_fd = epoll_fd;
+    c->tag = tag;
+}
+
+void server_io_shm(int fd, shm_ring_t *ring) {
+    conn_t *c = conn_of(fd);
+    if(!c){
+        perror("server_io_shm");
+        return;
+    }
+    c->shm_out = ring;
+}
+
+int server_io_congested(int fd) {
+    if(fd < 0 || fd >= conn_cap){
+        return 0;
+    }
+    conn_t *c = &conns[fd];
+    if(c->shm_out){
+        // the client drains the ring without telling us, so the fill level is looked at each time
+        ssize_t used = shm_ring_used(c->shm_out);
+        if(used > SERVER_IO_HIGH_WATER){
+            c->congested = 1;
+        }
+        else if(used <= SERVER_IO_LOW_WATER){
+            c->congested = 0;
+        }
+    }
+    return c->congested;
+}
+
+// a frame either fits in the ring whole or the client is too slow to keep
+static int shm_send(conn_t *c, const struct iovec *iov, int iovcnt) {
+    ssize_t used = shm_ring_used(c->shm_out);
+    if(used < 0 || used + iov_total(iov, iovcnt) > SHM_RING_SIZE){
+        return -1;
+    }
+    for(int i = 0; i < iovcnt; i++){
+        shm_ring_write(c->shm_out, iov[i].iov_base, iov[i].iov_len);
+    }
+    if(shm_ring_take_waiter(c->shm_out)){
+        shm_ring_wake(c->shm_out);
+    }
+    return 0;
+}
+
+#ifdef POKER_IO_URING
+
+static void release(send_req_t *req) {
+    if(req->fixed){
+        req->next = io->free_slots;
+        io->free_slots = req;
+    }
+    else{
+        free(req);
+    }
+}
+
+static void submit_head(send_req_t *req) {
+    struct io_uring_sqe *sqe = uring_get_sqe(io->ring);
+    if(!sqe){
+        uint64_t tag;
+        perror("io_uring submission queue");
+        server_io_complete(SERVER_IO_SEND_TAG | (uintptr_t)req, -1, &tag);
+        return;
+    }
+    uint64_t tag = SERVER_IO_SEND_TAG | (uintptr_t)req;
+    if(req->fixed){
+        uring_prep_write_fixed(sqe, req->fd, req->buf + req->off, req->len - req->off, 0, tag);
+    }
+    else{
+        uring_prep_send(sqe, req->fd, req->buf + req->off, req->len - req->off, tag);
+    }
+}
+
+int server_io_attach(uring_t *ring) {
+    io_state_t *st = calloc(1, sizeof(io_state_t));
+    if(!st){
+        return -1;
+    }
+    st->slab = aligned_alloc(4096, SEND_SLOTS * SEND_SLOT_SIZE);
+    struct iovec iov = { st->slab, SEND_SLOTS * SEND_SLOT_SIZE };
+    if(!st->slab || uring_register_buffers(ring, &iov, 1) < 0){
+        free(st->slab);
+        free(st);
+        return -1;
+    }
+    for(int i = 0; i < SEND_SLOTS; i++){
+        st->slots[i].fixed = 1;
+        st->slots[i].buf = st->slab + (size_t)i * SEND_SLOT_SIZE;
+        st->slots[i].next = st->free_slots;
+        st->free_slots = &st->slots[i];
+    }
+    st->ring = ring;
+    io = st;
+
+    // writes on the ring cannot ask for MSG_NOSIGNAL
+    signal(SIGPIPE, SIG_IGN);
+    return 0;
+}
+
+void server_io_detach(void) {
+    if(!io){
+        return;
+    }
+    for(int fd = 0; fd < conn_cap; fd++){
+        send_req_t *req = conns[fd].head;
+        while(req){
+            send_req_t *next = req->next;
+            release(req);
+            req = next;
+        }
+        conns[fd].head = conns[fd].tail = NULL;
+        conns[fd].queued = 0;
+        conns[fd].congested = 0;
+    }
+    free(io->slab);
+    free(io);
+    io = NULL;
+}
+
+int server_io_complete(uint64_t user_data, int res, uint64_t *tag) {
+    send_req_t *req = (send_req_t *)(uintptr_t)(user_data & ~SERVER_IO_SEND_TAG);
+    conn_t *c = &conns[req->fd];
+    int drained = 0;
+    if(!req->closed){
+        // a failed write means the peer is gone; the reader side notices and drops the seat
+        drained = sub_queued(c, res > 0 ? (size_t)res : req->len - req->off);
+        if(res > 0 && req->off + res < req->len){
+            req->off += res;
+            submit_head(req);
+            *tag = c->tag;
+            return drained;
+        }
+    }
+
+    c->head = req->next;
+    if(!c->head){
+        c->tail = NULL;
+    }
+    release(req);
+    if(c->head){
+        submit_head(c->head);
+    }
+    *tag = c->tag;
+    return drained;
+}
+
+static int ring_send(int fd, conn_t *c, const struct iovec *iov, int iovcnt) {
+    size_t total = iov_total(iov, iovcnt);
+    if(c->queued + total > SERVER_IO_QUEUE_LIMIT){
+        return -1;
+    }
+    send_req_t *req;
+    if(total <= SEND_SLOT_SIZE && io->free_slots){
+        req = io->free_slots;
+        io->free_slots = req->next;
+    }
+    else{
+        req = malloc(sizeof(send_req_t) + total);
+        if(req){
+            req->fixed = 0;
+            req->buf = (uint8_t *)(req + 1);
+        }
+    }
+    if(!req){
+        perror("server_io_send");
+        return 0;
+    }
+    req->next = NULL;
+    req->fd = fd;
+    req->closed = 0;
+    req->len = total;
+    req->off = 0;
+    size_t at = 0;
+    for(int i = 0; i < iovcnt; i++){
+        memcpy(req->buf + at, iov[i].iov_base, iov[i].iov_len);
+        at += iov[i].iov_len;
+    }
+    add_queued(c, total);
+
+    if(c->tail){
+        c->tail->next = req;
+        c->tail = req;
+    }
+    else{
+        c->head = c->tail = req;
+        submit_head(req);
+    }
+    return 0;
+}
+
+#endif
+
+static void want_writable(int fd, conn_t *c, int on) {
+    struct epoll_event ev = { .events = EPOLLIN | (on ? EPOLLOUT : 0), .data.u64 = c->tag };
+    if(epoll_ctl(c->epoll_fd, EPOLL_CTL_MOD, fd, &ev) < 0){
+        perror("epoll_ctl");
+    }
+}
+
+// appends what the socket did not take, skipping the first skip bytes of iov
+static void queue_pending(int fd, conn_t *c, const struct iovec *iov, int iovcnt, size_t skip) {
+    int was_empty = c->queued == 0;
+    for(int i = 0; i < iovcnt; i++){
+        const uint8_t *src = iov[i].iov_base;
+        size_t len = iov[i].iov_len;
+        if(skip >= len){
+            skip -= len;
+            continue;
+        }
+        src += skip;
+        len -= skip;
+        skip = 0;
+        while(len > 0){
+            size_t at = (c->start + c->queued) % SERVER_IO_QUEUE_LIMIT;
+            size_t chunk = SERVER_IO_QUEUE_LIMIT - at < len ? SERVER_IO_QUEUE_LIMIT - at : len;
+            memcpy(c->pending + at, src, chunk);
+            add_queued(c, chunk);
+            src += chunk;
+            len -= chunk;
+        }
+    }
+    if(was_empty && c->queued > 0){
+        want_writable(fd, c, 1);
+    }
+}
+
+int server_io_send(int fd, const struct iovec *iov, int iovcnt) {
+    conn_t *c = conn_of(fd);
+    if(c && c->shm_out){
+        return shm_send(c, iov, iovcnt);
+    }
+#ifdef POKER_IO_URING
+    if(io && c){
+        return ring_send(fd, c, iov, iovcnt);
+    }
+#endif
+    struct msghdr msg = { .msg_iov = (struct iovec *)iov, .msg_iovlen = iovcnt };
+    if(!c || c->epoll_fd < 0){
+        sendmsg(fd, &msg, MSG_NOSIGNAL);
+        return 0;
+    }
+
+    size_t total = iov_total(iov, iovcnt);
+    size_t sent = 0;
+    if(c->queued == 0){
+        ssize_t r = sendmsg(fd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if(r < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR){
+            // the peer is gone; the reader side notices and drops the seat
+            return 0;
+        }
+        sent = r > 0 ? (size_t)r : 0;
+        if(sent == total){
+            return 0;
+        }
+    }
+    if(c->queued + total - sent > SERVER_IO_QUEUE_LIMIT){
+        return -1;
+    }
+    if(!c->pending && !(c->pending = malloc(SERVER_IO_QUEUE_LIMIT))){
+        return -1;
+    }
+    queue_pending(fd, c, iov, iovcnt, sent);
+    return 0;
+}
+
+int server_io_writable(int fd) {
+    if(fd < 0 || fd >= conn_cap || conns[fd].queued == 0 || !conns[fd].pending){
+        return 0;
+    }
+    conn_t *c = &conns[fd];
+    int drained = 0;
+    while(c->queued > 0){
+        size_t chunk = SERVER_IO_QUEUE_LIMIT - c->start < c->queued ? SERVER_IO_QUEUE_LIMIT - c->start : c->queued;
+        ssize_t r = send(fd, c->pending + c->start, chunk, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if(r < 0 && errno == EINTR){
+            continue;
+        }
+        if(r < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)){
+            return drained;
+        }
+        if(r <= 0){
+            // the reader side notices the peer is gone and drops the seat
+            c->queued = 0;
+            c->congested = 0;
+            break;
+        }
+        c->start = (c->start + r) % SERVER_IO_QUEUE_LIMIT;
+        drained |= sub_queued(c, r);
+    }
+    c->start = 0;
+    want_writable(fd, c, 0);
+    return drained;
+}
+
+void server_io_forget(int fd) {
+    if(fd < 0 || fd >= conn_cap){
+        return;
+    }
+    conn_t *c = &conns[fd];
+    free(c->pending);
+    c->pending = NULL;
+    c->start = 0;
+    c->queued = 0;
+    c->congested = 0;
+    c->epoll_fd = -1;
+    c->shm_out = NULL;
+#ifdef POKER_IO_URING
+    if(!io || !c->head){
+        return;
+    }
+    // the write in flight finishes on its own; the rest never goes out
+    send_req_t *req = c->head->next;
+    while(req){
+        send_req_t *next = req->next;
+        release(req);
+        req = next;
+    }
+    c->head->next = NULL;
+    c->head->closed = 1;
+    c->tail = c->head;
+#endif
+}
+
+void server_io_cleanup(void) {
+    for(int fd = 0; fd < conn_cap; fd++){
+        free(conns[fd].pending);
+    }
+    free(conns);
+    conns = NULL;
+    conn_cap = 0;
+}
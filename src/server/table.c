@@ -0,0 +1,726 @@
+// table.c
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/random.h>
+
+#include "table.h"
+#include "client_action_handler.h"
+#include "game_logic.h"
+
+#define STARTING_STACK 100
+
+// the all-in chances: every runout when there are no more than ALL_IN_TRIALS, otherwise
+// sampled until each player's margin is ALL_IN_MARGIN
+#define ALL_IN_TRIALS 100000
+#define ALL_IN_MARGIN 0.005
+
+// how each player stands on every street, sampled until the margin is OUTLOOK_MARGIN
+#define OUTLOOK_TRIALS 20000
+#define OUTLOOK_MARGIN 0.01
+
+static int is_betting(table_t *table) {
+    return table->game.round_stage >= ROUND_PREFLOP && table->game.round_stage <= ROUND_RIVER;
+}
+
+static int is_between_hands(table_t *table) {
+    return table->game.round_stage == ROUND_INIT || table->game.round_stage == ROUND_SHOWDOWN;
+}
+
+// the network thread of the connection closes it once what was sent to it so far is out.
+// commands it posted before that are ignored
+static void drop_seat(table_t *table, player_id_t pid) {
+    connection_t *conn = table->conns[pid];
+    if(!conn){
+        return;
+    }
+    conn->pid = -1;
+    connection_close(conn);
+    table->conns[pid] = NULL;
+}
+
+// charges the time bank the clock was spending and stops it
+static void stop_clock(table_t *table) {
+    if(table->on_bank && table->clock_seat >= 0){
+        seat_t *seat = &table->seats[table->clock_seat];
+        uint64_t spent = timer_wheel_clock_ms() - table->bank_started;
+        seat->time_bank_ms = spent >= (uint64_t)seat->time_bank_ms ? 0 : seat->time_bank_ms - (int)spent;
+    }
+    timer_wheel_cancel(table->wheel, &table->clock);
+    table->clock_seat = -1;
+    table->on_bank = 0;
+}
+
+// gives the player to act a fresh clock; called whenever a new INFO goes out
+static void start_clock(table_t *table) {
+    game_state_t *game = &table->game;
+    stop_clock(table);
+    if(table->config.action_ms <= 0 || !is_betting(table)){
+        return;
+    }
+    player_id_t pid = game->current_player;
+    if(game->player_status[pid] != PLAYER_ACTIVE){
+        return;
+    }
+    table->clock_seat = pid;
+    timer_wheel_add(table->wheel, &table->clock, table->config.action_ms);
+}
+
+static void on_disconnect(table_t *table, player_id_t pid);
+
+// keeps the clock in step with what the table is about to send, then sends it. seats that
+// fell too far behind are dropped, which may give the others something more to send
+static void flush(table_t *table) {
+    outbox_t *box = &table->outbox;
+    unsigned evicted;
+    do{
+        if(box->has_shared){
+            if(box->shared_type == INFO){
+                start_clock(table);
+            }
+            else{
+                stop_clock(table);
+            }
+        }
+        evicted = outbox_flush(box, &table->game, table->conns);
+        for(int i = 0; i < MAX_PLAYERS; i++){
+            if(evicted & (1u << i)){
+                printf("[Server] Table %d: player %d is too slow, dropping\n", table->id, i);
+                on_disconnect(table, i);
+            }
+        }
+    } while(evicted);
+}
+
+static void send_reply(table_t *table, player_id_t pid, server_packet_type_t type, int seq) {
+    server_packet_t reply = { .packet_type = type, .seq = seq };
+    outbox_reply(&table->outbox, pid, &reply);
+}
+
+// a seat whose player left between hands can be taken by the next JOIN
+static void vacate(table_t *table, player_id_t pid) {
+    table->game.player_status[pid] = PLAYER_LEFT;
+    table->seats[pid].joined = 0;
+}
+
+// a seat that joined during a hand and is waiting for the next one
+static int is_sitting_out(table_t *table, player_id_t pid) {
+    return table->seats[pid].joined && table->conns[pid] && table->game.player_status[pid] == PLAYER_LEFT;
+}
+
+static void finish_hand(table_t *table) {
+    game_state_t *game = &table->game;
+    int winner = server_end(game);
+    outbox_end(&table->outbox, game, winner);
+
+    // seats that dropped during the hand are vacated before the next one, unless they are held.
+    // seats that sat the hand out are dealt in, keeping a READY they sent while they waited
+    for(int i = 0; i < MAX_PLAYERS; i++){
+        if(is_sitting_out(table, i)){
+            game->player_status[i] = PLAYER_ACTIVE;
+            continue;
+        }
+        table->seats[i].ready = 0;
+        if(!table->conns[i] && !table->seats[i].away){
+            vacate(table, i);
+        }
+    }
+}
+
+// the service hands a run back to the table that asked for it
+static void post_equity(equity_request_t *req) {
+    table_post(req->owner, &req->cmd);
+}
+
+static equity_request_t *new_equity_request(table_t *table, equity_request_kind_t kind, int serial) {
+    equity_request_t *req = calloc(1, sizeof(*req));
+    if(!req){
+        return NULL;
+    }
+    req->cmd.kind = COMMAND_EQUITY;
+    req->cmd.allocated = 1;
+    req->kind = kind;
+    req->done = post_equity;
+    req->owner = table;
+    req->serial = serial;
+    req->seed = (uint64_t)table->id;
+    return req;
+}
+
+// a table that asks for more than the service has room for goes without
+static void submit_equity(table_t *table, equity_request_t *req) {
+    if(equity_service_submit(table->config.equity, req) < 0){
+        free(req);
+    }
+}
+
+// asks how each player who can still bet stands against the others' unknown cards
+static void request_outlooks(table_t *table) {
+    game_state_t *game = &table->game;
+    equity_request_t *req = new_equity_request(table, EQUITY_OUTLOOKS, table->streets);
+    if(!req){
+        return;
+    }
+    int inHand = 0;
+    for(int i = 0; i < MAX_PLAYERS; i++){
+        inHand += game->player_status[i] == PLAYER_ACTIVE || game->player_status[i] == PLAYER_ALLIN;
+        if(game->player_status[i] == PLAYER_ACTIVE){
+            req->spot.hands[i] = game->hand_sets[i];
+        }
+    }
+    req->spot.board = game->board_set;
+    req->opponents = inHand - 1;
+    req->max_trials = OUTLOOK_TRIALS;
+    req->target_margin = OUTLOOK_MARGIN;
+    submit_equity(table, req);
+}
+
+// called once every player still seated has answered READY or LEAVE
+static void try_start_hand(table_t *table) {
+    game_state_t *game = &table->game;
+    if(!is_between_hands(table)){
+        return;
+    }
+    int readyCount = 0;
+    for(int i = 0; i < MAX_PLAYERS; i++){
+        if(game->player_status[i] == PLAYER_LEFT){
+            continue;
+        }
+        if(!table->seats[i].ready){
+            return;
+        }
+        ++readyCount;
+    }
+
+    // too few to deal a hand: the table waits for JOINs again, as it did before its first one.
+    // whoever is still seated counts towards min_players and keeps their READY
+    if(readyCount < 2){
+        game->round_stage = ROUND_JOIN;
+        table->joins = readyCount;
+        printf("[Server] Table %d: waiting for %d players.\n", table->id, table->config.min_players);
+        return;
+    }
+
+    reset_game_state(game);
+    server_deal(game);
+    ++table->hands;
+    ++table->streets;
+    if(table->config.equity && table->config.equity->cache){
+        request_outlooks(table);
+    }
+    outbox_snapshot(&table->outbox, game);
+}
+
+// asks for the chances of every player still in, before the rest of the board is dealt
+static void request_all_in(table_t *table) {
+    equity_request_t *req = new_equity_request(table, EQUITY_ALL_IN, table->hands);
+    if(!req){
+        return;
+    }
+    equity_spot_of_game(&table->game, &req->spot);
+    req->max_trials = ALL_IN_TRIALS;
+    req->target_margin = ALL_IN_MARGIN;
+    submit_equity(table, req);
+}
+
+// in 1/10000 of the pot, as the EQUITY packet has them
+static int equity_units(double share) {
+    return (int)(share * 10000 + 0.5);
+}
+
+// the all-in chances go to the whole table, while the hand is still the one they are for
+static void deliver_all_in(table_t *table, const equity_request_t *req) {
+    if(req->serial != table->hands){
+        return;
+    }
+    server_packet_t pkt = { .packet_type = EQUITY };
+    pkt.equity.all_in = 1;
+    pkt.equity.board_cards = card_set_count(req->spot.board);
+    char line[256];
+    int len = snprintf(line, sizeof(line), "[Server] Table %d: all in%s,", table->id, req->result.exact ? "" : " (sampled)");
+    const char *sep = "";
+    for(int i = 0; i < MAX_PLAYERS; i++){
+        pkt.equity.equity[i] = pkt.equity.margin[i] = pkt.equity.strength[i] = EQUITY_UNKNOWN;
+        if(req->spot.hands[i] == CARD_SET_EMPTY){
+            continue;
+        }
+        pkt.equity.equity[i] = equity_units(req->result.equity[i]);
+        pkt.equity.margin[i] = equity_units(req->result.margin[i]);
+        if(len < (int)sizeof(line)){
+            len += snprintf(line + len, sizeof(line) - len, "%s player %d %.1f%%", sep, i, 100 * req->result.equity[i]);
+            sep = ",";
+        }
+    }
+    printf("%s\n", line);
+    for(int i = 0; i < MAX_PLAYERS; i++){
+        if(table->conns[i]){
+            outbox_reply(&table->outbox, i, &pkt);
+        }
+    }
+}
+
+// each outlook goes to its own seat only, while the street is still the one it is for
+static void deliver_outlooks(table_t *table, const equity_request_t *req) {
+    if(req->serial != table->streets){
+        return;
+    }
+    for(int i = 0; i < MAX_PLAYERS; i++){
+        if(!req->has_outlook[i]){
+            continue;
+        }
+        const hand_outlook_t *outlook = &req->outlooks[i];
+        printf("[Server] Table %d: player %d strength %.1f%%, equity %.1f%% against %d\n", table->id, i,
+               100 * outlook->strength, 100 * outlook->equity, req->opponents);
+        if(!table->conns[i]){
+            continue;
+        }
+        server_packet_t pkt = { .packet_type = EQUITY };
+        pkt.equity.board_cards = card_set_count(req->spot.board);
+        for(int j = 0; j < MAX_PLAYERS; j++){
+            pkt.equity.equity[j] = pkt.equity.margin[j] = pkt.equity.strength[j] = EQUITY_UNKNOWN;
+        }
+        pkt.equity.equity[i] = equity_units(outlook->equity);
+        pkt.equity.margin[i] = equity_units(outlook->margin);
+        pkt.equity.strength[i] = equity_units(outlook->strength);
+        outbox_reply(&table->outbox, i, &pkt);
+    }
+}
+
+static void on_equity(table_t *table, const equity_request_t *req) {
+    if(!req->answered || table->closed){
+        return;
+    }
+    if(req->kind == EQUITY_ALL_IN){
+        deliver_all_in(table, req);
+    }
+    else{
+        deliver_outlooks(table, req);
+    }
+}
+
+// moves the hand forward after the betting state changed
+static void advance_betting(table_t *table) {
+    game_state_t *game = &table->game;
+    int reported = 0, dealt = 0;
+    while(check_betting_end(game)){
+        int inHand = 0, canBet = 0;
+        for(int i = 0; i < MAX_PLAYERS; i++){
+            if(game->player_status[i] == PLAYER_ACTIVE || game->player_status[i] == PLAYER_ALLIN){
+                ++inHand;
+            }
+            canBet += game->player_status[i] == PLAYER_ACTIVE;
+        }
+        if(inHand <= 1 || game->round_stage == ROUND_RIVER){
+            finish_hand(table);
+            return;
+        }
+        // nobody can bet again, so the rest of the board comes out in this loop
+        if(canBet <= 1 && !reported && table->config.equity){
+            request_all_in(table);
+            reported = 1;
+        }
+        server_community(game);
+        ++table->streets;
+        dealt = 1;
+    }
+    if(dealt && !reported && table->config.equity && table->config.equity->cache){
+        request_outlooks(table);
+    }
+    outbox_info(&table->outbox, game);
+}
+
+// the player to act ran out of time: check if that is free, fold otherwise
+static void on_clock_expired(wheel_timer_t *timer) {
+    table_t *table = (table_t *)((char *)timer - offsetof(table_t, clock));
+    game_state_t *game = &table->game;
+    player_id_t pid = table->clock_seat;
+    seat_t *seat = &table->seats[pid];
+
+    if(!table->on_bank && seat->time_bank_ms > 0){
+        table->on_bank = 1;
+        table->bank_started = timer_wheel_clock_ms();
+        timer_wheel_add(table->wheel, &table->clock, seat->time_bank_ms);
+        return;
+    }
+    if(table->on_bank){
+        seat->time_bank_ms = 0;
+        table->on_bank = 0;
+    }
+    table->clock_seat = -1;
+
+    client_packet_t timeoutPkt = { .packet_type = game->highest_bet == game->current_bets[pid] ? CHECK : FOLD };
+    server_packet_t reply;
+    if(handle_client_action(game, pid, &timeoutPkt, &reply) != 0){
+        return;
+    }
+    printf("[Server] Table %d: player %d timed out\n", table->id, pid);
+    advance_betting(table);
+    flush(table);
+}
+
+static void on_disconnect(table_t *table, player_id_t pid) {
+    game_state_t *game = &table->game;
+    drop_seat(table, pid);
+    if(is_betting(table)){
+        if(game->player_status[pid] != PLAYER_ACTIVE){
+            return;
+        }
+        if(pid == game->current_player){
+            client_packet_t foldPkt = { .packet_type = FOLD };
+            server_packet_t ack;
+            handle_client_action(game, pid, &foldPkt, &ack);
+        }
+        else{
+            game->player_status[pid] = PLAYER_FOLDED;
+        }
+        advance_betting(table);
+        return;
+    }
+    vacate(table, pid);
+    try_start_hand(table);
+}
+
+// the connection of a seat dropped: the seat is held for a RESUME if the table allows one
+static void on_connection_lost(table_t *table, player_id_t pid) {
+    seat_t *seat = &table->seats[pid];
+    int grace = table->config.resume_grace_ms;
+    if(grace <= 0 || !seat->token || table->game.player_status[pid] == PLAYER_LEFT){
+        on_disconnect(table, pid);
+        return;
+    }
+    drop_seat(table, pid);
+    seat->away = 1;
+    seat->away_until = timer_wheel_clock_ms() + grace;
+    // every hold lasts as long, so the one armed already is due first
+    if(!wheel_timer_armed(&table->grace)){
+        timer_wheel_add(table->wheel, &table->grace, grace);
+    }
+    printf("[Server] Table %d: player %d dropped, holding the seat\n", table->id, pid);
+}
+
+// gives up the held seats whose time ran out
+static void on_grace_expired(wheel_timer_t *timer) {
+    table_t *table = (table_t *)((char *)timer - offsetof(table_t, grace));
+    uint64_t now = timer_wheel_clock_ms();
+    uint64_t next = 0;
+    for(int i = 0; i < MAX_PLAYERS; i++){
+        seat_t *seat = &table->seats[i];
+        if(!seat->away){
+            continue;
+        }
+        if(seat->away_until <= now){
+            seat->away = 0;
+            printf("[Server] Table %d: player %d did not come back\n", table->id, i);
+            on_disconnect(table, i);
+        }
+        else if(next == 0 || seat->away_until < next){
+            next = seat->away_until;
+        }
+    }
+    if(next && !table->closed){
+        timer_wheel_add(table->wheel, &table->grace, next - now);
+    }
+    flush(table);
+}
+
+static int new_token(void) {
+    unsigned token;
+    if(getrandom(&token, sizeof(token), 0) != sizeof(token)){
+        return 0;
+    }
+    token &= 0x7FFFFFFF;
+    return token ? (int)token : 1;
+}
+
+static void on_client_packet(table_t *table, player_id_t pid, const client_packet_t *pkt) {
+    game_state_t *game = &table->game;
+    seat_t *seat = &table->seats[pid];
+
+    switch(pkt->packet_type){
+        case JOIN:
+            // the connection holds a seat already; its client waits on an answer like any other
+            seat->last_seq = pkt->seq;
+            seat->last_accepted = 0;
+            send_reply(table, pid, NACK, pkt->seq);
+            break;
+        case LEAVE:
+            if(is_betting(table)){
+                on_disconnect(table, pid);
+                break;
+            }
+            drop_seat(table, pid);
+            vacate(table, pid);
+            try_start_hand(table);
+            break;
+        case RESYNC:
+            if(is_betting(table)){
+                outbox_resync(&table->outbox, game, pid);
+            }
+            break;
+        case READY:
+            if(!is_betting(table)){
+                seat->ready = 1;
+                game->player_status[pid] = PLAYER_ACTIVE;
+                try_start_hand(table);
+            }
+            else if(is_sitting_out(table, pid)){
+                seat->ready = 1;
+            }
+            break;
+        default:{
+            server_packet_t reply;
+            seat->last_seq = pkt->seq;
+            seat->last_accepted = 0;
+            if(!is_betting(table) || handle_client_action(game, pid, pkt, &reply) != 0){
+                send_reply(table, pid, NACK, pkt->seq);
+                break;
+            }
+            seat->last_accepted = 1;
+            send_reply(table, pid, ACK, pkt->seq);
+            advance_betting(table);
+            break;
+        }
+    }
+}
+
+// a connection that is refused its seat is sent a NACK and closed
+static void refuse(connection_t *conn) {
+    server_packet_t reply = { .packet_type = NACK };
+    wire_buf_t frame;
+    if(wire_encode_server(&reply, &frame) > 0){
+        struct iovec iov = { frame.bytes, frame.len };
+        connection_send(conn, &iov, 1);
+    }
+    connection_close(conn);
+}
+
+void table_init(table_t *table, int id, int random_seed, const table_config_t *config, timer_wheel_t *wheel,
+                mpsc_bell_t *bell, void (*on_halt)(table_t *table)) {
+    memset(table, 0, sizeof(*table));
+    table->id = id;
+    table->config = *config;
+    table->wheel = wheel;
+    table->bell = bell;
+    mpsc_queue_init(&table->commands);
+    table->on_halt = on_halt;
+    table->clock_seat = -1;
+    wheel_timer_init(&table->clock, on_clock_expired);
+    wheel_timer_init(&table->grace, on_grace_expired);
+    if(table->config.min_players < 2 || table->config.min_players > MAX_PLAYERS){
+        table->config.min_players = MAX_PLAYERS;
+    }
+    init_game_state(&table->game, STARTING_STACK, random_seed);
+    // every seat is empty until a JOIN takes it
+    for(int i = 0; i < MAX_PLAYERS; i++){
+        table->game.player_status[i] = PLAYER_LEFT;
+    }
+}
+
+// the seat a JOIN should get: the one it asked for, or any free one for ANY_SEAT. -1 if there is none
+static player_id_t free_seat(table_t *table, player_id_t requested) {
+    if(table->closed){
+        return -1;
+    }
+    // a seat is handed out again once its player has left between hands
+    if(requested == ANY_SEAT){
+        for(int i = 0; i < MAX_PLAYERS; i++){
+            if(!table->conns[i] && !table->seats[i].joined){
+                return i;
+            }
+        }
+        return -1;
+    }
+    if(requested < 0 || requested >= MAX_PLAYERS){
+        return -1;
+    }
+    if(table->conns[requested] || table->seats[requested].joined){
+        return -1;
+    }
+    return requested;
+}
+
+// seats a connection and answers its JOIN with the seat. a player joining during a hand
+// sits it out and is dealt in from the next one
+static void take_seat(table_t *table, player_id_t pid, connection_t *conn, const client_packet_t *join) {
+    game_state_t *game = &table->game;
+    seat_t *seat = &table->seats[pid];
+    table->conns[pid] = conn;
+    conn->pid = pid;
+    seat->joined = 1;
+    seat->time_bank_ms = table->config.time_bank_ms;
+    seat->token = table->config.resume_grace_ms > 0 ? new_token() : 0;
+    seat->last_seq = join->seq;
+    seat->last_accepted = 1;
+    seat->ready = 0;
+    game->player_stacks[pid] = STARTING_STACK;
+    // during a hand the seat watches until the next one; otherwise it answers READY or LEAVE with the rest
+    game->player_status[pid] = is_betting(table) ? PLAYER_LEFT : PLAYER_ACTIVE;
+    outbox_subscribe(&table->outbox, pid, join->params[2]);
+
+    join_packet_t seated = { .table_id = table->id, .player_id = pid, .token = seat->token, .last_seq = join->seq, .last_accepted = 1 };
+    outbox_joined(&table->outbox, &seated, join->seq);
+
+    printf(" [Server] Table %d: player %d joined\n", table->id, pid);
+    // players that left again before then still count towards opening the table
+    if(game->round_stage == ROUND_JOIN && ++table->joins >= table->config.min_players){
+        printf("[Server] Table %d: %d players joined.\n", table->id, table->joins);
+        game->round_stage = ROUND_INIT;
+        try_start_hand(table);
+    }
+    flush(table);
+
+    // the hand the seat joined in the middle of, built for it in full
+    if(is_betting(table)){
+        outbox_resync(&table->outbox, game, pid);
+        flush(table);
+    }
+}
+
+void table_halt(table_t *table) {
+    if(table->closed){
+        return;
+    }
+    outbox_halt(&table->outbox);
+    flush(table);
+    for(int i = 0; i < MAX_PLAYERS; i++){
+        drop_seat(table, i);
+        table->seats[i].away = 0;
+    }
+    stop_clock(table);
+    timer_wheel_cancel(table->wheel, &table->grace);
+    table->closed = 1;
+    printf("[Server] Table %d halted.\n", table->id);
+    table->on_halt(table);
+}
+
+// a RESUME may take back a seat that is held and whose token it shows
+static int can_resume(table_t *table, const client_packet_t *resume) {
+    player_id_t pid = resume->params[1];
+    if(table->closed || pid < 0 || pid >= MAX_PLAYERS){
+        return 0;
+    }
+    seat_t *seat = &table->seats[pid];
+    return seat->away && seat->token != 0 && seat->token == resume->params[2];
+}
+
+// gives a held seat back to a new connection and sends it the state of the hand
+static void retake_seat(table_t *table, connection_t *conn, const client_packet_t *resume) {
+    game_state_t *game = &table->game;
+    player_id_t pid = resume->params[1];
+    seat_t *seat = &table->seats[pid];
+    table->conns[pid] = conn;
+    conn->pid = pid;
+    seat->away = 0;
+    outbox_subscribe(&table->outbox, pid, table->outbox.wants_delta[pid] ? JOIN_DELTA_INFO : 0);
+
+    join_packet_t seated = { .table_id = table->id, .player_id = pid, .token = seat->token,
+                             .last_seq = seat->last_seq, .last_accepted = seat->last_accepted };
+    outbox_joined(&table->outbox, &seated, resume->seq);
+    printf("[Server] Table %d: player %d resumed\n", table->id, pid);
+    flush(table);
+
+    // the INFO the seat missed while it was away, built for it in full
+    if(is_betting(table)){
+        outbox_resync(&table->outbox, game, pid);
+        flush(table);
+    }
+}
+
+// catches a seat up after its connection drained from congested to the low watermark: it is
+// sent the current INFO in full if it missed any while congested
+static void on_drained(table_t *table, player_id_t pid) {
+    if(!is_betting(table)){
+        return;
+    }
+    if(table->outbox.seat_version[pid] != table->outbox.info_version){
+        outbox_resync(&table->outbox, &table->game, pid);
+        flush(table);
+    }
+}
+
+static void on_command(table_t *table, command_t *cmd) {
+    connection_t *conn = cmd->conn;
+    const client_packet_t *pkt = &cmd->pkt;
+    if(cmd->kind == COMMAND_EQUITY){
+        on_equity(table, (equity_request_t *)cmd);
+        return;
+    }
+    if(cmd->kind == COMMAND_JOIN){
+        if(pkt->packet_type == RESUME){
+            if(can_resume(table, pkt)){
+                retake_seat(table, conn, pkt);
+            }
+            else{
+                refuse(conn);
+            }
+            return;
+        }
+        player_id_t pid = free_seat(table, pkt->params[1]);
+        if(pid < 0){
+            refuse(conn);
+            return;
+        }
+        take_seat(table, pid, conn, pkt);
+        return;
+    }
+
+    // the rest is about a seat, which the connection may have lost since it posted this
+    player_id_t pid = conn->pid;
+    if(pid < 0){
+        return;
+    }
+    switch(cmd->kind){
+        case COMMAND_PACKET:
+            on_client_packet(table, pid, pkt);
+            break;
+        case COMMAND_LOST:
+            on_connection_lost(table, pid);
+            break;
+        case COMMAND_CORRUPT:
+            printf("[Server] Table %d: malformed packet from player %d\n", table->id, pid);
+            on_disconnect(table, pid);
+            break;
+        case COMMAND_SLOW:
+            printf("[Server] Table %d: player %d is too slow, dropping\n", table->id, pid);
+            on_disconnect(table, pid);
+            break;
+        case COMMAND_DRAINED:
+            on_drained(table, pid);
+            break;
+        default:
+            break;
+    }
+}
+
+void table_post(table_t *table, command_t *cmd) {
+    mpsc_queue_push(&table->commands, &cmd->node);
+    mpsc_bell_ring(table->bell);
+}
+
+void table_drain(table_t *table) {
+    mpsc_node_t *node;
+    while((node = mpsc_queue_pop(&table->commands)) != NULL){
+        command_t *cmd = (command_t *)node;
+        // the release is the connection's own, and goes with it
+        if(cmd->kind == COMMAND_RELEASE){
+            connection_free(cmd->conn);
+            continue;
+        }
+        on_command(table, cmd);
+        command_free(cmd);
+        flush(table);
+    }
+}
+
+void table_discard(table_t *table) {
+    mpsc_node_t *node;
+    while((node = mpsc_queue_pop(&table->commands)) != NULL){
+        command_t *cmd = (command_t *)node;
+        if(cmd->kind == COMMAND_RELEASE){
+            connection_free(cmd->conn);
+        }
+        else{
+            command_free(cmd);
+        }
+    }
+}
@@ -0,0 +1,1041 @@
+// table_manager.c
+// pthread_setaffinity_np() is a GNU extension
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+
+#include "table_manager.h"
+#include "server_io.h"
+#include "uring.h"
+#include "mpsc_queue.h"
+#include "connection.h"
+
+#define WORKER_MAX_EVENTS 64
+
+// resolution of the action clocks
+#define CLOCK_TICK_MS 100
+
+// io_uring sizing: submission entries per ring, and the buffers multishot recv fills
+#define RING_ENTRIES 256
+#define RECV_BUF_GROUP 0
+#define RECV_BUF_COUNT 256
+#define RECV_BUF_SIZE 2048
+
+// tags carry what became ready. on a network thread: its outbound queue, a connection (its
+// generation and fd in the low bits), a listening socket (TCP or unix, in the low bits) or the
+// shutdown signal. on an engine: its command queue, the clock tick, the shutdown signal or the
+// request to stop
+#define KIND_OUTBOUND 1ull
+#define KIND_CONN     2ull
+#define KIND_TICK     3ull
+#define KIND_LISTEN   4ull
+#define KIND_SHUTDOWN 5ull
+#define KIND_COMMANDS 6ull
+#define KIND_STOP     7ull
+#define MAKE_TAG(kind, value) (((kind) << 56) | (uint64_t)(value))
+#define TAG_KIND(tag)  ((tag) >> 56)
+#define TAG_VALUE(tag) ((int)((tag) & 0xFFFFFFFFull))
+#define CONN_TAG(conn) MAKE_TAG(KIND_CONN, ((uint64_t)((conn)->gen & 0xFFFFFF) << 32) | (uint32_t)(conn)->fd)
+#define TAG_GEN(tag)   ((uint32_t)(((tag) >> 32) & 0xFFFFFF))
+
+#define LISTEN_TCP  0
+#define LISTEN_UNIX 1
+
+/**
+ * a thread that accepts connections, reads and decodes what they send, and sends what the
+ * engines wrote to them
+ */
+typedef struct {
+    int index;
+    pthread_t thread;
+    int cpu;                                // the CPU the thread is pinned to, -1 if it is not
+    int epoll_fd;
+    int listen_fd;                          // this thread's share of BASE_PORT (SO_REUSEPORT)
+    int unix_fd;                            // TRANSPORT_UNIX_PATH, on network 0 only, -1 elsewhere
+    outbound_t outbound;                    // connections the engines wrote to
+    connection_t **conns;                   // by fd, NULL where the thread has none
+    int conn_cap;
+    uint32_t next_gen;
+#ifdef POKER_IO_URING
+    uring_t ring;
+    int use_ring;                           // the thread runs on the ring instead of epoll
+#endif
+} network_t;
+
+/**
+ * a thread that runs the game of its tables: table t belongs to engine t % worker_count
+ */
+typedef struct {
+    int index;
+    pthread_t thread;
+    int cpu;                                // the CPU the thread is pinned to, -1 if it is not
+    int epoll_fd;
+    int live_tables;                        // tables of this engine that have not halted
+    mpsc_bell_t bell;                       // rung after a command is posted to one of its tables
+    timer_wheel_t wheel;                    // action clocks of the engine's tables
+    int tick_fd;                            // timerfd that advances the wheel while it holds timers
+    int ticking;
+    int stopping;                           // the engine has halted its tables
+} engine_t;
+
+static table_t *tables = NULL;
+static int table_count = 0;
+static network_t *networks = NULL;
+static engine_t *engines = NULL;
+static int worker_count = 0;                // network threads, and as many engines
+static int live_total = 0;                  // tables that have not halted, on every engine
+static int shutdown_fd = -1;                // eventfd raised once the last table halts
+static int stop_fd = -1;                    // eventfd raised by table_manager_stop()
+
+static engine_t *engine_of(int table_id) {
+    return &engines[table_id % worker_count];
+}
+
+static int watch_fd(int epoll_fd, int fd, struct epoll_event ev) {
+    return epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+}
+
+// answers a connection that asked for a table that does not exist
+static void refuse(int fd) {
+    server_packet_t reply = { .packet_type = NACK };
+    wire_buf_t frame;
+    if(wire_encode_server(&reply, &frame) > 0){
+        send(fd, frame.bytes, frame.len, MSG_NOSIGNAL);
+    }
+}
+
+// every network thread binds its own socket to the port; the kernel spreads new connections over them
+static int open_listener(int port) {
+    int opt = 1;
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if(fd < 0){
+        perror("socket");
+        return -1;
+    }
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+    if(setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt)) < 0){
+        perror("setsockopt SO_REUSEPORT");
+        close(fd);
+        return -1;
+    }
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = INADDR_ANY;
+    address.sin_port = htons(port);
+    if(bind(fd, (struct sockaddr *)&address, sizeof(address)) < 0){
+        perror("bind");
+        close(fd);
+        return -1;
+    }
+    if(listen(fd, SOMAXCONN) < 0){
+        perror("listen");
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// same-host clients connect here; the server still runs on TCP alone if it cannot be opened
+static int open_unix_listener(const char *path) {
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if(fd < 0){
+        perror("socket");
+        return -1;
+    }
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, path, sizeof(address.sun_path) - 1);
+    unlink(path);
+    if(bind(fd, (struct sockaddr *)&address, sizeof(address)) < 0 || listen(fd, SOMAXCONN) < 0){
+        perror("[Server] unix socket unavailable");
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// gives each network thread a CPU of its own if there is one for every thread, then each
+// engine one if there is one for every engine as well
+static void assign_cpus() {
+    cpu_set_t allowed;
+    if(sched_getaffinity(0, sizeof(allowed), &allowed) < 0 || CPU_COUNT(&allowed) < worker_count){
+        return;
+    }
+    int pin_engines = CPU_COUNT(&allowed) >= 2 * worker_count;
+    int next = 0;
+    for(int cpu = 0; cpu < CPU_SETSIZE && next < 2 * worker_count; cpu++){
+        if(!CPU_ISSET(cpu, &allowed)){
+            continue;
+        }
+        if(next < worker_count){
+            networks[next].cpu = cpu;
+        }
+        else if(pin_engines){
+            engines[next - worker_count].cpu = cpu;
+        }
+        next++;
+    }
+}
+
+static void pin_thread(const char *what, int index, int cpu) {
+    if(cpu < 0){
+        return;
+    }
+    cpu_set_t one;
+    CPU_ZERO(&one);
+    CPU_SET(cpu, &one);
+    int err = pthread_setaffinity_np(pthread_self(), sizeof(one), &one);
+    if(err != 0){
+        fprintf(stderr, "[Server] %s %d not pinned to CPU %d: %s\n", what, index, cpu, strerror(err));
+    }
+}
+
+static int running() {
+    return __atomic_load_n(&live_total, __ATOMIC_ACQUIRE) > 0;
+}
+
+// called by a table as it halts; the last one to halt anywhere stops every thread
+static void table_halted(table_t *table) {
+    --engine_of(table->id)->live_tables;
+    if(__atomic_sub_fetch(&live_total, 1, __ATOMIC_ACQ_REL) == 0){
+        uint64_t one = 1;
+        if(write(shutdown_fd, &one, sizeof(one)) < 0){
+            perror("write");
+        }
+    }
+}
+
+// ---------------------------- engines ---------------------------- //
+
+// the server was asked to stop: every table of e is halted, and the last one stops the threads
+static void halt_tables(engine_t *e) {
+    if(e->stopping){
+        return;
+    }
+    e->stopping = 1;
+    // stop_fd is never read, so it would stay ready for an epoll loop
+    epoll_ctl(e->epoll_fd, EPOLL_CTL_DEL, stop_fd, NULL);
+    for(int t = e->index; t < table_count; t += worker_count){
+        table_halt(&tables[t]);
+    }
+}
+
+// runs what the network threads posted to the tables of e
+static void run_commands(engine_t *e) {
+    mpsc_bell_answer(&e->bell);
+    for(int t = e->index; t < table_count; t += worker_count){
+        table_drain(&tables[t]);
+    }
+}
+
+// runs the clocks that came due
+static void on_tick(engine_t *e) {
+    uint64_t count;
+    if(read(e->tick_fd, &count, sizeof(count)) < 0 && errno != EAGAIN){
+        perror("read");
+    }
+    timer_wheel_advance(&e->wheel);
+}
+
+// the tick only runs while some clock is armed, so an idle engine is never woken
+static void sync_tick(engine_t *e) {
+    int want = e->wheel.count > 0;
+    if(want == e->ticking){
+        return;
+    }
+    struct itimerspec spec;
+    memset(&spec, 0, sizeof(spec));
+    if(want){
+        spec.it_interval.tv_nsec = CLOCK_TICK_MS * 1000000L;
+        spec.it_value = spec.it_interval;
+    }
+    if(timerfd_settime(e->tick_fd, 0, &spec, NULL) < 0){
+        perror("timerfd_settime");
+        return;
+    }
+    e->ticking = want;
+}
+
+static void *engine_main(void *arg) {
+    engine_t *e = arg;
+    struct epoll_event events[WORKER_MAX_EVENTS];
+
+    pin_thread("engine", e->index, e->cpu);
+    while(running()){
+        sync_tick(e);
+        int n = epoll_wait(e->epoll_fd, events, WORKER_MAX_EVENTS, -1);
+        if(n < 0){
+            if(errno == EINTR){
+                continue;
+            }
+            perror("epoll_wait");
+            break;
+        }
+        for(int i = 0; i < n; i++){
+            switch(TAG_KIND(events[i].data.u64)){
+                case KIND_COMMANDS:
+                    run_commands(e);
+                    break;
+                case KIND_TICK:
+                    on_tick(e);
+                    break;
+                case KIND_STOP:
+                    halt_tables(e);
+                    break;
+                default:
+                    break;
+            }
+        }
+    }
+    return NULL;
+}
+
+// ---------------------------- connections ---------------------------- //
+
+// the connection a tag was made for, or NULL if it has been closed since
+static connection_t *find_conn(network_t *n, uint64_t tag) {
+    int fd = TAG_VALUE(tag);
+    if(fd < 0 || fd >= n->conn_cap || !n->conns[fd]){
+        return NULL;
+    }
+    connection_t *conn = n->conns[fd];
+    return (conn->gen & 0xFFFFFF) == TAG_GEN(tag) ? conn : NULL;
+}
+
+static int grow_conns(network_t *n, int fd) {
+    if(fd < n->conn_cap){
+        return 0;
+    }
+    int cap = n->conn_cap ? n->conn_cap : 64;
+    while(cap <= fd){
+        cap *= 2;
+    }
+    connection_t **conns = realloc(n->conns, cap * sizeof(connection_t *));
+    if(!conns){
+        return -1;
+    }
+    memset(conns + n->conn_cap, 0, (cap - n->conn_cap) * sizeof(connection_t *));
+    n->conns = conns;
+    n->conn_cap = cap;
+    return 0;
+}
+
+// closes the socket. a connection that joined a table is freed by the table's engine, once it
+// takes the release; that comes after everything else this thread posted about the connection
+static void close_conn(network_t *n, connection_t *conn) {
+    server_io_forget(conn->fd);
+    // ends a multishot recv the ring may still hold on the socket
+    shutdown(conn->fd, SHUT_RDWR);
+    close(conn->fd);
+    n->conns[conn->fd] = NULL;
+    shm_channel_unmap(conn->shm);
+    conn->shm = NULL;
+    if(conn->shm_fd >= 0){
+        close(conn->shm_fd);
+        conn->shm_fd = -1;
+    }
+    if(conn->table_id >= 0){
+        table_post(&tables[conn->table_id], &conn->release);
+    }
+    else{
+        connection_free(conn);
+    }
+}
+
+// stops reading a connection that joined, and tells its table why; the table closes it
+static void lose(network_t *n, connection_t *conn, command_kind_t why) {
+    if(conn->lost){
+        return;
+    }
+    conn->lost = 1;
+    // on a ring, the recv is simply not re-armed
+    epoll_ctl(n->epoll_fd, EPOLL_CTL_DEL, conn->fd, NULL);
+    conn->gone.kind = why;
+    table_post(&tables[conn->table_id], &conn->gone);
+}
+
+// tells the engine how far behind the socket is; a seat that drained is caught up
+static void publish_congestion(network_t *n, connection_t *conn) {
+    int now = server_io_congested(conn->fd);
+    int was = __atomic_exchange_n(&conn->congested, now, __ATOMIC_RELAXED);
+    if(!was || now || conn->lost){
+        return;
+    }
+    command_t *cmd = command_new(conn, COMMAND_DRAINED, NULL);
+    if(!cmd){
+        perror("command_new");
+        return;
+    }
+    table_post(&tables[conn->table_id], cmd);
+}
+
+// a connection asked for a table: the JOIN is posted there, and from now on the connection is
+// read through the shared memory channel it passed along, if it did
+static int open_join(network_t *n, connection_t *conn, const client_packet_t *join) {
+    if(conn->shm_fd >= 0){
+        // the mapping keeps the channel alive on its own
+        conn->shm = shm_channel_map(conn->shm_fd);
+        close(conn->shm_fd);
+        conn->shm_fd = -1;
+        if(!conn->shm){
+            refuse(conn->fd);
+            close_conn(n, conn);
+            return -1;
+        }
+        server_io_shm(conn->fd, &conn->shm->to_client);
+    }
+    conn->table_id = join->params[0];
+    conn->join.pkt = *join;
+    table_post(&tables[conn->table_id], &conn->join);
+    return 0;
+}
+
+// posts every whole packet the reader holds to the connection's table; the first one has to
+// be its JOIN or RESUME. returns -1 if the connection was closed
+static int decode(network_t *n, connection_t *conn) {
+    client_packet_t pkt;
+    int got;
+    while(!conn->lost && (got = frame_reader_next_client(&conn->rx, &pkt)) != 0){
+        if(conn->table_id < 0){
+            if(got < 0 || (pkt.packet_type != JOIN && pkt.packet_type != RESUME)){
+                close_conn(n, conn);
+                return -1;
+            }
+            if(pkt.params[0] < 0 || pkt.params[0] >= table_count){
+                refuse(conn->fd);
+                close_conn(n, conn);
+                return -1;
+            }
+            if(open_join(n, conn, &pkt) < 0){
+                return -1;
+            }
+            continue;
+        }
+        if(got < 0){
+            lose(n, conn, COMMAND_CORRUPT);
+            break;
+        }
+        command_t *cmd = command_new(conn, COMMAND_PACKET, &pkt);
+        if(!cmd){
+            perror("command_new");
+            lose(n, conn, COMMAND_LOST);
+            break;
+        }
+        table_post(&tables[conn->table_id], cmd);
+    }
+    return 0;
+}
+
+// reads whatever a client on shared memory wrote, then parks on its doorbell
+static void pump_ring(network_t *n, connection_t *conn) {
+    while(!conn->lost){
+        ssize_t r = frame_reader_fill_ring(&conn->rx, &conn->shm->to_server);
+        if(r < 0){
+            lose(n, conn, COMMAND_CORRUPT);
+            return;
+        }
+        if(r > 0){
+            decode(n, conn);
+        }
+        else if(!shm_ring_park(&conn->shm->to_server)){
+            break;
+        }
+    }
+    // nothing says when the client drained its ring, so whether it caught up is checked here
+    if(!conn->lost){
+        publish_congestion(n, conn);
+    }
+}
+
+// the socket of a client on shared memory carries nothing but doorbells
+static int drain_doorbell(int fd) {
+    uint8_t bell[64];
+    while(1){
+        ssize_t r = recv(fd, bell, sizeof(bell), MSG_DONTWAIT);
+        if(r > 0){
+            continue;
+        }
+        if(r < 0 && errno == EINTR){
+            continue;
+        }
+        if(r < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)){
+            return 0;
+        }
+        return -1;
+    }
+}
+
+// reads a connection that has not sent all of its JOIN yet, which may pass a shared memory
+// channel along. returns -1 if the connection was closed
+static int read_join(network_t *n, connection_t *conn) {
+    int passed = -1;
+    ssize_t r = frame_reader_fill_fd(&conn->rx, conn->fd, MSG_DONTWAIT, &passed);
+    if(passed >= 0){
+        // a client on shared memory sends its channel once, with the JOIN
+        if(conn->shm_fd >= 0){
+            close(conn->shm_fd);
+        }
+        conn->shm_fd = passed;
+    }
+    if(r < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)){
+        return 0;
+    }
+    if(r <= 0){
+        close_conn(n, conn);
+        return -1;
+    }
+    if(decode(n, conn) < 0){
+        return -1;
+    }
+    if(conn->shm){
+        pump_ring(n, conn);
+    }
+    return 0;
+}
+
+// what a connection that joined sent: data, or the end of the stream when len is 0
+static void on_received(network_t *n, connection_t *conn, const uint8_t *data, size_t len) {
+    if(conn->lost){
+        return;
+    }
+    if(len == 0){
+        lose(n, conn, COMMAND_LOST);
+        return;
+    }
+    if(conn->shm){
+        pump_ring(n, conn);
+        return;
+    }
+    if(frame_reader_push(&conn->rx, data, len) < 0){
+        lose(n, conn, COMMAND_CORRUPT);
+        return;
+    }
+    decode(n, conn);
+}
+
+// a connection's socket is readable on the epoll loop
+static void on_readable(network_t *n, connection_t *conn) {
+    if(conn->table_id < 0){
+        read_join(n, conn);
+        return;
+    }
+    if(conn->shm){
+        if(drain_doorbell(conn->fd) < 0){
+            lose(n, conn, COMMAND_LOST);
+            return;
+        }
+        pump_ring(n, conn);
+        return;
+    }
+    while(!conn->lost){
+        ssize_t r = frame_reader_fill(&conn->rx, conn->fd, MSG_DONTWAIT);
+        if(r < 0 && errno == EINTR){
+            continue;
+        }
+        if(r < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)){
+            return;
+        }
+        if(r <= 0){
+            lose(n, conn, COMMAND_LOST);
+            return;
+        }
+        decode(n, conn);
+    }
+}
+
+// sends what the engines wrote to the connections of n, and closes the ones they are done with
+static void send_outbound(network_t *n) {
+    mpsc_bell_answer(&n->outbound.bell);
+    connection_t *conn;
+    while((conn = outbound_pop(&n->outbound)) != NULL){
+        int closing = connection_closing(conn);
+        uint8_t chunk[4096];
+        ssize_t r;
+        while((r = shm_ring_read(&conn->out, chunk, sizeof(chunk))) > 0){
+            // nothing more goes to a connection that is gone or could not keep up
+            if(conn->lost){
+                continue;
+            }
+            struct iovec iov = { .iov_base = chunk, .iov_len = r };
+            if(server_io_send(conn->fd, &iov, 1) < 0){
+                lose(n, conn, COMMAND_SLOW);
+            }
+        }
+        if(!closing){
+            publish_congestion(n, conn);
+        }
+        else if(connection_done(conn)){
+            close_conn(n, conn);
+        }
+    }
+}
+
+// ---------------------------- accepting ---------------------------- //
+
+// waits for the next bytes of a connection's JOIN
+static int watch_join(network_t *n, connection_t *conn) {
+#ifdef POKER_IO_URING
+    if(n->use_ring){
+        struct io_uring_sqe *sqe = uring_get_sqe(&n->ring);
+        if(!sqe){
+            return -1;
+        }
+        uring_prep_poll(sqe, conn->fd, CONN_TAG(conn));
+        return 0;
+    }
+#endif
+    struct epoll_event ev = { .events = EPOLLIN, .data.u64 = CONN_TAG(conn) };
+    return watch_fd(n->epoll_fd, conn->fd, ev);
+}
+
+static void add_conn(network_t *n, int fd) {
+    connection_t *conn = grow_conns(n, fd) < 0 ? NULL : connection_new(fd, ++n->next_gen, &n->outbound);
+    if(!conn){
+        perror("connection_new");
+        close(fd);
+        return;
+    }
+    n->conns[fd] = conn;
+#ifdef POKER_IO_URING
+    server_io_watch(fd, n->use_ring ? -1 : n->epoll_fd, CONN_TAG(conn));
+#else
+    server_io_watch(fd, n->epoll_fd, CONN_TAG(conn));
+#endif
+    if(watch_join(n, conn) < 0){
+        perror("watch_join");
+        close_conn(n, conn);
+    }
+}
+
+static void accept_conns(network_t *n, int lfd) {
+    while(1){
+        int fd = accept(lfd, NULL, NULL);
+        if(fd < 0){
+            if(errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR){
+                perror("accept");
+            }
+            return;
+        }
+        add_conn(n, fd);
+    }
+}
+
+// ---------------------------- io_uring loop ---------------------------- //
+
+#ifdef POKER_IO_URING
+static int arm_poll(network_t *n, int fd, uint64_t tag) {
+    struct io_uring_sqe *sqe = uring_get_sqe(&n->ring);
+    if(!sqe){
+        return -1;
+    }
+    uring_prep_poll_multishot(sqe, fd, tag);
+    return 0;
+}
+
+static int arm_accept(network_t *n, int which) {
+    int lfd = which == LISTEN_UNIX ? n->unix_fd : n->listen_fd;
+    if(lfd < 0){
+        return 0;
+    }
+    struct io_uring_sqe *sqe = uring_get_sqe(&n->ring);
+    if(!sqe){
+        return -1;
+    }
+    uring_prep_accept_multishot(sqe, lfd, MAKE_TAG(KIND_LISTEN, which));
+    return 0;
+}
+
+static int arm_recv(network_t *n, connection_t *conn) {
+    struct io_uring_sqe *sqe = uring_get_sqe(&n->ring);
+    if(!sqe){
+        return -1;
+    }
+    uring_prep_recv_multishot(sqe, conn->fd, RECV_BUF_GROUP, CONN_TAG(conn));
+    return 0;
+}
+
+static int start_ring(network_t *n) {
+    if(uring_init(&n->ring, RING_ENTRIES) < 0){
+        return -1;
+    }
+    if(uring_setup_recv_buffers(&n->ring, RECV_BUF_GROUP, RECV_BUF_COUNT, RECV_BUF_SIZE) < 0
+       || server_io_attach(&n->ring) < 0
+       || arm_poll(n, n->outbound.bell.fd, MAKE_TAG(KIND_OUTBOUND, 0)) < 0
+       || arm_poll(n, shutdown_fd, MAKE_TAG(KIND_SHUTDOWN, 0)) < 0
+       || arm_accept(n, LISTEN_TCP) < 0 || arm_accept(n, LISTEN_UNIX) < 0){
+        uring_fini(&n->ring);
+        return -1;
+    }
+    n->use_ring = 1;
+    return 0;
+}
+
+// one completion for a connection: its JOIN became readable, or data, the end of the stream or
+// a recv to re-arm once it joined
+static void ring_conn_event(network_t *n, struct io_uring_cqe *cqe) {
+    connection_t *conn = find_conn(n, cqe->user_data);
+    if(!conn){
+        uring_recycle_buffer(&n->ring, cqe);
+        return;
+    }
+    if(conn->table_id < 0){
+        // the one-shot poll of a connection that has not joined
+        if(read_join(n, conn) < 0){
+            return;
+        }
+        if(conn->table_id < 0){
+            if(watch_join(n, conn) < 0){
+                perror("watch_join");
+                close_conn(n, conn);
+            }
+        }
+        else if(!conn->lost && arm_recv(n, conn) < 0){
+            perror("arm_recv");
+            lose(n, conn, COMMAND_LOST);
+        }
+        return;
+    }
+
+    if(cqe->res > 0){
+        on_received(n, conn, uring_recv_buffer(&n->ring, cqe), cqe->res);
+    }
+    else if(cqe->res != -ENOBUFS){
+        on_received(n, conn, NULL, 0);
+    }
+    uring_recycle_buffer(&n->ring, cqe);
+
+    if(!(cqe->flags & IORING_CQE_F_MORE) && !conn->lost && arm_recv(n, conn) < 0){
+        perror("arm_recv");
+        lose(n, conn, COMMAND_LOST);
+    }
+}
+
+// the network loop on io_uring: every send queued while handling one batch of completions
+// is submitted together with the next wait
+static void run_ring(network_t *n) {
+    while(running()){
+        if(uring_submit_and_wait(&n->ring, 1) < 0){
+            if(errno == EINTR){
+                continue;
+            }
+            perror("io_uring_enter");
+            break;
+        }
+        struct io_uring_cqe *cqe;
+        while((cqe = uring_peek_cqe(&n->ring)) != NULL){
+            uint64_t tag = cqe->user_data;
+            int res = cqe->res;
+            int more = cqe->flags & IORING_CQE_F_MORE;
+            if(TAG_KIND(tag) == KIND_CONN){
+                ring_conn_event(n, cqe);
+                uring_cqe_seen(&n->ring);
+                continue;
+            }
+            uring_cqe_seen(&n->ring);
+
+            switch(TAG_KIND(tag)){
+                case KIND_OUTBOUND:
+                    send_outbound(n);
+                    if(!more && arm_poll(n, n->outbound.bell.fd, tag) < 0){
+                        perror("arm_outbound");
+                    }
+                    break;
+                case KIND_LISTEN:
+                    if(res >= 0){
+                        add_conn(n, res);
+                    }
+                    if(!more && arm_accept(n, TAG_VALUE(tag)) < 0){
+                        perror("arm_accept");
+                    }
+                    break;
+                case KIND_SHUTDOWN:
+                    break;
+                default:{
+                    uint64_t conn_tag;
+                    if(server_io_complete(tag, res, &conn_tag)){
+                        connection_t *conn = find_conn(n, conn_tag);
+                        if(conn){
+                            publish_congestion(n, conn);
+                        }
+                    }
+                    break;
+                }
+            }
+        }
+    }
+    uring_fini(&n->ring);
+    server_io_detach();
+    n->use_ring = 0;
+}
+#endif
+
+// ---------------------------- epoll loop ---------------------------- //
+
+// sends the HALTs of the tables that halted last, once the loop is over
+static void finish_network(network_t *n) {
+    send_outbound(n);
+    server_io_cleanup();
+}
+
+static void *network_main(void *arg) {
+    network_t *n = arg;
+    struct epoll_event events[WORKER_MAX_EVENTS];
+
+    pin_thread("network thread", n->index, n->cpu);
+#ifdef POKER_IO_URING
+    if(start_ring(n) == 0){
+        run_ring(n);
+        finish_network(n);
+        return NULL;
+    }
+    perror("[Server] io_uring unavailable, network thread falls back to epoll");
+#endif
+
+    while(running()){
+        int count = epoll_wait(n->epoll_fd, events, WORKER_MAX_EVENTS, -1);
+        if(count < 0){
+            if(errno == EINTR){
+                continue;
+            }
+            perror("epoll_wait");
+            break;
+        }
+        for(int i = 0; i < count; i++){
+            uint64_t tag = events[i].data.u64;
+            if(TAG_KIND(tag) == KIND_OUTBOUND){
+                send_outbound(n);
+                continue;
+            }
+            if(TAG_KIND(tag) == KIND_LISTEN){
+                accept_conns(n, TAG_VALUE(tag) == LISTEN_UNIX ? n->unix_fd : n->listen_fd);
+                continue;
+            }
+            if(TAG_KIND(tag) == KIND_SHUTDOWN){
+                continue;
+            }
+            connection_t *conn = find_conn(n, tag);
+            if(!conn){
+                continue;
+            }
+            if(events[i].events & EPOLLOUT){
+                server_io_writable(conn->fd);
+                publish_congestion(n, conn);
+            }
+            if(events[i].events & ~EPOLLOUT){
+                on_readable(n, conn);
+            }
+        }
+    }
+
+    finish_network(n);
+    return NULL;
+}
+
+// ---------------------------- table manager ---------------------------- //
+
+static int init_network(network_t *n) {
+    n->epoll_fd = epoll_create1(0);
+    if(n->epoll_fd < 0 || outbound_init(&n->outbound) < 0){
+        perror("epoll_create1/eventfd");
+        return -1;
+    }
+    n->listen_fd = open_listener(BASE_PORT);
+    if(n->listen_fd < 0){
+        return -1;
+    }
+    if(n->index == 0){
+        n->unix_fd = open_unix_listener(TRANSPORT_UNIX_PATH);
+    }
+
+    // registered even for a thread that will run on a ring, in case it has to fall back to epoll
+    struct epoll_event oev = { .events = EPOLLIN, .data.u64 = MAKE_TAG(KIND_OUTBOUND, 0) };
+    struct epoll_event sev = { .events = EPOLLIN, .data.u64 = MAKE_TAG(KIND_SHUTDOWN, 0) };
+    struct epoll_event lev = { .events = EPOLLIN, .data.u64 = MAKE_TAG(KIND_LISTEN, LISTEN_TCP) };
+    struct epoll_event uev = { .events = EPOLLIN, .data.u64 = MAKE_TAG(KIND_LISTEN, LISTEN_UNIX) };
+    if(watch_fd(n->epoll_fd, n->outbound.bell.fd, oev) < 0 || watch_fd(n->epoll_fd, shutdown_fd, sev) < 0
+       || watch_fd(n->epoll_fd, n->listen_fd, lev) < 0
+       || (n->unix_fd >= 0 && watch_fd(n->epoll_fd, n->unix_fd, uev) < 0)){
+        perror("epoll_ctl");
+        return -1;
+    }
+    return 0;
+}
+
+static int init_engine(engine_t *e) {
+    e->epoll_fd = epoll_create1(0);
+    e->tick_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+    if(e->epoll_fd < 0 || e->tick_fd < 0 || mpsc_bell_init(&e->bell) < 0){
+        perror("epoll_create1/timerfd_create/eventfd");
+        return -1;
+    }
+    struct epoll_event cev = { .events = EPOLLIN, .data.u64 = MAKE_TAG(KIND_COMMANDS, 0) };
+    struct epoll_event tev = { .events = EPOLLIN, .data.u64 = MAKE_TAG(KIND_TICK, 0) };
+    struct epoll_event sev = { .events = EPOLLIN, .data.u64 = MAKE_TAG(KIND_SHUTDOWN, 0) };
+    struct epoll_event xev = { .events = EPOLLIN, .data.u64 = MAKE_TAG(KIND_STOP, 0) };
+    if(watch_fd(e->epoll_fd, e->bell.fd, cev) < 0 || watch_fd(e->epoll_fd, e->tick_fd, tev) < 0
+       || watch_fd(e->epoll_fd, shutdown_fd, sev) < 0 || watch_fd(e->epoll_fd, stop_fd, xev) < 0){
+        perror("epoll_ctl");
+        return -1;
+    }
+    return 0;
+}
+
+int table_manager_init(int num_tables, int num_workers, int random_seed, const table_config_t *config) {
+    if(num_tables < 1 || num_workers < 1){
+        fprintf(stderr, "[Server] invalid table/worker count\n");
+        return -1;
+    }
+    if(num_workers > num_tables){
+        num_workers = num_tables;
+    }
+
+    tables = calloc(num_tables, sizeof(table_t));
+    networks = calloc(num_workers, sizeof(network_t));
+    engines = calloc(num_workers, sizeof(engine_t));
+    if(!tables || !networks || !engines){
+        perror("calloc");
+        return -1;
+    }
+    table_count = num_tables;
+    worker_count = num_workers;
+    for(int w = 0; w < num_workers; w++){
+        networks[w].index = engines[w].index = w;
+        networks[w].cpu = engines[w].cpu = -1;
+        networks[w].epoll_fd = networks[w].listen_fd = networks[w].unix_fd = -1;
+        networks[w].outbound.bell.fd = engines[w].bell.fd = -1;
+        engines[w].epoll_fd = engines[w].tick_fd = -1;
+        timer_wheel_init(&engines[w].wheel, CLOCK_TICK_MS);
+    }
+
+    for(int t = 0; t < num_tables; t++){
+        engine_t *e = engine_of(t);
+        table_init(&tables[t], t, random_seed + t, config, &e->wheel, &e->bell, table_halted);
+        ++e->live_tables;
+    }
+    live_total = num_tables;
+
+    shutdown_fd = eventfd(0, EFD_NONBLOCK);
+    stop_fd = eventfd(0, EFD_NONBLOCK);
+    if(shutdown_fd < 0 || stop_fd < 0){
+        perror("eventfd");
+        return -1;
+    }
+    for(int w = 0; w < num_workers; w++){
+        if(init_engine(&engines[w]) < 0 || init_network(&networks[w]) < 0){
+            return -1;
+        }
+    }
+    assign_cpus();
+    return 0;
+}
+
+int table_manager_run() {
+    int engines_started = 0, networks_started = 0, ret = 0;
+    for(; engines_started < worker_count; engines_started++){
+        if(pthread_create(&engines[engines_started].thread, NULL, engine_main, &engines[engines_started]) != 0){
+            perror("pthread_create");
+            ret = -1;
+            break;
+        }
+    }
+    for(; ret == 0 && networks_started < worker_count; networks_started++){
+        if(pthread_create(&networks[networks_started].thread, NULL, network_main, &networks[networks_started]) != 0){
+            perror("pthread_create");
+            ret = -1;
+            break;
+        }
+    }
+
+    // the tables of an engine that did not start never halt, so the others are told to stop
+    if(ret < 0){
+        __atomic_store_n(&live_total, 0, __ATOMIC_RELEASE);
+        uint64_t one = 1;
+        if(write(shutdown_fd, &one, sizeof(one)) < 0){
+            perror("write");
+        }
+    }
+    for(int w = 0; w < engines_started; w++){
+        pthread_join(engines[w].thread, NULL);
+    }
+    for(int w = 0; w < networks_started; w++){
+        pthread_join(networks[w].thread, NULL);
+    }
+    return ret;
+}
+
+void table_manager_stop() {
+    uint64_t one = 1;
+    if(stop_fd >= 0){
+        // nothing that is safe in a signal handler could report a failed write
+        ssize_t r = write(stop_fd, &one, sizeof(one));
+        (void)r;
+    }
+}
+
+table_t *table_manager_get(int table_id) {
+    if(table_id < 0 || table_id >= table_count){
+        return NULL;
+    }
+    return &tables[table_id];
+}
+
+static void close_fd(int fd) {
+    if(fd >= 0){
+        close(fd);
+    }
+}
+
+void table_manager_fini() {
+    // the releases still posted free their connections
+    for(int t = 0; t < table_count; t++){
+        table_discard(&tables[t]);
+    }
+    for(int w = 0; w < worker_count; w++){
+        network_t *n = &networks[w];
+        for(int fd = 0; fd < n->conn_cap; fd++){
+            connection_t *conn = n->conns[fd];
+            if(!conn){
+                continue;
+            }
+            close(conn->fd);
+            close_fd(conn->shm_fd);
+            shm_channel_unmap(conn->shm);
+            connection_free(conn);
+        }
+        free(n->conns);
+        close_fd(n->epoll_fd);
+        close_fd(n->listen_fd);
+        if(n->unix_fd >= 0){
+            close(n->unix_fd);
+            unlink(TRANSPORT_UNIX_PATH);
+        }
+        outbound_fini(&n->outbound);
+
+        close_fd(engines[w].epoll_fd);
+        close_fd(engines[w].tick_fd);
+        mpsc_bell_fini(&engines[w].bell);
+    }
+    close_fd(shutdown_fd);
+    close_fd(stop_fd);
+    free(tables);
+    free(networks);
+    free(engines);
+    tables = NULL;
+    networks = NULL;
+    engines = NULL;
+    table_count = worker_count = 0;
+    shutdown_fd = stop_fd = -1;
+}
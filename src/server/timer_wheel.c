@@ -0,0 +1,125 @@
+// timer_wheel.c
+#include <time.h>
+#include <stddef.h>
+
+#include "timer_wheel.h"
+
+#define LEVEL_SPAN(level) (1ull << (WHEEL_BITS * (level)))
+
+uint64_t timer_wheel_clock_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static void list_init(wheel_timer_t *head) {
+    head->next = head->prev = head;
+}
+
+static void unlink_timer(wheel_timer_t *timer) {
+    timer->prev->next = timer->next;
+    timer->next->prev = timer->prev;
+    timer->next = timer->prev = NULL;
+}
+
+// files a timer under the slot of the lowest level whose span still reaches its tick
+static void place(timer_wheel_t *wheel, wheel_timer_t *timer) {
+    uint64_t delta = timer->expires - wheel->now;
+    int level = 0;
+    while(level < WHEEL_LEVELS - 1 && delta >= LEVEL_SPAN(level + 1)){
+        ++level;
+    }
+    uint64_t due = timer->expires;
+    if(delta >= LEVEL_SPAN(WHEEL_LEVELS)){
+        // beyond the top level: park it in the furthest slot, it is re-filed on the way down
+        due = wheel->now + LEVEL_SPAN(WHEEL_LEVELS) - 1;
+    }
+    wheel_timer_t *head = &wheel->slots[level][(due >> (WHEEL_BITS * level)) & (WHEEL_SLOTS - 1)];
+    timer->prev = head->prev;
+    timer->next = head;
+    head->prev->next = timer;
+    head->prev = timer;
+}
+
+// moves every timer of a higher level slot down to where it belongs now
+static void cascade(timer_wheel_t *wheel, int level) {
+    wheel_timer_t *head = &wheel->slots[level][(wheel->now >> (WHEEL_BITS * level)) & (WHEEL_SLOTS - 1)];
+    wheel_timer_t list = *head;
+    if(head->next == head){
+        return;
+    }
+    list.next->prev = &list;
+    list.prev->next = &list;
+    list_init(head);
+    while(list.next != &list){
+        wheel_timer_t *timer = list.next;
+        unlink_timer(timer);
+        place(wheel, timer);
+    }
+}
+
+void timer_wheel_init(timer_wheel_t *wheel, unsigned tick_ms) {
+    for(int l = 0; l < WHEEL_LEVELS; l++){
+        for(int s = 0; s < WHEEL_SLOTS; s++){
+            list_init(&wheel->slots[l][s]);
+        }
+    }
+    wheel->now = 0;
+    wheel->origin_ms = timer_wheel_clock_ms();
+    wheel->tick_ms = tick_ms ? tick_ms : 1;
+    wheel->count = 0;
+}
+
+void wheel_timer_init(wheel_timer_t *timer, void (*fire)(wheel_timer_t *timer)) {
+    timer->next = timer->prev = NULL;
+    timer->expires = 0;
+    timer->fire = fire;
+}
+
+int wheel_timer_armed(const wheel_timer_t *timer) {
+    return timer->next != NULL;
+}
+
+void timer_wheel_add(timer_wheel_t *wheel, wheel_timer_t *timer, uint64_t delay_ms) {
+    timer_wheel_cancel(wheel, timer);
+    uint64_t elapsed = timer_wheel_clock_ms() - wheel->origin_ms;
+    uint64_t due = (elapsed + delay_ms + wheel->tick_ms - 1) / wheel->tick_ms;
+    timer->expires = due > wheel->now ? due : wheel->now + 1;
+    place(wheel, timer);
+    ++wheel->count;
+}
+
+void timer_wheel_cancel(timer_wheel_t *wheel, wheel_timer_t *timer) {
+    if(!wheel_timer_armed(timer)){
+        return;
+    }
+    unlink_timer(timer);
+    --wheel->count;
+}
+
+void timer_wheel_advance(timer_wheel_t *wheel) {
+    uint64_t target = (timer_wheel_clock_ms() - wheel->origin_ms) / wheel->tick_ms;
+    if(wheel->count == 0 && target > wheel->now){
+        wheel->now = target;
+        return;
+    }
+    while(wheel->now < target){
+        ++wheel->now;
+        for(int level = 1; level < WHEEL_LEVELS; level++){
+            if((wheel->now & (LEVEL_SPAN(level) - 1)) != 0){
+                break;
+            }
+            cascade(wheel, level);
+        }
+
+        wheel_timer_t *head = &wheel->slots[0][wheel->now & (WHEEL_SLOTS - 1)];
+        while(head->next != head){
+            wheel_timer_t *timer = head->next;
+            timer_wheel_cancel(wheel, timer);
+            timer->fire(timer);
+        }
+        if(wheel->count == 0){
+            wheel->now = target;
+        }
+    }
+}
@@ -0,0 +1,279 @@
+// uring.c
+// syscall() and the MAP_ flags io_uring needs are outside POSIX
+#define _GNU_SOURCE
+#ifdef POKER_IO_URING
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/syscall.h>
+
+#include "uring.h"
+
+static int sys_setup(unsigned entries, struct io_uring_params *p) {
+    return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int sys_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+    return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+static int sys_register(int fd, unsigned opcode, const void *arg, unsigned nr_args) {
+    return (int)syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+int uring_init(uring_t *ring, unsigned entries) {
+    memset(ring, 0, sizeof(*ring));
+    ring->fd = -1;
+
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    p.flags = IORING_SETUP_CLAMP;
+    int fd = sys_setup(entries, &p);
+    if(fd < 0){
+        return -1;
+    }
+    ring->fd = fd;
+
+    ring->sq_ring_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    ring->cq_ring_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if(p.features & IORING_FEAT_SINGLE_MMAP){
+        if(ring->cq_ring_size > ring->sq_ring_size){
+            ring->sq_ring_size = ring->cq_ring_size;
+        }
+        ring->cq_ring_size = ring->sq_ring_size;
+    }
+
+    ring->sq_ring = mmap(NULL, ring->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if(ring->sq_ring == MAP_FAILED){
+        ring->sq_ring = NULL;
+        uring_fini(ring);
+        return -1;
+    }
+    if(p.features & IORING_FEAT_SINGLE_MMAP){
+        ring->cq_ring = ring->sq_ring;
+    }
+    else{
+        ring->cq_ring = mmap(NULL, ring->cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        if(ring->cq_ring == MAP_FAILED){
+            ring->cq_ring = NULL;
+            uring_fini(ring);
+            return -1;
+        }
+    }
+    ring->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if(ring->sqes == MAP_FAILED){
+        ring->sqes = NULL;
+        uring_fini(ring);
+        return -1;
+    }
+
+    char *sq = ring->sq_ring;
+    ring->sq_head = (unsigned *)(sq + p.sq_off.head);
+    ring->sq_tail = (unsigned *)(sq + p.sq_off.tail);
+    ring->sq_mask = (unsigned *)(sq + p.sq_off.ring_mask);
+    ring->sq_array = (unsigned *)(sq + p.sq_off.array);
+    ring->sq_entries = p.sq_entries;
+
+    char *cq = ring->cq_ring;
+    ring->cq_head = (unsigned *)(cq + p.cq_off.head);
+    ring->cq_tail = (unsigned *)(cq + p.cq_off.tail);
+    ring->cq_mask = (unsigned *)(cq + p.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+    return 0;
+}
+
+void uring_fini(uring_t *ring) {
+    if(ring->buf_ring){
+        struct io_uring_buf_reg reg = { .bgid = ring->buf_group };
+        sys_register(ring->fd, IORING_UNREGISTER_PBUF_RING, &reg, 1);
+        munmap(ring->buf_ring, ring->recv_buf_count * sizeof(struct io_uring_buf));
+    }
+    free(ring->recv_bufs);
+    if(ring->sqes){
+        munmap(ring->sqes, ring->sqes_size);
+    }
+    if(ring->cq_ring && ring->cq_ring != ring->sq_ring){
+        munmap(ring->cq_ring, ring->cq_ring_size);
+    }
+    if(ring->sq_ring){
+        munmap(ring->sq_ring, ring->sq_ring_size);
+    }
+    if(ring->fd >= 0){
+        close(ring->fd);
+    }
+    memset(ring, 0, sizeof(*ring));
+    ring->fd = -1;
+}
+
+struct io_uring_sqe *uring_get_sqe(uring_t *ring) {
+    unsigned head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+    unsigned tail = *ring->sq_tail;
+    if(tail - head >= ring->sq_entries){
+        // the queue is full of work the kernel has not picked up yet
+        if(sys_enter(ring->fd, ring->sq_pending, 0, 0) < 0){
+            return NULL;
+        }
+        ring->sq_pending = 0;
+        head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+        if(tail - head >= ring->sq_entries){
+            return NULL;
+        }
+    }
+    unsigned index = tail & *ring->sq_mask;
+    struct io_uring_sqe *sqe = &ring->sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    ring->sq_array[index] = index;
+    __atomic_store_n(ring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+    ++ring->sq_pending;
+    return sqe;
+}
+
+int uring_submit_and_wait(uring_t *ring, unsigned wait_nr) {
+    unsigned flags = wait_nr > 0 ? IORING_ENTER_GETEVENTS : 0;
+    int r = sys_enter(ring->fd, ring->sq_pending, wait_nr, flags);
+    if(r < 0){
+        return -1;
+    }
+    ring->sq_pending -= (unsigned)r < ring->sq_pending ? (unsigned)r : ring->sq_pending;
+    return 0;
+}
+
+struct io_uring_cqe *uring_peek_cqe(uring_t *ring) {
+    unsigned head = *ring->cq_head;
+    if(head == __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE)){
+        return NULL;
+    }
+    return &ring->cqes[head & *ring->cq_mask];
+}
+
+void uring_cqe_seen(uring_t *ring) {
+    __atomic_store_n(ring->cq_head, *ring->cq_head + 1, __ATOMIC_RELEASE);
+}
+
+// ---------------------------- buffers ---------------------------- //
+
+static void add_recv_buffer(uring_t *ring, unsigned bid, unsigned offset) {
+    unsigned mask = ring->recv_buf_count - 1;
+    struct io_uring_buf *buf = &ring->buf_ring->bufs[(ring->buf_ring->tail + offset) & mask];
+    buf->addr = (uint64_t)(uintptr_t)(ring->recv_bufs + (size_t)bid * ring->recv_buf_size);
+    buf->len = ring->recv_buf_size;
+    buf->bid = (uint16_t)bid;
+}
+
+int uring_setup_recv_buffers(uring_t *ring, int group, unsigned count, unsigned size) {
+    // the kernel wants a power of two number of ring entries
+    if(count == 0 || (count & (count - 1)) != 0){
+        errno = EINVAL;
+        return -1;
+    }
+    size_t ring_bytes = count * sizeof(struct io_uring_buf);
+    void *mem = mmap(NULL, ring_bytes, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+    if(mem == MAP_FAILED){
+        return -1;
+    }
+    ring->recv_bufs = malloc((size_t)count * size);
+    if(!ring->recv_bufs){
+        munmap(mem, ring_bytes);
+        return -1;
+    }
+
+    struct io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = (uint64_t)(uintptr_t)mem;
+    reg.ring_entries = count;
+    reg.bgid = (uint16_t)group;
+    if(sys_register(ring->fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0){
+        munmap(mem, ring_bytes);
+        free(ring->recv_bufs);
+        ring->recv_bufs = NULL;
+        return -1;
+    }
+
+    ring->buf_ring = mem;
+    ring->recv_buf_count = count;
+    ring->recv_buf_size = size;
+    ring->buf_group = group;
+    ring->buf_ring->tail = 0;
+    for(unsigned i = 0; i < count; i++){
+        add_recv_buffer(ring, i, i);
+    }
+    __atomic_store_n(&ring->buf_ring->tail, (uint16_t)count, __ATOMIC_RELEASE);
+    return 0;
+}
+
+const uint8_t *uring_recv_buffer(uring_t *ring, const struct io_uring_cqe *cqe) {
+    unsigned bid = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+    return ring->recv_bufs + (size_t)bid * ring->recv_buf_size;
+}
+
+void uring_recycle_buffer(uring_t *ring, const struct io_uring_cqe *cqe) {
+    if(!(cqe->flags & IORING_CQE_F_BUFFER)){
+        return;
+    }
+    add_recv_buffer(ring, cqe->flags >> IORING_CQE_BUFFER_SHIFT, 0);
+    __atomic_store_n(&ring->buf_ring->tail, (uint16_t)(ring->buf_ring->tail + 1), __ATOMIC_RELEASE);
+}
+
+int uring_register_buffers(uring_t *ring, const struct iovec *iov, unsigned count) {
+    return sys_register(ring->fd, IORING_REGISTER_BUFFERS, iov, count) < 0 ? -1 : 0;
+}
+
+// ---------------------------- requests ---------------------------- //
+
+void uring_prep_accept_multishot(struct io_uring_sqe *sqe, int fd, uint64_t user_data) {
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = fd;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->user_data = user_data;
+}
+
+void uring_prep_recv_multishot(struct io_uring_sqe *sqe, int fd, int group, uint64_t user_data) {
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = fd;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = (uint16_t)group;
+    sqe->user_data = user_data;
+}
+
+void uring_prep_poll(struct io_uring_sqe *sqe, int fd, uint64_t user_data) {
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = fd;
+    sqe->poll32_events = POLLIN;
+    sqe->user_data = user_data;
+}
+
+void uring_prep_poll_multishot(struct io_uring_sqe *sqe, int fd, uint64_t user_data) {
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = fd;
+    sqe->poll32_events = POLLIN;
+    sqe->len = IORING_POLL_ADD_MULTI;
+    sqe->user_data = user_data;
+}
+
+void uring_prep_send(struct io_uring_sqe *sqe, int fd, const void *buf, size_t len, uint64_t user_data) {
+    sqe->opcode = IORING_OP_SEND;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t)(uintptr_t)buf;
+    sqe->len = (uint32_t)len;
+    sqe->msg_flags = MSG_NOSIGNAL;
+    sqe->user_data = user_data;
+}
+
+void uring_prep_write_fixed(struct io_uring_sqe *sqe, int fd, const void *buf, size_t len, int buf_index, uint64_t user_data) {
+    sqe->opcode = IORING_OP_WRITE_FIXED;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t)(uintptr_t)buf;
+    sqe->len = (uint32_t)len;
+    sqe->buf_index = (uint16_t)buf_index;
+    sqe->user_data = user_data;
+}
+
+#endif
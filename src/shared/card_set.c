@@ -0,0 +1,59 @@
+#include "card_set.h"
+
+card_set_t card_set_of(const card_t *cards, int n)
+{
+    card_set_t set = CARD_SET_EMPTY;
+    for (int i = 0; i < n; i++) {
+        if (cards[i] != NOCARD)
+            set |= CARD_SET_BIT(cards[i]);
+    }
+    return set;
+}
+
+int card_set_count(card_set_t set)
+{
+    return __builtin_popcountll(set);
+}
+
+card_t card_set_card(int bit)
+{
+    return ((bit % CARD_SET_LANE) << SUITE_BITS) | (bit / CARD_SET_LANE);
+}
+
+card_t card_set_first(card_set_t set)
+{
+    return set ? card_set_card(__builtin_ctzll(set)) : NOCARD;
+}
+
+card_t card_set_nth(card_set_t set, int n)
+{
+    // the lane is found by popcounts, then the bits below the card are dropped one by one
+    for (int lane = 0; lane < 4; lane++) {
+        card_set_t cards = set & ((card_set_t)0xFFFF << (CARD_SET_LANE * lane));
+        int count = card_set_count(cards);
+        if (n < count) {
+            while (n-- > 0)
+                cards &= cards - 1;
+            return card_set_first(cards);
+        }
+        n -= count;
+    }
+    return NOCARD;
+}
+
+int card_set_cards(card_set_t set, card_t *cards)
+{
+    int n = 0;
+    for (; set; set &= set - 1)
+        cards[n++] = card_set_first(set);
+    return n;
+}
+
+card_set_t card_set_permute_suits(card_set_t set, const int perm[4])
+{
+    // a suit is a lane, so relabelling one moves its 16 bits as they are
+    card_set_t out = CARD_SET_EMPTY;
+    for (int s = 0; s < 4; s++)
+        out |= (card_set_t)CARD_SET_SUIT(set, s) << (CARD_SET_LANE * perm[s]);
+    return out;
+}
@@ -0,0 +1,88 @@
+#include "frame_reader.h"
+
+#include <string.h>
+#include <sys/socket.h>
+
+void frame_reader_init(frame_reader_t *rd)
+{
+    rd->start = 0;
+    rd->end = 0;
+}
+
+// slides the partial frame to the front once the tail of the buffer runs short of want
+static void make_room(frame_reader_t *rd, size_t want)
+{
+    if (rd->start == rd->end) {
+        rd->start = rd->end = 0;
+    }
+    else if (sizeof(rd->buf) - rd->end < want) {
+        memmove(rd->buf, rd->buf + rd->start, rd->end - rd->start);
+        rd->end -= rd->start;
+        rd->start = 0;
+    }
+}
+
+ssize_t frame_reader_fill(frame_reader_t *rd, int fd, int flags)
+{
+    make_room(rd, WIRE_MAX_FRAME);
+    ssize_t r = recv(fd, rd->buf + rd->end, sizeof(rd->buf) - rd->end, flags);
+    if (r > 0)
+        rd->end += r;
+    return r;
+}
+
+ssize_t frame_reader_fill_fd(frame_reader_t *rd, int fd, int flags, int *passed)
+{
+    union {
+        struct cmsghdr align;
+        char buf[CMSG_SPACE(sizeof(int))];
+    } control;
+    make_room(rd, WIRE_MAX_FRAME);
+    struct iovec iov = { rd->buf + rd->end, sizeof(rd->buf) - rd->end };
+    struct msghdr msg = { .msg_iov = &iov, .msg_iovlen = 1, .msg_control = control.buf, .msg_controllen = sizeof(control.buf) };
+    ssize_t r = recvmsg(fd, &msg, flags | MSG_CMSG_CLOEXEC);
+    if (r <= 0)
+        return r;
+    rd->end += r;
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    if (cmsg && cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS && cmsg->cmsg_len == CMSG_LEN(sizeof(int)))
+        memcpy(passed, CMSG_DATA(cmsg), sizeof(int));
+    return r;
+}
+
+ssize_t frame_reader_fill_ring(frame_reader_t *rd, shm_ring_t *ring)
+{
+    make_room(rd, WIRE_MAX_FRAME);
+    ssize_t r = shm_ring_read(ring, rd->buf + rd->end, sizeof(rd->buf) - rd->end);
+    if (r > 0)
+        rd->end += r;
+    return r;
+}
+
+int frame_reader_push(frame_reader_t *rd, const uint8_t *data, size_t len)
+{
+    make_room(rd, len);
+    if (sizeof(rd->buf) - rd->end < len)
+        return -1;
+    memcpy(rd->buf + rd->end, data, len);
+    rd->end += len;
+    return 0;
+}
+
+int frame_reader_next_client(frame_reader_t *rd, client_packet_t *pkt)
+{
+    int size = wire_decode_client(rd->buf + rd->start, rd->end - rd->start, pkt);
+    if (size <= 0)
+        return size;
+    rd->start += size;
+    return 1;
+}
+
+int frame_reader_next_server(frame_reader_t *rd, server_packet_t *pkt)
+{
+    int size = wire_decode_server(rd->buf + rd->start, rd->end - rd->start, pkt);
+    if (size <= 0)
+        return size;
+    rd->start += size;
+    return 1;
+}
@@ -0,0 +1,62 @@
+#include "preflop_table.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+int preflop_class(card_t a, card_t b)
+{
+    int hi = RANK(a) > RANK(b) ? RANK(a) : RANK(b);
+    int lo = RANK(a) > RANK(b) ? RANK(b) : RANK(a);
+    if (SUITE(a) == SUITE(b))
+        return hi * 13 + lo;
+    return lo * 13 + hi;
+}
+
+uint64_t preflop_checksum(const preflop_file_t *file)
+{
+    const unsigned char *bytes = (const unsigned char *)file + sizeof(preflop_header_t);
+    uint64_t hash = 0xCBF29CE484222325ull;
+    for (size_t i = 0; i < sizeof(preflop_file_t) - sizeof(preflop_header_t); i++) {
+        hash ^= bytes[i];
+        hash *= 0x100000001B3ull;
+    }
+    return hash;
+}
+
+int preflop_table_open(preflop_table_t *table, const char *path)
+{
+    table->file = NULL;
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return -1;
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size != (off_t)sizeof(preflop_file_t)) {
+        close(fd);
+        return -1;
+    }
+    // a shared read-only mapping comes straight from the page cache, so every process on the
+    // host that opens the table reads the same pages
+    const preflop_file_t *file = mmap(NULL, sizeof(preflop_file_t), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (file == MAP_FAILED)
+        return -1;
+
+    const preflop_header_t *h = &file->header;
+    if (h->magic != PREFLOP_MAGIC || h->version != PREFLOP_VERSION || h->classes != PREFLOP_CLASSES
+        || h->max_players != MAX_PLAYERS || h->checksum != preflop_checksum(file)) {
+        munmap((void *)file, sizeof(preflop_file_t));
+        return -1;
+    }
+    table->file = file;
+    return 0;
+}
+
+void preflop_table_close(preflop_table_t *table)
+{
+    if (table->file == NULL)
+        return;
+    munmap((void *)table->file, sizeof(preflop_file_t));
+    table->file = NULL;
+}
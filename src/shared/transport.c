@@ -0,0 +1,134 @@
+// memfd_create() and syscall() are outside POSIX
+#define _GNU_SOURCE
+#include "transport.h"
+
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+shm_channel_t *shm_channel_create(int *fd)
+{
+    int mfd = memfd_create("poker_seat", MFD_CLOEXEC);
+    if (mfd < 0)
+        return NULL;
+    if (ftruncate(mfd, sizeof(shm_channel_t)) < 0) {
+        close(mfd);
+        return NULL;
+    }
+    shm_channel_t *channel = mmap(NULL, sizeof(shm_channel_t), PROT_READ | PROT_WRITE, MAP_SHARED, mfd, 0);
+    if (channel == MAP_FAILED) {
+        close(mfd);
+        return NULL;
+    }
+    // a new memfd reads as zeros: both rings are empty and nobody is waiting
+    *fd = mfd;
+    return channel;
+}
+
+shm_channel_t *shm_channel_map(int fd)
+{
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size < (off_t)sizeof(shm_channel_t))
+        return NULL;
+    shm_channel_t *channel = mmap(NULL, sizeof(shm_channel_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    return channel == MAP_FAILED ? NULL : channel;
+}
+
+void shm_channel_unmap(shm_channel_t *channel)
+{
+    if (channel)
+        munmap(channel, sizeof(shm_channel_t));
+}
+
+// the other side of the ring is not trusted: a fill level past the ring size means it is corrupt
+ssize_t shm_ring_used(shm_ring_t *ring)
+{
+    uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    uint32_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+    uint32_t used = tail - head;
+    return used > SHM_RING_SIZE ? -1 : (ssize_t)used;
+}
+
+ssize_t shm_ring_write(shm_ring_t *ring, const void *buf, size_t len)
+{
+    ssize_t used = shm_ring_used(ring);
+    if (used < 0)
+        return -1;
+    size_t room = SHM_RING_SIZE - used;
+    if (len > room)
+        len = room;
+    uint32_t tail = ring->tail;
+    size_t at = tail % SHM_RING_SIZE;
+    size_t first = SHM_RING_SIZE - at < len ? SHM_RING_SIZE - at : len;
+    memcpy(ring->data + at, buf, first);
+    memcpy(ring->data, (const uint8_t *)buf + first, len - first);
+    __atomic_store_n(&ring->tail, tail + (uint32_t)len, __ATOMIC_RELEASE);
+    return (ssize_t)len;
+}
+
+ssize_t shm_ring_read(shm_ring_t *ring, void *buf, size_t cap)
+{
+    ssize_t used = shm_ring_used(ring);
+    if (used < 0)
+        return -1;
+    size_t len = (size_t)used < cap ? (size_t)used : cap;
+    uint32_t head = ring->head;
+    size_t at = head % SHM_RING_SIZE;
+    size_t first = SHM_RING_SIZE - at < len ? SHM_RING_SIZE - at : len;
+    memcpy(buf, ring->data + at, first);
+    memcpy((uint8_t *)buf + first, ring->data, len - first);
+    __atomic_store_n(&ring->head, head + (uint32_t)len, __ATOMIC_RELEASE);
+    return (ssize_t)len;
+}
+
+// the flag is set before the ring is checked again, and the producer clears it after
+// writing: one of the two always sees the other, so no wakeup is lost
+int shm_ring_park(shm_ring_t *ring)
+{
+    __atomic_store_n(&ring->waiting, 1, __ATOMIC_SEQ_CST);
+    if (shm_ring_used(ring) != 0) {
+        __atomic_store_n(&ring->waiting, 0, __ATOMIC_SEQ_CST);
+        return 1;
+    }
+    return 0;
+}
+
+int shm_ring_take_waiter(shm_ring_t *ring)
+{
+    return __atomic_exchange_n(&ring->waiting, 0, __ATOMIC_SEQ_CST) != 0;
+}
+
+void shm_ring_wait(shm_ring_t *ring, uint32_t tail, int timeout_ms)
+{
+    struct timespec ts = { .tv_sec = timeout_ms / 1000, .tv_nsec = (timeout_ms % 1000) * 1000000L };
+    // the channel is shared between processes, so these are not the _PRIVATE futex ops
+    syscall(SYS_futex, &ring->tail, FUTEX_WAIT, tail, &ts, NULL, 0);
+}
+
+void shm_ring_wake(shm_ring_t *ring)
+{
+    syscall(SYS_futex, &ring->tail, FUTEX_WAKE, 1, NULL, NULL, 0);
+}
+
+ssize_t transport_send_fd(int sock, const void *buf, size_t len, int fd)
+{
+    union {
+        struct cmsghdr align;
+        char buf[CMSG_SPACE(sizeof(int))];
+    } control;
+    memset(&control, 0, sizeof(control));
+    struct iovec iov = { (void *)buf, len };
+    struct msghdr msg = { .msg_iov = &iov, .msg_iovlen = 1, .msg_control = control.buf, .msg_controllen = sizeof(control.buf) };
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+    return sendmsg(sock, &msg, MSG_NOSIGNAL);
+}
@@ -0,0 +1,423 @@
+#include "wire.h"
+
+#include <string.h>
+
+#define WIRE_NOCARD 0xFF
+
+typedef struct {
+    uint8_t *p;
+    uint8_t *end;
+    int ok;
+} writer_t;
+
+typedef struct {
+    const uint8_t *p;
+    const uint8_t *end;
+    int ok;
+} reader_t;
+
+// ---------------------------- primitives ---------------------------- //
+
+static void put_u8(writer_t *w, uint8_t v)
+{
+    if (w->p >= w->end) {
+        w->ok = 0;
+        return;
+    }
+    *w->p++ = v;
+}
+
+static void put_uint(writer_t *w, uint32_t v)
+{
+    while (v >= 0x80) {
+        put_u8(w, (uint8_t)(v | 0x80));
+        v >>= 7;
+    }
+    put_u8(w, (uint8_t)v);
+}
+
+static void put_int(writer_t *w, int v)
+{
+    put_uint(w, ((uint32_t)v << 1) ^ (uint32_t)(v >> 31));
+}
+
+static void put_card(writer_t *w, card_t card)
+{
+    put_u8(w, wire_card(card));
+}
+
+static uint8_t get_u8(reader_t *r)
+{
+    if (r->p >= r->end) {
+        r->ok = 0;
+        return 0;
+    }
+    return *r->p++;
+}
+
+static uint32_t get_uint(reader_t *r)
+{
+    uint32_t v = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+        uint8_t b = get_u8(r);
+        v |= (uint32_t)(b & 0x7F) << shift;
+        if (!(b & 0x80))
+            return v;
+    }
+    r->ok = 0;
+    return 0;
+}
+
+static int get_int(reader_t *r)
+{
+    uint32_t z = get_uint(r);
+    return (int)((z >> 1) ^ (~(z & 1) + 1));
+}
+
+static card_t get_card(reader_t *r)
+{
+    uint8_t b = get_u8(r);
+    if (b == WIRE_NOCARD)
+        return NOCARD;
+    if (b >= DECK_SIZE)
+        r->ok = 0;
+    return b;
+}
+
+// ---------------------------- framing ---------------------------- //
+
+static writer_t begin_frame(wire_buf_t *out, int type)
+{
+    out->bytes[2] = WIRE_VERSION;
+    out->bytes[3] = (uint8_t)type;
+    writer_t w = { out->bytes + WIRE_HEADER_SIZE, out->bytes + WIRE_MAX_FRAME, 1 };
+    return w;
+}
+
+static int end_frame(wire_buf_t *out, writer_t *w)
+{
+    if (!w->ok)
+        return -1;
+    size_t body = w->p - (out->bytes + WIRE_HEADER_SIZE);
+    out->bytes[0] = (uint8_t)(body >> 8);
+    out->bytes[1] = (uint8_t)body;
+    out->len = WIRE_HEADER_SIZE + body;
+    return (int)out->len;
+}
+
+// checks the header and sets up a reader over the body of the frame
+static int open_frame(const uint8_t *buf, size_t len, reader_t *r, int *type)
+{
+    if (len < WIRE_HEADER_SIZE)
+        return 0;
+    size_t body = ((size_t)buf[0] << 8) | buf[1];
+    if (body > WIRE_MAX_BODY || buf[2] != WIRE_VERSION)
+        return -1;
+    if (len < WIRE_HEADER_SIZE + body)
+        return 0;
+    *type = buf[3];
+    r->p = buf + WIRE_HEADER_SIZE;
+    r->end = r->p + body;
+    r->ok = 1;
+    return (int)(WIRE_HEADER_SIZE + body);
+}
+
+size_t wire_bytes_wanted(const uint8_t *buf, size_t have)
+{
+    if (have < WIRE_HEADER_SIZE)
+        return WIRE_HEADER_SIZE - have;
+    size_t body = ((size_t)buf[0] << 8) | buf[1];
+    if (body > WIRE_MAX_BODY)
+        return 0;   // let the decoder reject it
+    size_t total = WIRE_HEADER_SIZE + body;
+    return have < total ? total - have : 0;
+}
+
+uint8_t wire_card(card_t card)
+{
+    return (card >= 0 && card < DECK_SIZE) ? (uint8_t)card : WIRE_NOCARD;
+}
+
+// ---------------------------- client packets ---------------------------- //
+
+// how many params each client packet type carries
+static int client_param_count(client_packet_type_t type)
+{
+    switch (type) {
+        case JOIN:   return 3;
+        case RESUME: return 3;
+        case RAISE:  return 1;
+        default:     return 0;
+    }
+}
+
+int wire_encode_client(const client_packet_t *pkt, wire_buf_t *out)
+{
+    if (pkt->packet_type < JOIN || pkt->packet_type > RESUME)
+        return -1;
+    writer_t w = begin_frame(out, pkt->packet_type);
+    put_int(&w, pkt->seq);
+    for (int i = 0; i < client_param_count(pkt->packet_type); i++)
+        put_int(&w, pkt->params[i]);
+    return end_frame(out, &w);
+}
+
+int wire_decode_client(const uint8_t *buf, size_t len, client_packet_t *pkt)
+{
+    reader_t r;
+    int type;
+    int size = open_frame(buf, len, &r, &type);
+    if (size <= 0)
+        return size;
+    if (type > RESUME)
+        return -1;
+
+    memset(pkt, 0, sizeof(*pkt));
+    pkt->packet_type = type;
+    pkt->seq = get_int(&r);
+    for (int i = 0; i < client_param_count(type); i++)
+        pkt->params[i] = get_int(&r);
+    return r.ok ? size : -1;
+}
+
+// ---------------------------- server packets ---------------------------- //
+
+static void put_status(writer_t *w, const int status[MAX_PLAYERS])
+{
+    for (int i = 0; i < MAX_PLAYERS; i++)
+        put_u8(w, (uint8_t)status[i]);
+}
+
+static void put_info(writer_t *w, const info_packet_t *info)
+{
+    // the hole cards go first, see WIRE_INFO_CARDS_OFFSET
+    put_card(w, info->player_cards[0]);
+    put_card(w, info->player_cards[1]);
+    for (int i = 0; i < 5; i++)
+        put_card(w, info->community_cards[i]);
+    for (int i = 0; i < MAX_PLAYERS; i++)
+        put_int(w, info->player_stacks[i]);
+    put_int(w, info->pot_size);
+    put_int(w, info->dealer);
+    put_int(w, info->player_turn);
+    put_int(w, info->bet_size);
+    for (int i = 0; i < MAX_PLAYERS; i++)
+        put_int(w, info->player_bets[i]);
+    put_status(w, info->player_status);
+    put_int(w, info->version);
+}
+
+static void put_delta(writer_t *w, const delta_packet_t *delta)
+{
+    const info_packet_t *s = &delta->state;
+    put_int(w, delta->base_version);
+    put_uint(w, delta->changed);
+    if (delta->changed & DELTA_COMMUNITY)
+        for (int i = 0; i < 5; i++)
+            put_card(w, s->community_cards[i]);
+    if (delta->changed & DELTA_POT)
+        put_int(w, s->pot_size);
+    if (delta->changed & DELTA_DEALER)
+        put_int(w, s->dealer);
+    if (delta->changed & DELTA_TURN)
+        put_int(w, s->player_turn);
+    if (delta->changed & DELTA_BET_SIZE)
+        put_int(w, s->bet_size);
+    for (int i = 0; i < MAX_PLAYERS; i++) {
+        if (delta->changed & DELTA_STACK(i))
+            put_int(w, s->player_stacks[i]);
+        if (delta->changed & DELTA_BET(i))
+            put_int(w, s->player_bets[i]);
+        if (delta->changed & DELTA_STATUS(i))
+            put_u8(w, (uint8_t)s->player_status[i]);
+    }
+    put_int(w, s->version);
+}
+
+static void put_end(writer_t *w, const end_packet_t *end)
+{
+    for (int i = 0; i < MAX_PLAYERS; i++) {
+        put_card(w, end->player_cards[i][0]);
+        put_card(w, end->player_cards[i][1]);
+    }
+    for (int i = 0; i < 5; i++)
+        put_card(w, end->community_cards[i]);
+    for (int i = 0; i < MAX_PLAYERS; i++)
+        put_int(w, end->player_stacks[i]);
+    put_int(w, end->pot_size);
+    put_int(w, end->dealer);
+    put_int(w, end->winner);
+    put_status(w, end->player_status);
+}
+
+static void put_equity(writer_t *w, const equity_packet_t *equity)
+{
+    put_u8(w, (uint8_t)equity->all_in);
+    put_u8(w, (uint8_t)equity->board_cards);
+    for (int i = 0; i < MAX_PLAYERS; i++) {
+        put_int(w, equity->equity[i]);
+        put_int(w, equity->margin[i]);
+        put_int(w, equity->strength[i]);
+    }
+}
+
+static void get_status(reader_t *r, int status[MAX_PLAYERS])
+{
+    for (int i = 0; i < MAX_PLAYERS; i++)
+        status[i] = get_u8(r);
+}
+
+static void get_info(reader_t *r, info_packet_t *info)
+{
+    info->player_cards[0] = get_card(r);
+    info->player_cards[1] = get_card(r);
+    for (int i = 0; i < 5; i++)
+        info->community_cards[i] = get_card(r);
+    for (int i = 0; i < MAX_PLAYERS; i++)
+        info->player_stacks[i] = get_int(r);
+    info->pot_size = get_int(r);
+    info->dealer = get_int(r);
+    info->player_turn = get_int(r);
+    info->bet_size = get_int(r);
+    for (int i = 0; i < MAX_PLAYERS; i++)
+        info->player_bets[i] = get_int(r);
+    get_status(r, info->player_status);
+    info->version = get_int(r);
+}
+
+static void get_delta(reader_t *r, delta_packet_t *delta)
+{
+    info_packet_t *s = &delta->state;
+    delta->base_version = get_int(r);
+    delta->changed = get_uint(r);
+    if (delta->changed & DELTA_COMMUNITY)
+        for (int i = 0; i < 5; i++)
+            s->community_cards[i] = get_card(r);
+    if (delta->changed & DELTA_POT)
+        s->pot_size = get_int(r);
+    if (delta->changed & DELTA_DEALER)
+        s->dealer = get_int(r);
+    if (delta->changed & DELTA_TURN)
+        s->player_turn = get_int(r);
+    if (delta->changed & DELTA_BET_SIZE)
+        s->bet_size = get_int(r);
+    for (int i = 0; i < MAX_PLAYERS; i++) {
+        if (delta->changed & DELTA_STACK(i))
+            s->player_stacks[i] = get_int(r);
+        if (delta->changed & DELTA_BET(i))
+            s->player_bets[i] = get_int(r);
+        if (delta->changed & DELTA_STATUS(i))
+            s->player_status[i] = get_u8(r);
+    }
+    s->version = get_int(r);
+}
+
+static void get_end(reader_t *r, end_packet_t *end)
+{
+    for (int i = 0; i < MAX_PLAYERS; i++) {
+        end->player_cards[i][0] = get_card(r);
+        end->player_cards[i][1] = get_card(r);
+    }
+    for (int i = 0; i < 5; i++)
+        end->community_cards[i] = get_card(r);
+    for (int i = 0; i < MAX_PLAYERS; i++)
+        end->player_stacks[i] = get_int(r);
+    end->pot_size = get_int(r);
+    end->dealer = get_int(r);
+    end->winner = get_int(r);
+    get_status(r, end->player_status);
+}
+
+static void get_equity(reader_t *r, equity_packet_t *equity)
+{
+    equity->all_in = get_u8(r);
+    equity->board_cards = get_u8(r);
+    for (int i = 0; i < MAX_PLAYERS; i++) {
+        equity->equity[i] = get_int(r);
+        equity->margin[i] = get_int(r);
+        equity->strength[i] = get_int(r);
+    }
+}
+
+int wire_encode_server(const server_packet_t *pkt, wire_buf_t *out)
+{
+    writer_t w = begin_frame(out, pkt->packet_type);
+    switch (pkt->packet_type) {
+        case ACK:
+        case NACK:
+            put_int(&w, pkt->seq);
+            break;
+        case HALT:
+            break;
+        case INFO:
+            put_info(&w, &pkt->info);
+            break;
+        case END:
+            put_end(&w, &pkt->end);
+            break;
+        case DELTA:
+            put_delta(&w, &pkt->delta);
+            break;
+        case EQUITY:
+            put_equity(&w, &pkt->equity);
+            break;
+        default:
+            return -1;
+    }
+    return end_frame(out, &w);
+}
+
+int wire_encode_join_ack(int seq, const join_packet_t *join, wire_buf_t *out)
+{
+    writer_t w = begin_frame(out, ACK);
+    put_int(&w, seq);
+    put_int(&w, join->table_id);
+    put_int(&w, join->player_id);
+    put_int(&w, join->token);
+    put_int(&w, join->last_seq);
+    put_int(&w, join->last_accepted);
+    return end_frame(out, &w);
+}
+
+int wire_decode_server(const uint8_t *buf, size_t len, server_packet_t *pkt)
+{
+    reader_t r;
+    int type;
+    int size = open_frame(buf, len, &r, &type);
+    if (size <= 0)
+        return size;
+
+    pkt->packet_type = type;
+    switch (type) {
+        case ACK:
+            pkt->seq = get_int(&r);
+            if (r.p < r.end) {
+                pkt->join.table_id = get_int(&r);
+                pkt->join.player_id = get_int(&r);
+                pkt->join.token = get_int(&r);
+                pkt->join.last_seq = get_int(&r);
+                pkt->join.last_accepted = get_int(&r);
+            }
+            break;
+        case NACK:
+            pkt->seq = get_int(&r);
+            break;
+        case HALT:
+            break;
+        case INFO:
+            get_info(&r, &pkt->info);
+            break;
+        case END:
+            get_end(&r, &pkt->end);
+            break;
+        case DELTA:
+            get_delta(&r, &pkt->delta);
+            break;
+        case EQUITY:
+            get_equity(&r, &pkt->equity);
+            break;
+        default:
+            return -1;
+    }
+    return r.ok ? size : -1;
+}
@@ -0,0 +1,159 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+extern "C" {
+#include "timer_wheel.h"
+}
+
+// ticks long enough that the real time the test takes never moves a due tick: a delay of
+// k ticks is asked for as k - 1/2 and the clock is set to the middle of a tick
+static const unsigned TICK_MS = 100000;
+
+#define SPAN(level) (1ull << (WHEEL_BITS * (level)))
+
+typedef struct {
+    wheel_timer_t node;
+    timer_wheel_t *wheel;
+    uint64_t fired_at;                      // 0 until it fires
+    int fired;
+    wheel_timer_t *cancels;                 // cancelled by fire, if set
+} test_timer_t;
+
+static void record(wheel_timer_t *timer) {
+    test_timer_t *t = (test_timer_t *)((char *)timer - offsetof(test_timer_t, node));
+    t->fired_at = t->wheel->now;
+    t->fired++;
+    if (t->cancels) {
+        timer_wheel_cancel(t->wheel, t->cancels);
+    }
+}
+
+class TimerWheelTest : public ::testing::Test {
+protected:
+    timer_wheel_t wheel;
+
+    void SetUp() override {
+        timer_wheel_init(&wheel, TICK_MS);
+        wheel.origin_ms = timer_wheel_clock_ms() - TICK_MS / 2;
+    }
+
+    void arm(test_timer_t *t, uint64_t ticks) {
+        *t = {};
+        t->wheel = &wheel;
+        wheel_timer_init(&t->node, record);
+        timer_wheel_add(&wheel, &t->node, ticks * TICK_MS - TICK_MS / 2);
+    }
+
+    // runs the wheel up to tick
+    void run_to(uint64_t tick) {
+        wheel.origin_ms = timer_wheel_clock_ms() - tick * TICK_MS - TICK_MS / 2;
+        timer_wheel_advance(&wheel);
+        ASSERT_EQ(wheel.now, tick);
+    }
+};
+
+// timers due on either side of each level boundary come down the levels and fire on their tick
+TEST_F(TimerWheelTest, CascadedTimersFireOnTheirTick) {
+    std::vector<uint64_t> delays;
+    for (int level = 1; level <= WHEEL_LEVELS; level++) {
+        delays.push_back(SPAN(level) - 1);
+        delays.push_back(SPAN(level));
+        delays.push_back(SPAN(level) + 1);
+    }
+    delays.push_back(1);
+    delays.push_back(3 * SPAN(2) + 5 * SPAN(1) + 7);
+    std::vector<test_timer_t> timers(delays.size());
+    for (size_t i = 0; i < delays.size(); i++) {
+        arm(&timers[i], delays[i]);
+        ASSERT_EQ(timers[i].node.expires, delays[i]);
+    }
+    EXPECT_EQ(wheel.count, (int)delays.size());
+
+    std::vector<uint64_t> order = delays;
+    std::sort(order.begin(), order.end());
+    for (uint64_t due : order) {
+        run_to(due - 1);
+        for (size_t i = 0; i < delays.size(); i++) {
+            ASSERT_EQ(timers[i].fired, delays[i] <= due - 1) << "due " << delays[i] << " at " << due - 1;
+        }
+        run_to(due);
+        for (size_t i = 0; i < delays.size(); i++) {
+            ASSERT_EQ(timers[i].fired, delays[i] <= due) << "due " << delays[i] << " at " << due;
+            if (timers[i].fired) {
+                EXPECT_EQ(timers[i].fired_at, delays[i]);
+            }
+        }
+    }
+    EXPECT_EQ(wheel.count, 0);
+}
+
+// a timer armed part way through a level's span still lines up with the slots of that level
+TEST_F(TimerWheelTest, ArmedAfterTheWheelHasTurned) {
+    run_to(SPAN(1) + 17);
+    test_timer_t t;
+    arm(&t, SPAN(2) + 3);
+    run_to(t.node.expires - 1);
+    EXPECT_EQ(t.fired, 0);
+    run_to(t.node.expires);
+    EXPECT_EQ(t.fired, 1);
+    EXPECT_EQ(t.fired_at, SPAN(1) + 17 + SPAN(2) + 3);
+}
+
+TEST_F(TimerWheelTest, CancelWhileArmed) {
+    test_timer_t high, moved, low;
+    arm(&high, SPAN(2) + 5);
+    arm(&moved, SPAN(2) + 5);
+    arm(&low, 10);
+    EXPECT_TRUE(wheel_timer_armed(&high.node));
+
+    // one cancelled while still on level 2, the other after it has cascaded to level 0
+    timer_wheel_cancel(&wheel, &high.node);
+    EXPECT_FALSE(wheel_timer_armed(&high.node));
+    EXPECT_EQ(wheel.count, 2);
+    run_to(SPAN(2));
+    EXPECT_EQ(low.fired, 1);
+    EXPECT_TRUE(wheel_timer_armed(&moved.node));
+    timer_wheel_cancel(&wheel, &moved.node);
+    EXPECT_EQ(wheel.count, 0);
+    // cancelling twice does nothing
+    timer_wheel_cancel(&wheel, &moved.node);
+    EXPECT_EQ(wheel.count, 0);
+
+    run_to(2 * SPAN(2));
+    EXPECT_EQ(high.fired, 0);
+    EXPECT_EQ(moved.fired, 0);
+}
+
+// a timer that fires cancels one due on the same tick and one further out
+TEST_F(TimerWheelTest, CancelFromInsideFire) {
+    test_timer_t first, same_tick, later;
+    arm(&first, 100);
+    arm(&same_tick, 100);
+    arm(&later, SPAN(2) + 1);
+    first.cancels = &same_tick.node;
+    run_to(100);
+    EXPECT_EQ(first.fired, 1);
+    EXPECT_EQ(same_tick.fired, 0);
+    EXPECT_EQ(wheel.count, 1);
+
+    arm(&first, 1);
+    first.cancels = &later.node;
+    run_to(SPAN(2) + 200);
+    EXPECT_EQ(first.fired, 1);
+    EXPECT_EQ(later.fired, 0);
+    EXPECT_EQ(wheel.count, 0);
+}
+
+// arming an armed timer again moves it rather than arming it twice
+TEST_F(TimerWheelTest, RearmingMovesTheTimer) {
+    test_timer_t t;
+    arm(&t, SPAN(1) + 2);
+    timer_wheel_add(&wheel, &t.node, 5 * TICK_MS - TICK_MS / 2);
+    EXPECT_EQ(wheel.count, 1);
+    run_to(5);
+    EXPECT_EQ(t.fired, 1);
+    run_to(SPAN(1) + 10);
+    EXPECT_EQ(t.fired, 1);
+}
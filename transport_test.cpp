@@ -0,0 +1,218 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+
+extern "C" {
+#include "transport.h"
+}
+
+// the byte at position i of the stream written through a ring
+static uint8_t pattern(uint64_t i) {
+    return (uint8_t)(i * 131 + (i >> 8));
+}
+
+class ShmRingTest : public ::testing::Test {
+protected:
+    shm_channel_t *channel;
+    int fd;
+
+    void SetUp() override {
+        channel = shm_channel_create(&fd);
+        ASSERT_NE(channel, nullptr);
+    }
+
+    void TearDown() override {
+        shm_channel_unmap(channel);
+        close(fd);
+    }
+};
+
+// writes and reads of sizes that do not divide the ring, so copies are split at its end
+TEST_F(ShmRingTest, WrapsAroundTheEnd) {
+    shm_ring_t *ring = &channel->to_server;
+    std::vector<uint8_t> out(SHM_RING_SIZE), in(SHM_RING_SIZE);
+    uint64_t written = 0, read = 0;
+    size_t sizes[] = {1, 1000, 4095, 40000, SHM_RING_SIZE - 3, 17};
+    for (int round = 0; round < 200; round++) {
+        size_t len = sizes[round % 6];
+        for (size_t i = 0; i < len; i++) {
+            out[i] = pattern(written + i);
+        }
+        ssize_t w = shm_ring_write(ring, out.data(), len);
+        ASSERT_GE(w, 0);
+        ASSERT_LE(written + w - read, (uint64_t)SHM_RING_SIZE);
+        written += w;
+
+        ssize_t r = shm_ring_read(ring, in.data(), sizes[(round + 2) % 6]);
+        ASSERT_GE(r, 0);
+        for (ssize_t i = 0; i < r; i++) {
+            ASSERT_EQ(in[i], pattern(read + i)) << "byte " << read + i;
+        }
+        read += r;
+    }
+    EXPECT_GT(written, 10ull * SHM_RING_SIZE);
+    EXPECT_EQ(shm_ring_used(ring), (ssize_t)(written - read));
+}
+
+// head and tail run past UINT32_MAX and start over from 0
+TEST_F(ShmRingTest, CountersOverflow) {
+    shm_ring_t *ring = &channel->to_client;
+    ring->head = ring->tail = UINT32_MAX - 100;
+    std::vector<uint8_t> out(300), in(300);
+    for (size_t i = 0; i < out.size(); i++) {
+        out[i] = pattern(i);
+    }
+    ASSERT_EQ(shm_ring_write(ring, out.data(), out.size()), 300);
+    EXPECT_LT(ring->tail, 300u);
+    EXPECT_EQ(shm_ring_used(ring), 300);
+    ASSERT_EQ(shm_ring_read(ring, in.data(), in.size()), 300);
+    EXPECT_EQ(in, out);
+    EXPECT_EQ(shm_ring_used(ring), 0);
+}
+
+TEST_F(ShmRingTest, FullRingTakesWhatFits) {
+    shm_ring_t *ring = &channel->to_server;
+    std::vector<uint8_t> big(SHM_RING_SIZE + 10, 7);
+    EXPECT_EQ(shm_ring_write(ring, big.data(), 100), 100);
+    EXPECT_EQ(shm_ring_write(ring, big.data(), big.size()), SHM_RING_SIZE - 100);
+    EXPECT_EQ(shm_ring_write(ring, big.data(), 1), 0);
+    EXPECT_EQ(shm_ring_read(ring, big.data(), 50), 50);
+    EXPECT_EQ(shm_ring_write(ring, big.data(), big.size()), 50);
+}
+
+// the peer owns half of the ring's state; a fill level it could not have written is refused
+TEST_F(ShmRingTest, CorruptCountersAreRefused) {
+    shm_ring_t *ring = &channel->to_server;
+    uint8_t byte = 0;
+    ring->head = 10;
+    ring->tail = 10 + SHM_RING_SIZE + 1;
+    EXPECT_EQ(shm_ring_used(ring), -1);
+    EXPECT_EQ(shm_ring_read(ring, &byte, 1), -1);
+    EXPECT_EQ(shm_ring_write(ring, &byte, 1), -1);
+    ring->tail = 9;
+    EXPECT_EQ(shm_ring_used(ring), -1);
+}
+
+TEST_F(ShmRingTest, BothMappingsSeeTheSameRing) {
+    shm_channel_t *other = shm_channel_map(fd);
+    ASSERT_NE(other, nullptr);
+    ASSERT_NE(other, channel);
+    const char msg[] = "doorbell";
+    ASSERT_EQ(shm_ring_write(&channel->to_client, msg, sizeof(msg)), (ssize_t)sizeof(msg));
+    char got[sizeof(msg)] = {};
+    ASSERT_EQ(shm_ring_read(&other->to_client, got, sizeof(got)), (ssize_t)sizeof(msg));
+    EXPECT_STREQ(got, msg);
+    EXPECT_EQ(shm_ring_used(&channel->to_client), 0);
+    shm_channel_unmap(other);
+
+    // a descriptor too small to hold a channel is not mapped
+    int pipes[2];
+    ASSERT_EQ(pipe(pipes), 0);
+    EXPECT_EQ(shm_channel_map(pipes[0]), nullptr);
+    close(pipes[0]);
+    close(pipes[1]);
+}
+
+TEST_F(ShmRingTest, ParkSeesDataThatIsAlreadyThere) {
+    shm_ring_t *ring = &channel->to_client;
+    EXPECT_EQ(shm_ring_park(ring), 0);
+    EXPECT_TRUE(shm_ring_take_waiter(ring));
+    EXPECT_FALSE(shm_ring_take_waiter(ring));
+
+    uint8_t byte = 1;
+    ASSERT_EQ(shm_ring_write(ring, &byte, 1), 1);
+    EXPECT_EQ(shm_ring_park(ring), 1);
+    EXPECT_FALSE(shm_ring_take_waiter(ring));
+}
+
+// a consumer asleep on the futex is woken by the write, well before its timeout
+TEST_F(ShmRingTest, WakeEndsTheWait) {
+    shm_ring_t *ring = &channel->to_client;
+    std::atomic<bool> woke(false);
+    std::thread consumer([&] {
+        uint32_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+        ASSERT_EQ(shm_ring_park(ring), 0);
+        shm_ring_wait(ring, tail, 20000);
+        woke = true;
+    });
+    // give the consumer time to fall asleep; if it has not yet, the tail it waits on moves anyway
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    EXPECT_FALSE(woke);
+
+    auto start = std::chrono::steady_clock::now();
+    uint8_t byte = 1;
+    ASSERT_EQ(shm_ring_write(ring, &byte, 1), 1);
+    ASSERT_TRUE(shm_ring_take_waiter(ring));
+    shm_ring_wake(ring);
+    consumer.join();
+    EXPECT_TRUE(woke);
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(5));
+
+    // a tail that has already moved on does not sleep at all
+    start = std::chrono::steady_clock::now();
+    shm_ring_wait(ring, ring->tail - 1, 20000);
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(5));
+}
+
+// a producer and a consumer going through the park / take_waiter handshake: a lost wakeup
+// would leave the consumer asleep for the whole timeout and the test far over its time
+TEST_F(ShmRingTest, DoorbellLosesNoWakeups) {
+    shm_ring_t *ring = &channel->to_client;
+    const uint64_t total = 4 * SHM_RING_SIZE + 12345;
+    const int timeout_ms = 10000;
+    std::atomic<int> wakes(0);
+    bool ordered = true;
+
+    auto start = std::chrono::steady_clock::now();
+    std::thread consumer([&] {
+        std::vector<uint8_t> in(3000);
+        uint64_t read = 0;
+        while (read < total) {
+            ssize_t r = shm_ring_read(ring, in.data(), in.size());
+            ASSERT_GE(r, 0);
+            for (ssize_t i = 0; i < r; i++) {
+                ordered &= in[i] == pattern(read + i);
+            }
+            read += r;
+            if (r == 0) {
+                uint32_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+                if (shm_ring_park(ring) == 0) {
+                    shm_ring_wait(ring, tail, timeout_ms);
+                }
+            }
+        }
+    });
+
+    std::vector<uint8_t> out(700);
+    uint64_t written = 0;
+    for (int chunk = 1; written < total; chunk++) {
+        size_t len = std::min<uint64_t>(out.size(), total - written);
+        for (size_t i = 0; i < len; i++) {
+            out[i] = pattern(written + i);
+        }
+        ssize_t w = shm_ring_write(ring, out.data(), len);
+        ASSERT_GE(w, 0);
+        written += w;
+        if (shm_ring_take_waiter(ring)) {
+            wakes++;
+            shm_ring_wake(ring);
+        }
+        // now and then the consumer is given time to run dry and go to sleep
+        if (chunk % 64 == 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        else if (w == 0) {
+            std::this_thread::yield();
+        }
+    }
+    consumer.join();
+    EXPECT_TRUE(ordered);
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(timeout_ms / 2));
+    // the consumer did have to sleep, or the test proves nothing
+    EXPECT_GT(wakes.load(), 0);
+}
@@ -0,0 +1,212 @@
+#include <gtest/gtest.h>
+#include <climits>
+#include <cstring>
+
+extern "C" {
+#include "wire.h"
+}
+
+static client_packet_t raise_of(int seq, int amount) {
+    client_packet_t pkt = {};
+    pkt.packet_type = RAISE;
+    pkt.seq = seq;
+    pkt.params[0] = amount;
+    return pkt;
+}
+
+static info_packet_t some_info() {
+    info_packet_t info = {};
+    info.player_cards[0] = ACE OF SPADE;
+    info.player_cards[1] = TWO OF DIAMOND;
+    for (int i = 0; i < 5; i++) {
+        info.community_cards[i] = i < 3 ? (card_t)(KING OF HEART) - 4 * i : NOCARD;
+    }
+    for (int i = 0; i < MAX_PLAYERS; i++) {
+        info.player_stacks[i] = 100 * i - 50;
+        info.player_bets[i] = i * 7;
+        info.player_status[i] = i % 3;
+    }
+    info.pot_size = 1234567;
+    info.dealer = 3;
+    info.player_turn = 4;
+    info.bet_size = 20;
+    info.version = 99;
+    return info;
+}
+
+TEST(Wire, VarintsRoundTrip) {
+    const int values[] = {0, 1, -1, 63, -64, 64, -65, 127, 128, 8191, 8192, -8193, 1 << 20, INT_MAX, INT_MIN};
+    for (int v : values) {
+        client_packet_t in = raise_of(v, -v), out;
+        wire_buf_t buf;
+        int size = wire_encode_client(&in, &buf);
+        ASSERT_GT(size, 0) << v;
+        ASSERT_EQ(wire_decode_client(buf.bytes, buf.len, &out), size) << v;
+        EXPECT_EQ(out.packet_type, RAISE);
+        EXPECT_EQ(out.seq, v);
+        EXPECT_EQ(out.params[0], -v);
+    }
+}
+
+TEST(Wire, ZigzagKeepsSmallNumbersShort) {
+    struct { int value; size_t bytes; } cases[] = {
+        {0, 1}, {-1, 1}, {63, 1}, {-64, 1}, {64, 2}, {-65, 2}, {8191, 2}, {8192, 3}, {INT_MIN, 5}, {INT_MAX, 5},
+    };
+    for (auto c : cases) {
+        client_packet_t pkt = raise_of(0, c.value);
+        wire_buf_t buf;
+        ASSERT_GT(wire_encode_client(&pkt, &buf), 0);
+        // the header, a one-byte seq, then the amount
+        EXPECT_EQ(buf.len, WIRE_HEADER_SIZE + 1 + c.bytes) << c.value;
+    }
+
+    client_packet_t pkt = raise_of(-1, 1);
+    wire_buf_t buf;
+    ASSERT_EQ(wire_encode_client(&pkt, &buf), WIRE_HEADER_SIZE + 2);
+    const uint8_t expected[] = {0x00, 0x02, WIRE_VERSION, RAISE, 0x01, 0x02};
+    EXPECT_EQ(memcmp(buf.bytes, expected, sizeof(expected)), 0);
+}
+
+TEST(Wire, ServerPacketsRoundTrip) {
+    server_packet_t in = {}, out;
+    wire_buf_t buf;
+
+    in.packet_type = INFO;
+    in.info = some_info();
+    ASSERT_GT(wire_encode_server(&in, &buf), 0);
+    memset(&out, 0x5A, sizeof(out));
+    ASSERT_EQ(wire_decode_server(buf.bytes, buf.len, &out), (int)buf.len);
+    EXPECT_EQ(out.packet_type, INFO);
+    EXPECT_EQ(memcmp(&out.info, &in.info, sizeof(in.info)), 0);
+    EXPECT_EQ(buf.bytes[WIRE_INFO_CARDS_OFFSET], ACE OF SPADE);
+
+    in = {};
+    in.packet_type = END;
+    for (int i = 0; i < MAX_PLAYERS; i++) {
+        in.end.player_cards[i][0] = i;
+        in.end.player_cards[i][1] = NOCARD;
+        in.end.player_stacks[i] = 1000 - i;
+        in.end.player_status[i] = 1;
+    }
+    for (int i = 0; i < 5; i++) {
+        in.end.community_cards[i] = 40 + i;
+    }
+    in.end.pot_size = 300;
+    in.end.dealer = 5;
+    in.end.winner = 2;
+    ASSERT_GT(wire_encode_server(&in, &buf), 0);
+    ASSERT_EQ(wire_decode_server(buf.bytes, buf.len, &out), (int)buf.len);
+    EXPECT_EQ(out.packet_type, END);
+    EXPECT_EQ(memcmp(&out.end, &in.end, sizeof(in.end)), 0);
+
+    join_packet_t join = {2, 4, 777, 12, 1};
+    ASSERT_GT(wire_encode_join_ack(9, &join, &buf), 0);
+    ASSERT_EQ(wire_decode_server(buf.bytes, buf.len, &out), (int)buf.len);
+    EXPECT_EQ(out.packet_type, ACK);
+    EXPECT_EQ(out.seq, 9);
+    EXPECT_EQ(memcmp(&out.join, &join, sizeof(join)), 0);
+
+    in = {};
+    in.packet_type = HALT;
+    ASSERT_EQ(wire_encode_server(&in, &buf), WIRE_HEADER_SIZE);
+    ASSERT_EQ(wire_decode_server(buf.bytes, buf.len, &out), WIRE_HEADER_SIZE);
+    EXPECT_EQ(out.packet_type, HALT);
+}
+
+TEST(Wire, EquityRoundTrips) {
+    server_packet_t in = {}, out;
+    in.packet_type = EQUITY;
+    in.equity.all_in = 1;
+    in.equity.board_cards = 3;
+    for (int i = 0; i < MAX_PLAYERS; i++) {
+        in.equity.equity[i] = i % 2 ? EQUITY_UNKNOWN : 1000 * i + 7;
+        in.equity.margin[i] = i % 2 ? EQUITY_UNKNOWN : 50 + i;
+        in.equity.strength[i] = EQUITY_UNKNOWN;
+    }
+    wire_buf_t buf;
+    ASSERT_GT(wire_encode_server(&in, &buf), 0);
+    memset(&out, 0x5A, sizeof(out));
+    ASSERT_EQ(wire_decode_server(buf.bytes, buf.len, &out), (int)buf.len);
+    EXPECT_EQ(out.packet_type, EQUITY);
+    EXPECT_EQ(memcmp(&out.equity, &in.equity, sizeof(in.equity)), 0);
+}
+
+TEST(Wire, DeltaCarriesOnlyWhatChanged) {
+    server_packet_t in = {}, out = {};
+    in.packet_type = DELTA;
+    in.delta.base_version = 41;
+    in.delta.changed = DELTA_POT;
+    in.delta.state = some_info();
+    wire_buf_t full, delta;
+    server_packet_t info = {};
+    info.packet_type = INFO;
+    info.info = some_info();
+    ASSERT_GT(wire_encode_server(&info, &full), 0);
+    ASSERT_GT(wire_encode_server(&in, &delta), 0);
+    EXPECT_LT(delta.len, full.len);
+    ASSERT_EQ(wire_decode_server(delta.bytes, delta.len, &out), (int)delta.len);
+    EXPECT_EQ(out.delta.base_version, 41);
+    EXPECT_EQ(out.delta.changed, (unsigned)DELTA_POT);
+    EXPECT_EQ(out.delta.state.pot_size, in.delta.state.pot_size);
+    EXPECT_EQ(out.delta.state.version, in.delta.state.version);
+}
+
+TEST(Wire, PartialFramesAskForMore) {
+    client_packet_t pkt = raise_of(300, 5000), out;
+    wire_buf_t buf;
+    int size = wire_encode_client(&pkt, &buf);
+    ASSERT_GT(size, 0);
+    for (size_t have = 0; have < buf.len; have++) {
+        EXPECT_EQ(wire_decode_client(buf.bytes, have, &out), 0) << have;
+        size_t wanted = wire_bytes_wanted(buf.bytes, have);
+        EXPECT_EQ(wanted, have < WIRE_HEADER_SIZE ? WIRE_HEADER_SIZE - have : buf.len - have) << have;
+    }
+    EXPECT_EQ(wire_bytes_wanted(buf.bytes, buf.len), 0u);
+    EXPECT_EQ(wire_decode_client(buf.bytes, buf.len, &out), size);
+}
+
+TEST(Wire, RejectsMalformedFrames) {
+    client_packet_t pkt = raise_of(1, 2), out;
+    server_packet_t sout;
+    wire_buf_t buf;
+    ASSERT_GT(wire_encode_client(&pkt, &buf), 0);
+
+    // a length past WIRE_MAX_BODY is refused from the header alone
+    uint8_t big[WIRE_HEADER_SIZE] = {(WIRE_MAX_BODY + 1) >> 8, (WIRE_MAX_BODY + 1) & 0xFF, WIRE_VERSION, RAISE};
+    EXPECT_EQ(wire_decode_client(big, sizeof(big), &out), -1);
+    EXPECT_EQ(wire_decode_server(big, sizeof(big), &sout), -1);
+    EXPECT_EQ(wire_bytes_wanted(big, sizeof(big)), 0u);
+    uint8_t huge[WIRE_HEADER_SIZE] = {0xFF, 0xFF, WIRE_VERSION, RAISE};
+    EXPECT_EQ(wire_decode_client(huge, sizeof(huge), &out), -1);
+
+    wire_buf_t bad = buf;
+    bad.bytes[2] = WIRE_VERSION + 1;
+    EXPECT_EQ(wire_decode_client(bad.bytes, bad.len, &out), -1);
+
+    bad = buf;
+    bad.bytes[3] = RESUME + 1;
+    EXPECT_EQ(wire_decode_client(bad.bytes, bad.len, &out), -1);
+    bad.bytes[3] = DELTA + 1;
+    EXPECT_EQ(wire_decode_server(bad.bytes, bad.len, &sout), -1);
+
+    // a body shorter than its fields say
+    bad = buf;
+    bad.bytes[1] = 1;
+    EXPECT_EQ(wire_decode_client(bad.bytes, WIRE_HEADER_SIZE + 1, &out), -1);
+
+    // a varint whose last byte still says more follows
+    uint8_t cut[] = {0x00, 0x02, WIRE_VERSION, RAISE, 0x02, 0x80};
+    EXPECT_EQ(wire_decode_client(cut, sizeof(cut), &out), -1);
+
+    // a varint longer than any 32-bit number
+    uint8_t endless[] = {0x00, 0x07, WIRE_VERSION, RAISE, 0x02, 0x80, 0x80, 0x80, 0x80, 0x80, 0x01};
+    EXPECT_EQ(wire_decode_client(endless, sizeof(endless), &out), -1);
+
+    // a card that is not in the deck
+    server_packet_t info = {};
+    info.packet_type = INFO;
+    info.info = some_info();
+    ASSERT_GT(wire_encode_server(&info, &buf), 0);
+    buf.bytes[WIRE_INFO_CARDS_OFFSET] = DECK_SIZE;
+    EXPECT_EQ(wire_decode_server(buf.bytes, buf.len, &sout), -1);
+}